@@ -42,8 +42,12 @@ Jupiter::GenericCommand::~GenericCommand()
 		GenericCommand::m_parent->removeCommand(*this);
 
 	// Notify plugins
-	for (size_t index = 0; index != Jupiter::plugins->size(); ++index)
-		Jupiter::plugins->get(index)->OnGenericCommandRemove(*this);
+	const std::vector<Jupiter::Plugin *> &subscribers = Jupiter::Plugin::getSubscribers(Jupiter::Plugin::Event::GENERIC_COMMAND_REMOVE);
+	for (size_t index = 0; index < subscribers.size(); ++index)
+	{
+		Jupiter::Plugin::HookTimer timer(subscribers[index], Jupiter::Plugin::Event::GENERIC_COMMAND_REMOVE);
+		subscribers[index]->OnGenericCommandRemove(*this);
+	}
 }
 
 bool Jupiter::GenericCommand::isNamespace() const
@@ -183,8 +183,12 @@ class CLASS : public Jupiter::GenericCommand { \
 class CLASS ## _Init : public CLASS { \
 public: \
 	CLASS ## _Init() { \
-		for (size_t index = 0; index != Jupiter::plugins->size(); ++index) \
-			Jupiter::plugins->get(index)->OnGenericCommandAdd(*this); \
+		const std::vector<Jupiter::Plugin *> &subscribers = Jupiter::Plugin::getSubscribers(Jupiter::Plugin::Event::GENERIC_COMMAND_ADD); \
+		for (size_t index = 0; index < subscribers.size(); ++index) \
+		{ \
+			Jupiter::Plugin::HookTimer timer(subscribers[index], Jupiter::Plugin::Event::GENERIC_COMMAND_ADD); \
+			subscribers[index]->OnGenericCommandAdd(*this); \
+		} \
 	} }; \
 	CLASS ## _Init CLASS ## _instance = CLASS ## _Init (); \
 	CLASS & CLASS :: instance = CLASS ## _instance;
@@ -0,0 +1,216 @@
+/**
+ * Copyright (C) 2017 Jessica James.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Written by Jessica James <jessica.aj@outlook.com>
+ */
+
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include "HTTP_AccessLog.h"
+
+/** Copies a string into a fixed-size, null-terminated field */
+template<size_t N> static void copy_field(char (&out_field)[N], const Jupiter::ReadableString &in_value)
+{
+	size_t length = in_value.size() < N - 1 ? in_value.size() : N - 1;
+	memcpy(out_field, in_value.ptr(), length);
+	out_field[length] = '\0';
+}
+
+void Jupiter::HTTP::AccessLog::Record::set(const Jupiter::ReadableString &in_method, const Jupiter::ReadableString &in_host, const Jupiter::ReadableString &in_path, unsigned int in_status, size_t in_bytes, std::chrono::microseconds in_handler_time, std::chrono::microseconds in_total_time)
+{
+	copy_field(method, in_method);
+	copy_field(host, in_host);
+	copy_field(path, in_path);
+	status = in_status;
+	bytes = in_bytes;
+	handler_time = in_handler_time;
+	total_time = in_total_time;
+	timestamp = time(0);
+}
+
+/**
+* The ring is a bounded queue in which every slot carries a sequence number.
+* A producer claims a slot by advancing the tail, but may only do so when the slot's
+* sequence shows that the consumer has finished with it; otherwise the ring is full
+* and the record is dropped. The consumer publishes a freed slot by bumping its
+* sequence by the ring's capacity.
+*/
+
+namespace
+{
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		Jupiter::HTTP::AccessLog::Record record;
+	};
+}
+
+struct Jupiter::HTTP::AccessLog::Data
+{
+	Slot *slots;
+	size_t mask;
+	std::atomic<size_t> tail{ 0 };
+	size_t head = 0; // only touched by the writer thread
+	std::atomic<size_t> dropped{ 0 };
+	std::atomic<size_t> written{ 0 };
+	std::atomic<bool> running{ true };
+	std::chrono::milliseconds flush_interval;
+	FILE *output;
+	std::thread writer;
+
+	bool pop(Record &out_record);
+	void write(const Record &in_record);
+	void writer_loop();
+};
+
+bool Jupiter::HTTP::AccessLog::Data::pop(Record &out_record)
+{
+	Slot &slot = slots[head & mask];
+	if (slot.sequence.load(std::memory_order_acquire) != head + 1)
+		return false; // empty
+
+	out_record = slot.record;
+	slot.sequence.store(head + mask + 1, std::memory_order_release);
+	++head;
+	return true;
+}
+
+void Jupiter::HTTP::AccessLog::Data::write(const Record &in_record)
+{
+	// gmtime() shares its buffer with the server thread
+	tm utc;
+#if defined _WIN32
+	gmtime_s(&utc, &in_record.timestamp);
+#else // _WIN32
+	gmtime_r(&in_record.timestamp, &utc);
+#endif // _WIN32
+
+	char time_str[32];
+	strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%SZ", &utc);
+
+	fprintf(output, "%s method=%s host=\"%s\" path=\"%s\" status=%u bytes=%llu handler_us=%lld total_us=%lld" ENDL,
+		time_str,
+		in_record.method,
+		in_record.host,
+		in_record.path,
+		in_record.status,
+		static_cast<unsigned long long>(in_record.bytes),
+		static_cast<long long>(in_record.handler_time.count()),
+		static_cast<long long>(in_record.total_time.count()));
+}
+
+void Jupiter::HTTP::AccessLog::Data::writer_loop()
+{
+	Record record;
+	size_t count;
+
+	while (true)
+	{
+		bool stopping = running.load(std::memory_order_acquire) == false;
+
+		// Drain everything currently in the ring, and flush once per batch
+		count = 0;
+		while (pop(record))
+		{
+			write(record);
+			++count;
+		}
+
+		if (count != 0)
+		{
+			fflush(output);
+			written.fetch_add(count, std::memory_order_relaxed);
+		}
+		else if (stopping)
+			break;
+		else
+			std::this_thread::sleep_for(flush_interval);
+	}
+}
+
+/** AccessLog */
+
+bool Jupiter::HTTP::AccessLog::push(const Record &in_record)
+{
+	size_t position = data_->tail.load(std::memory_order_relaxed);
+	Slot *slot;
+
+	while (true)
+	{
+		slot = &data_->slots[position & data_->mask];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+
+		if (sequence == position)
+		{
+			// Slot is free; try to claim it
+			if (data_->tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (sequence < position)
+		{
+			// Writer hasn't released this slot yet; the ring is full
+			data_->dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		else // Another producer claimed this slot first
+			position = data_->tail.load(std::memory_order_relaxed);
+	}
+
+	slot->record = in_record;
+	slot->sequence.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+size_t Jupiter::HTTP::AccessLog::getDropped() const
+{
+	return data_->dropped.load(std::memory_order_relaxed);
+}
+
+size_t Jupiter::HTTP::AccessLog::getWritten() const
+{
+	return data_->written.load(std::memory_order_relaxed);
+}
+
+size_t Jupiter::HTTP::AccessLog::getCapacity() const
+{
+	return data_->mask + 1;
+}
+
+Jupiter::HTTP::AccessLog::AccessLog(FILE *in_output, size_t in_capacity, std::chrono::milliseconds in_flush_interval)
+{
+	size_t capacity = 2;
+	while (capacity < in_capacity)
+		capacity <<= 1;
+
+	data_ = new Data();
+	data_->slots = new Slot[capacity];
+	data_->mask = capacity - 1;
+	data_->output = in_output;
+	data_->flush_interval = in_flush_interval;
+
+	for (size_t index = 0; index != capacity; ++index)
+		data_->slots[index].sequence.store(index, std::memory_order_relaxed);
+
+	data_->writer = std::thread(&Data::writer_loop, data_);
+}
+
+Jupiter::HTTP::AccessLog::~AccessLog()
+{
+	data_->running.store(false, std::memory_order_release);
+	data_->writer.join();
+	delete[] data_->slots;
+	delete data_;
+}
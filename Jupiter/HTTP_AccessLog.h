@@ -0,0 +1,120 @@
+/**
+ * Copyright (C) 2017 Jessica James.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Written by Jessica James <jessica.aj@outlook.com>
+ */
+
+#if !defined _HTTP_ACCESSLOG_H_HEADER
+#define _HTTP_ACCESSLOG_H_HEADER
+
+/**
+ * @file HTTP_AccessLog.h
+ * @brief Provides an asynchronous access log for HTTP::Server.
+ */
+
+#include <cstdio>
+#include <ctime>
+#include <chrono>
+#include "Jupiter.h"
+#include "Readable_String.h"
+
+namespace Jupiter
+{
+	namespace HTTP
+	{
+		/**
+		* @brief Records served requests into a fixed-size lock-free ring, which is drained by a background writer thread.
+		* Note: push() never blocks and never performs file I/O; records are dropped when the ring is full.
+		*/
+		class JUPITER_API AccessLog
+		{
+		public:
+			/**
+			* @brief A single access log entry. Strings are truncated to fit their fixed-size fields.
+			*/
+			struct Record
+			{
+				char method[8];
+				char host[64];
+				char path[256];
+				unsigned int status;
+				size_t bytes;
+				std::chrono::microseconds handler_time;
+				std::chrono::microseconds total_time;
+				time_t timestamp;
+
+				/**
+				* @brief Populates the record's fields.
+				*/
+				void set(const Jupiter::ReadableString &in_method, const Jupiter::ReadableString &in_host, const Jupiter::ReadableString &in_path, unsigned int in_status, size_t in_bytes, std::chrono::microseconds in_handler_time, std::chrono::microseconds in_total_time);
+			};
+
+			/**
+			* @brief Places a record in the ring for the writer thread to output.
+			*
+			* @param in_record Record to log
+			* @return True if the record was queued, false if it was dropped because the ring is full.
+			*/
+			bool push(const Record &in_record);
+
+			/**
+			* @brief Returns the number of records dropped due to the ring being full.
+			*
+			* @return Number of dropped records.
+			*/
+			size_t getDropped() const;
+
+			/**
+			* @brief Returns the number of records which have been written to the output.
+			*
+			* @return Number of written records.
+			*/
+			size_t getWritten() const;
+
+			/**
+			* @brief Returns the number of records the ring can hold.
+			*
+			* @return Capacity of the ring.
+			*/
+			size_t getCapacity() const;
+
+			/**
+			* @brief Constructor for the AccessLog class; this starts the writer thread.
+			*
+			* @param in_output FILE to write records to; this is not closed by the AccessLog.
+			* @param in_capacity Number of records the ring can hold; rounded up to a power of two.
+			* @param in_flush_interval Time the writer sleeps for when the ring is empty.
+			*/
+			AccessLog(FILE *in_output, size_t in_capacity = 4096, std::chrono::milliseconds in_flush_interval = std::chrono::milliseconds(100));
+
+			/**
+			* @brief Copying an AccessLog is forbidden.
+			*/
+			AccessLog(const AccessLog &) = delete;
+
+			/**
+			* @brief Destructor for the AccessLog class; this stops the writer thread after writing any remaining records.
+			*/
+			~AccessLog();
+
+		/** Private members */
+		private:
+			struct Data;
+			Data *data_;
+		}; // Jupiter::HTTP::AccessLog class
+	} // Jupiter::HTTP namespace
+} // Jupiter namespace
+
+#endif // _HTTP_ACCESSLOG_H_HEADER
@@ -25,6 +25,7 @@
 #include "ArrayList.h"
 #include "HTTP.h"
 #include "HTTP_Server.h"
+#include "HTTP_AccessLog.h"
 
 using namespace Jupiter::literals;
 
@@ -241,18 +242,20 @@ Jupiter::HTTP::Server::Host::Host(const Jupiter::ReadableString &in_name) : Dire
 
 struct HTTPSession
 {
-	Jupiter::Socket sock;
-	Jupiter::String request;
+	Jupiter::Socket sock; // received data stays in the socket's buffer until a request is processed; unsent responses stay in its send queue
 	bool keep_alive = false;
 	Jupiter::HTTP::Server::Host *host = nullptr;
 	HTTPVersion version = HTTPVersion::HTTP_1_0;
 	std::chrono::steady_clock::time_point last_active = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point request_start = std::chrono::steady_clock::now(); // time the first bytes of the current request were received
 	HTTPSession(Jupiter::Socket &&in_sock);
 	~HTTPSession();
 };
 
 HTTPSession::HTTPSession(Jupiter::Socket &&in_sock) : sock(std::move(in_sock))
 {
+	sock.setAppendMode(true);
+	sock.setQueueMode(true);
 }
 
 HTTPSession::~HTTPSession()
@@ -271,6 +274,7 @@ struct Jupiter::HTTP::Server::Data
 	std::chrono::milliseconds keep_alive_session_timeout = std::chrono::milliseconds(5000); // TODO: Config variable
 	size_t max_request_size = 1024; // TODO: Config variable
 	bool permit_keept_alive = true; // TODO: Config variable
+	Jupiter::HTTP::AccessLog *access_log = nullptr; // not owned
 
 	/** Foward functions */
 	void hook(const Jupiter::ReadableString &host, const Jupiter::ReadableString &path, Content *in_content);
@@ -454,11 +458,17 @@ char *html_time()
 
 int Jupiter::HTTP::Server::Data::process_request(HTTPSession &session)
 {
-	Jupiter::ReadableString::TokenizeResult<Jupiter::Reference_String> lines = Jupiter::ReferenceString::tokenize(session.request, STRING_LITERAL_AS_REFERENCE(ENDL));
+	Jupiter::ReadableString::TokenizeResult<Jupiter::Reference_String> lines = Jupiter::ReferenceString::tokenize(session.sock.getBuffer(), STRING_LITERAL_AS_REFERENCE(ENDL));
 	HTTPCommand command = HTTPCommand::NONE_SPECIFIED;
 	Content *content = nullptr;
 	Jupiter::ReferenceString query_string;
 	Jupiter::ReferenceString first_token;
+	Jupiter::ReferenceString method;
+	Jupiter::ReferenceString path;
+	Jupiter::ReferenceString host_name;
+	std::chrono::microseconds handler_time{ 0 };
+	unsigned int status;
+	int bytes_sent;
 	size_t index = 0;
 	size_t span;
 
@@ -489,7 +499,9 @@ int Jupiter::HTTP::Server::Data::process_request(HTTPSession &session)
 				if (content != nullptr)
 				{
 					// 200 (success)
+					std::chrono::steady_clock::time_point handler_start = std::chrono::steady_clock::now();
 					Jupiter::ReadableString *content_result = content->execute(query_string);
+					handler_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - handler_start);
 
 					switch (session.version)
 					{
@@ -543,7 +555,8 @@ int Jupiter::HTTP::Server::Data::process_request(HTTPSession &session)
 					if (content->free_result)
 						delete content_result;
 
-					session.sock.send(result);
+					status = Jupiter::HTTP::Status::OK;
+					bytes_sent = session.sock.send(result);
 				}
 				else
 				{
@@ -575,7 +588,17 @@ int Jupiter::HTTP::Server::Data::process_request(HTTPSession &session)
 						result += "Connection: close"_jrs ENDL;
 
 					result += ENDL ENDL;
-					session.sock.send(result);
+					status = Jupiter::HTTP::Status::NOT_FOUND;
+					bytes_sent = session.sock.send(result);
+				}
+
+				// Record the request before the request buffer is shifted
+				if (Jupiter::HTTP::Server::Data::access_log != nullptr)
+				{
+					Jupiter::HTTP::AccessLog::Record record;
+					record.set(method, host_name, path, status, bytes_sent > 0 ? static_cast<size_t>(bytes_sent) : 0, handler_time,
+						std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - session.request_start));
+					Jupiter::HTTP::Server::Data::access_log->push(record);
 				}
 				break;
 			default:
@@ -585,11 +608,14 @@ int Jupiter::HTTP::Server::Data::process_request(HTTPSession &session)
 			if (session.keep_alive == false) // not keep-alive -- will be destroyed on return
 				break;
 			if (index == lines.token_count) // end of packet
-				session.request.erase();
+				session.sock.consume(session.sock.getBuffer().size());
 			else // end of request -- another request is following
-				session.request.shiftRight(get_line_offset(index));
+			{
+				session.sock.consume(get_line_offset(index));
+				session.request_start = std::chrono::steady_clock::now();
+			}
 
-			if (session.request.find(HTTP_REQUEST_ENDING) != Jupiter::INVALID_INDEX) // there's another full request already received
+			if (session.sock.getBuffer().find(HTTP_REQUEST_ENDING) != Jupiter::INVALID_INDEX) // there's another full request already received
 				return Jupiter::HTTP::Server::Data::process_request(session);
 			break;
 		}
@@ -601,7 +627,10 @@ int Jupiter::HTTP::Server::Data::process_request(HTTPSession &session)
 		{
 			first_token.truncate(1); // trim trailing ':'
 			if (first_token.equalsi("HOST"_jrs))
-				session.host = Jupiter::HTTP::Server::Data::find_host(line.getWord(1, " "));
+			{
+				host_name = line.getWord(1, " ");
+				session.host = Jupiter::HTTP::Server::Data::find_host(host_name);
+			}
 			else if (first_token.equalsi("CONNECTION"_jrs))
 			{
 				Jupiter::ReferenceString connection_type = line.getWord(1, " ");
@@ -614,11 +643,13 @@ int Jupiter::HTTP::Server::Data::process_request(HTTPSession &session)
 			if (first_token.equals("GET"_jrs))
 			{
 				command = HTTPCommand::GET;
+				method = first_token;
 				
 				query_string = line.getWord(1, " ");
 				span = query_string.find('?'); // repurposing 'span'
 				if (span == Jupiter::INVALID_INDEX)
 				{
+					path = query_string;
 					if (session.host == nullptr)
 						content = Jupiter::HTTP::Server::Data::find(query_string);
 					else
@@ -627,6 +658,7 @@ int Jupiter::HTTP::Server::Data::process_request(HTTPSession &session)
 				}
 				else
 				{
+					path = query_string.substring(size_t{ 0 }, span);
 					if (session.host == nullptr)
 						content = Jupiter::HTTP::Server::Data::find(query_string.substring(size_t{ 0 }, span));
 					else
@@ -647,11 +679,13 @@ int Jupiter::HTTP::Server::Data::process_request(HTTPSession &session)
 			else if (first_token.equals("HEAD"_jrs))
 			{
 				command = HTTPCommand::HEAD;
+				method = first_token;
 				
 				query_string = line.getWord(1, " ");
 				span = query_string.find('?'); // repurposing 'span'
 				if (span == Jupiter::INVALID_INDEX)
 				{
+					path = query_string;
 					if (session.host == nullptr)
 						content = Jupiter::HTTP::Server::Data::find(query_string);
 					else
@@ -660,6 +694,7 @@ int Jupiter::HTTP::Server::Data::process_request(HTTPSession &session)
 				}
 				else
 				{
+					path = query_string.substring(size_t{ 0 }, span);
 					if (session.host == nullptr)
 						content = Jupiter::HTTP::Server::Data::find(query_string.substring(size_t{ 0 }, span));
 					else
@@ -756,6 +791,16 @@ Jupiter::ReadableString *Jupiter::HTTP::Server::execute(const Jupiter::ReadableS
 	return Jupiter::HTTP::Server::data_->execute(host, name, query_string);
 }
 
+void Jupiter::HTTP::Server::setAccessLog(Jupiter::HTTP::AccessLog *in_access_log)
+{
+	Jupiter::HTTP::Server::data_->access_log = in_access_log;
+}
+
+Jupiter::HTTP::AccessLog *Jupiter::HTTP::Server::getAccessLog() const
+{
+	return Jupiter::HTTP::Server::data_->access_log;
+}
+
 bool Jupiter::HTTP::Server::bind(const Jupiter::ReadableString &hostname, uint16_t port)
 {
 	Jupiter::TCPSocket *socket = new Jupiter::TCPSocket();
@@ -785,6 +830,7 @@ int Jupiter::HTTP::Server::think()
 {
 	Jupiter::Socket *socket;
 	HTTPSession *session;
+	int received;
 
 	// Process existing clients
 	size_t index = Jupiter::HTTP::Server::data_->sessions.size();
@@ -801,21 +847,30 @@ int Jupiter::HTTP::Server::think()
 			|| (session->keep_alive == false && std::chrono::steady_clock::now() > session->last_active + Jupiter::HTTP::Server::data_->session_timeout))
 			delete Jupiter::HTTP::Server::data_->sessions.remove(index);
 			//session->sock.shutdown();
-		else if (session->sock.recv() > 0)
+		else if (session->sock.getQueuedSize() != 0) // response still being sent; finish it before reading any more requests
+		{
+			received = session->sock.flush();
+			if (received < 0 || (session->sock.getQueuedSize() == 0 && session->keep_alive == false))
+				delete Jupiter::HTTP::Server::data_->sessions.remove(index);
+			else if (received > 0)
+				session->last_active = std::chrono::steady_clock::now();
+		}
+		else if ((received = session->sock.recv()) > 0)
 		{
-			const Jupiter::ReadableString &sock_buffer = session->sock.getBuffer();
-			if (session->request.size() + sock_buffer.size() <= Jupiter::HTTP::Server::data_->max_request_size) // accept
+			const Jupiter::ReadableString &request = session->sock.getBuffer();
+			if (request.size() <= Jupiter::HTTP::Server::data_->max_request_size) // accept
 			{
-				session->request += sock_buffer;
-				if (session->request.find(HTTP_REQUEST_ENDING) != Jupiter::INVALID_INDEX) // completed request
+				if (request.size() == static_cast<size_t>(received)) // first bytes of a new request
+					session->request_start = std::chrono::steady_clock::now();
+				if (request.find(HTTP_REQUEST_ENDING) != Jupiter::INVALID_INDEX) // completed request
 				{
 					session->last_active = std::chrono::steady_clock::now();
 					Jupiter::HTTP::Server::data_->process_request(*session);
-					if (session->keep_alive == false) // remove completed session
+					if (session->keep_alive == false && session->sock.getQueuedSize() == 0) // remove completed session
 						delete Jupiter::HTTP::Server::data_->sessions.remove(index);
 						//session->sock.shutdown();
 				}
-				else if (session->request.size() == Jupiter::HTTP::Server::data_->max_request_size) // reject (full buffer)
+				else if (request.size() == Jupiter::HTTP::Server::data_->max_request_size) // reject (full buffer)
 					delete Jupiter::HTTP::Server::data_->sessions.remove(index);
 			}
 			else // reject
@@ -840,11 +895,10 @@ int Jupiter::HTTP::Server::think()
 				const Jupiter::ReadableString &sock_buffer = session->sock.getBuffer();
 				if (sock_buffer.size() < Jupiter::HTTP::Server::data_->max_request_size) // accept
 				{
-					session->request = session->sock.getBuffer();
 					if (sock_buffer.find(HTTP_REQUEST_ENDING) != Jupiter::INVALID_INDEX) // completed request
 					{
 						Jupiter::HTTP::Server::data_->process_request(*session);
-						if (session->keep_alive) // session will live for 30 seconds.
+						if (session->keep_alive || session->sock.getQueuedSize() != 0) // session will live for 30 seconds, or until its response is sent.
 							Jupiter::HTTP::Server::data_->sessions.add(session);
 						else // session completed
 							delete session;
@@ -858,9 +912,8 @@ int Jupiter::HTTP::Server::think()
 						delete session;
 					else // accept (max size, completed request)
 					{
-						session->request = session->sock.getBuffer();
 						Jupiter::HTTP::Server::data_->process_request(*session);
-						if (session->keep_alive) // session will live for 30 seconds.
+						if (session->keep_alive || session->sock.getQueuedSize() != 0) // session will live for 30 seconds, or until its response is sent.
 							Jupiter::HTTP::Server::data_->sessions.add(session);
 						else // session completed
 							delete session;
@@ -39,6 +39,8 @@ namespace Jupiter
 {
 	namespace HTTP
 	{
+		class AccessLog;
+
 		class JUPITER_API Server : public Thinker
 		{
 		public: // Jupiter::Thinker
@@ -106,6 +108,21 @@ namespace Jupiter
 			Jupiter::ReadableString *execute(const Jupiter::ReadableString &name, const Jupiter::ReadableString &query_string);
 			Jupiter::ReadableString *execute(const Jupiter::ReadableString &host, const Jupiter::ReadableString &name, const Jupiter::ReadableString &query_string);
 
+			/**
+			* @brief Sets the access log which served requests are recorded to.
+			* Note: The access log is not owned by the server, and must outlive it (or be unset first).
+			*
+			* @param in_access_log Access log to record requests to, or nullptr to disable logging
+			*/
+			void setAccessLog(AccessLog *in_access_log);
+
+			/**
+			* @brief Fetches the access log which served requests are recorded to.
+			*
+			* @return Access log if one is set, nullptr otherwise.
+			*/
+			AccessLog *getAccessLog() const;
+
 			bool bind(const Jupiter::ReadableString &hostname, uint16_t port = 80);
 			bool tls_bind(const Jupiter::ReadableString &hostname, uint16_t port = 443);
 
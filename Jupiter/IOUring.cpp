@@ -0,0 +1,1003 @@
+/**
+ * Copyright (C) 2017 Jessica James.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Written by Jessica James <jessica.aj@outlook.com>
+ */
+
+#include <cerrno>
+#include "IOUring.h"
+
+#if defined __linux__
+
+#include <cstring>
+#include <deque>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/** Operation types; stored in the low byte of each submission's user_data, with the channel slot above it */
+enum URingOperation : uint8_t
+{
+	URING_RECV,
+	URING_ACCEPT,
+	URING_POLL,
+	URING_SEND,
+	URING_PROVIDE,
+	URING_CANCEL
+};
+
+static constexpr uint16_t URING_BUFFER_GROUP = 1;
+static constexpr size_t URING_MAX_SEND_CHAIN = 16;
+static constexpr std::chrono::milliseconds URING_DETACH_LINGER = std::chrono::milliseconds(250);
+
+struct URingChunk
+{
+	uint16_t buffer_id;
+	uint32_t length;
+	uint32_t offset;
+};
+
+struct URingSend
+{
+	char *data;
+	size_t length;
+	size_t offset;
+};
+
+enum class URingMode
+{
+	STREAM,
+	LISTENER,
+	WATCH
+};
+
+struct URingChannel
+{
+	Jupiter::IOUring::SocketType descriptor;
+	URingMode mode;
+	int original_flags;
+	bool detached = false;
+	bool cancel_pending = false; // detached while armed, but the cancel request hasn't been queued yet
+	bool cancel_sends_pending = false; // detached with sends in flight, but the cancel request hasn't been queued yet
+	bool armed = false; // recv, accept, or poll is outstanding
+	bool dirty = false; // in the dirty list
+	bool readable = false;
+	bool eof = false;
+	int error = 0;
+	size_t outstanding = 0; // submitted operations which haven't completed
+	std::deque<URingChunk> chunks;
+	std::deque<int> accepted;
+	std::deque<URingSend> sends; // queued; not yet submitted
+	std::vector<URingSend> in_flight; // submitted as a linked chain
+	size_t send_completions = 0;
+};
+
+struct Jupiter::IOUring::Data
+{
+	int ring_fd = -1;
+	bool valid = false;
+	bool multishot_recv = true;
+	bool multishot_accept = true;
+
+	/** Submission queue */
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	unsigned int sq_entries;
+	io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+
+	/** Completion queue */
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	io_uring_cqe *cqes;
+
+	void *sq_ring = MAP_FAILED;
+	void *cq_ring = MAP_FAILED;
+	size_t sq_ring_size = 0;
+	size_t cq_ring_size = 0;
+	size_t sqes_size = 0;
+
+	/** Provided buffers */
+	char *buffers = nullptr;
+	unsigned int buffer_count;
+	unsigned int buffer_size;
+	std::vector<uint16_t> returned_buffers;
+
+	/** Channels */
+	std::vector<URingChannel *> channels; // indexed by slot
+	std::vector<size_t> free_slots;
+	std::vector<int> slots; // indexed by descriptor; -1 if not attached
+	std::vector<size_t> dirty; // slots which need re-arming or have sends queued
+
+	io_uring_sqe *get_sqe();
+	int enter(unsigned int min_complete, std::chrono::milliseconds wait);
+	int reap();
+	void prepare();
+	void arm(size_t slot);
+	void flush_sends(size_t slot);
+	void complete(const io_uring_cqe &cqe);
+	void mark_dirty(size_t slot);
+	void release(size_t slot);
+	void cancel(size_t slot);
+	URingChannel *find(SocketType descriptor) const;
+	int find_slot(SocketType descriptor) const;
+	URingChannel *add(SocketType descriptor, URingMode mode);
+	void detach(SocketType descriptor);
+
+	~Data();
+};
+
+static inline uint64_t make_user_data(size_t slot, URingOperation operation)
+{
+	return (static_cast<uint64_t>(slot) << 8) | operation;
+}
+
+io_uring_sqe *Jupiter::IOUring::Data::get_sqe()
+{
+	unsigned int tail = *sq_tail;
+	if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries)
+	{
+		// Submission queue is full; submit what's there now
+		Jupiter::IOUring::Data::enter(0, std::chrono::milliseconds(0));
+		if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries)
+			return nullptr;
+	}
+
+	unsigned int index = tail & *sq_mask;
+	io_uring_sqe *sqe = &sqes[index];
+	memset(sqe, 0, sizeof(io_uring_sqe));
+	sq_array[index] = index;
+	__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+	return sqe;
+}
+
+int Jupiter::IOUring::Data::enter(unsigned int min_complete, std::chrono::milliseconds wait)
+{
+	unsigned int to_submit = *sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+	unsigned int flags = 0;
+	io_uring_getevents_arg arg;
+	__kernel_timespec timeout;
+
+	if (min_complete != 0)
+	{
+		timeout.tv_sec = wait.count() / 1000;
+		timeout.tv_nsec = (wait.count() % 1000) * 1000000;
+		memset(&arg, 0, sizeof(arg));
+		arg.ts = reinterpret_cast<uint64_t>(&timeout);
+		flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+		return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, &arg, sizeof(arg));
+	}
+
+	if (to_submit == 0)
+		return 0;
+
+	return syscall(__NR_io_uring_enter, ring_fd, to_submit, 0, 0, nullptr, 0);
+}
+
+int Jupiter::IOUring::Data::reap()
+{
+	unsigned int head = *cq_head;
+	unsigned int tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+	int count = 0;
+
+	while (head != tail)
+	{
+		Jupiter::IOUring::Data::complete(cqes[head & *cq_mask]);
+		++head;
+		++count;
+		__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+		tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+	}
+
+	return count;
+}
+
+void Jupiter::IOUring::Data::prepare()
+{
+	io_uring_sqe *sqe;
+
+	// Return consumed buffers to the kernel
+	while (returned_buffers.empty() == false)
+	{
+		sqe = Jupiter::IOUring::Data::get_sqe();
+		if (sqe == nullptr)
+			return;
+
+		sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+		sqe->fd = 1;
+		sqe->addr = reinterpret_cast<uint64_t>(buffers + static_cast<size_t>(returned_buffers.back()) * buffer_size);
+		sqe->len = buffer_size;
+		sqe->off = returned_buffers.back();
+		sqe->buf_group = URING_BUFFER_GROUP;
+		sqe->user_data = make_user_data(0, URING_PROVIDE);
+		returned_buffers.pop_back();
+	}
+
+	// Re-arm channels and submit their queued sends
+	std::vector<size_t> pending;
+	pending.swap(dirty);
+	for (size_t slot : pending)
+	{
+		URingChannel *channel = channels[slot];
+		if (channel == nullptr)
+			continue;
+
+		channel->dirty = false;
+		if (channel->detached)
+		{
+			if (channel->cancel_pending || channel->cancel_sends_pending)
+				Jupiter::IOUring::Data::cancel(slot);
+			continue;
+		}
+
+		if (channel->armed == false && channel->eof == false && channel->error == 0 && channel->mode != URingMode::WATCH)
+			Jupiter::IOUring::Data::arm(slot);
+		Jupiter::IOUring::Data::flush_sends(slot);
+	}
+}
+
+void Jupiter::IOUring::Data::arm(size_t slot)
+{
+	URingChannel *channel = channels[slot];
+	io_uring_sqe *sqe = Jupiter::IOUring::Data::get_sqe();
+	if (sqe == nullptr)
+	{
+		Jupiter::IOUring::Data::mark_dirty(slot);
+		return;
+	}
+
+	sqe->fd = channel->descriptor;
+	switch (channel->mode)
+	{
+	case URingMode::STREAM:
+		sqe->opcode = IORING_OP_RECV;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = URING_BUFFER_GROUP;
+		if (multishot_recv)
+			sqe->ioprio = IORING_RECV_MULTISHOT;
+		else
+			sqe->len = buffer_size;
+		sqe->user_data = make_user_data(slot, URING_RECV);
+		break;
+
+	case URingMode::LISTENER:
+		sqe->opcode = IORING_OP_ACCEPT;
+		if (multishot_accept)
+			sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		sqe->user_data = make_user_data(slot, URING_ACCEPT);
+		break;
+
+	case URingMode::WATCH:
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->poll32_events = POLLIN;
+		sqe->user_data = make_user_data(slot, URING_POLL);
+		break;
+	}
+
+	channel->armed = true;
+	++channel->outstanding;
+}
+
+void Jupiter::IOUring::Data::flush_sends(size_t slot)
+{
+	URingChannel *channel = channels[slot];
+
+	// Only one chain may be in flight per channel, so that sends can't be reordered
+	if (channel->in_flight.empty() == false || channel->sends.empty())
+		return;
+
+	// The whole chain must be queued before it's submitted, or it will be split into separate chains
+	size_t length = *sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+	length = length < sq_entries ? sq_entries - length : 0;
+	if (length > channel->sends.size())
+		length = channel->sends.size();
+	if (length > URING_MAX_SEND_CHAIN)
+		length = URING_MAX_SEND_CHAIN;
+
+	while (length != 0)
+	{
+		--length;
+		io_uring_sqe *sqe = Jupiter::IOUring::Data::get_sqe();
+		URingSend &send = channel->sends.front();
+		sqe->opcode = IORING_OP_SEND;
+		sqe->fd = channel->descriptor;
+		sqe->addr = reinterpret_cast<uint64_t>(send.data + send.offset);
+		sqe->len = static_cast<uint32_t>(send.length - send.offset);
+		sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+		sqe->user_data = make_user_data(slot, URING_SEND);
+		if (length != 0)
+			sqe->flags = IOSQE_IO_LINK;
+
+		channel->in_flight.push_back(send);
+		channel->sends.pop_front();
+		++channel->outstanding;
+	}
+
+	if (channel->sends.empty() == false && channel->in_flight.empty())
+		Jupiter::IOUring::Data::mark_dirty(slot); // submission queue full; retry next submit
+}
+
+void Jupiter::IOUring::Data::complete(const io_uring_cqe &cqe)
+{
+	URingOperation operation = static_cast<URingOperation>(cqe.user_data & 0xFF);
+	if (operation == URING_PROVIDE || operation == URING_CANCEL)
+		return;
+
+	size_t slot = static_cast<size_t>(cqe.user_data >> 8);
+	URingChannel *channel = channels[slot];
+	bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+
+	switch (operation)
+	{
+	case URING_RECV:
+		if (cqe.res > 0)
+		{
+			uint16_t buffer_id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+			if (channel->detached)
+				returned_buffers.push_back(buffer_id);
+			else
+				channel->chunks.push_back({ buffer_id, static_cast<uint32_t>(cqe.res), 0 });
+		}
+		else if (cqe.res == 0)
+			channel->eof = true;
+		else if (cqe.res == -EINVAL && multishot_recv)
+			multishot_recv = false; // Kernel doesn't support multishot recv; re-arm as single-shot
+		else if (cqe.res != -ENOBUFS && cqe.res != -ECANCELED && cqe.res != -EAGAIN)
+			channel->error = -cqe.res;
+
+		if (more == false)
+		{
+			channel->armed = false;
+			--channel->outstanding;
+			Jupiter::IOUring::Data::mark_dirty(slot);
+		}
+		break;
+
+	case URING_ACCEPT:
+		if (cqe.res >= 0)
+		{
+			if (channel->detached)
+				::close(cqe.res);
+			else
+				channel->accepted.push_back(cqe.res);
+		}
+		else if (cqe.res == -EINVAL && multishot_accept)
+			multishot_accept = false; // Kernel doesn't support multishot accept; re-arm as single-shot
+
+		if (more == false)
+		{
+			channel->armed = false;
+			--channel->outstanding;
+			Jupiter::IOUring::Data::mark_dirty(slot);
+		}
+		break;
+
+	case URING_POLL:
+		if (cqe.res != -ECANCELED)
+			channel->readable = true; // errors are reported as readable, so that the owner reads them
+		channel->armed = false;
+		--channel->outstanding;
+		break;
+
+	case URING_SEND:
+	{
+		URingSend &send = channel->in_flight[channel->send_completions++];
+		if (cqe.res > 0)
+			send.offset += cqe.res;
+		else if (cqe.res != -ECANCELED && cqe.res != -EAGAIN && cqe.res != -EINTR) // cancelled due to an earlier short send
+			channel->error = -cqe.res;
+		--channel->outstanding;
+
+		if (channel->send_completions == channel->in_flight.size())
+		{
+			// Chain complete; re-queue anything that wasn't fully sent, in order
+			size_t index = channel->in_flight.size();
+			while (index != 0)
+			{
+				URingSend &item = channel->in_flight[--index];
+				if (item.offset < item.length && channel->error == 0)
+					channel->sends.push_front(item);
+				else
+					delete[] item.data;
+			}
+
+			channel->in_flight.clear();
+			channel->send_completions = 0;
+			if (channel->sends.empty() == false)
+				Jupiter::IOUring::Data::mark_dirty(slot);
+		}
+	}
+	break;
+
+	default:
+		break;
+	}
+
+	if (channel->detached && channel->outstanding == 0)
+		Jupiter::IOUring::Data::release(slot);
+}
+
+void Jupiter::IOUring::Data::mark_dirty(size_t slot)
+{
+	URingChannel *channel = channels[slot];
+	if (channel->dirty == false)
+	{
+		channel->dirty = true;
+		dirty.push_back(slot);
+	}
+}
+
+void Jupiter::IOUring::Data::release(size_t slot)
+{
+	URingChannel *channel = channels[slot];
+
+	for (const URingChunk &chunk : channel->chunks)
+		returned_buffers.push_back(chunk.buffer_id);
+
+	for (int descriptor : channel->accepted)
+		::close(descriptor);
+
+	for (const URingSend &send : channel->sends)
+		delete[] send.data;
+
+	for (const URingSend &send : channel->in_flight)
+		delete[] send.data;
+
+	if (channel->dirty)
+	{
+		for (auto itr = dirty.begin(); itr != dirty.end(); ++itr)
+		{
+			if (*itr == slot)
+			{
+				dirty.erase(itr);
+				break;
+			}
+		}
+	}
+
+	delete channel;
+	channels[slot] = nullptr;
+	free_slots.push_back(slot);
+}
+
+int Jupiter::IOUring::Data::find_slot(SocketType descriptor) const
+{
+	if (descriptor < 0 || static_cast<size_t>(descriptor) >= slots.size())
+		return -1;
+
+	return slots[descriptor];
+}
+
+URingChannel *Jupiter::IOUring::Data::find(SocketType descriptor) const
+{
+	int slot = Jupiter::IOUring::Data::find_slot(descriptor);
+	if (slot < 0)
+		return nullptr;
+
+	return channels[slot];
+}
+
+URingChannel *Jupiter::IOUring::Data::add(SocketType descriptor, URingMode mode)
+{
+	if (descriptor < 0 || Jupiter::IOUring::Data::find_slot(descriptor) >= 0)
+		return nullptr;
+
+	size_t slot;
+	if (free_slots.empty())
+	{
+		slot = channels.size();
+		channels.push_back(nullptr);
+	}
+	else
+	{
+		slot = free_slots.back();
+		free_slots.pop_back();
+	}
+
+	if (static_cast<size_t>(descriptor) >= slots.size())
+		slots.resize(descriptor + 1, -1);
+	slots[descriptor] = static_cast<int>(slot);
+
+	URingChannel *channel = new URingChannel();
+	channel->descriptor = descriptor;
+	channel->mode = mode;
+	channel->original_flags = fcntl(descriptor, F_GETFL, 0);
+	channels[slot] = channel;
+
+	// The ring waits for readiness itself; a non-blocking descriptor would only produce EAGAIN
+	if (channel->original_flags != -1 && (channel->original_flags & O_NONBLOCK) != 0)
+		fcntl(descriptor, F_SETFL, channel->original_flags & ~O_NONBLOCK);
+
+	Jupiter::IOUring::Data::mark_dirty(slot);
+	return channel;
+}
+
+void Jupiter::IOUring::Data::detach(SocketType descriptor)
+{
+	int slot = Jupiter::IOUring::Data::find_slot(descriptor);
+	if (slot < 0)
+		return;
+
+	URingChannel *channel = channels[slot];
+
+	// Give queued sends a chance to complete, so that anything sent just before closing isn't lost.
+	std::chrono::steady_clock::time_point linger_end = std::chrono::steady_clock::now() + URING_DETACH_LINGER;
+	while ((channel->sends.empty() == false || channel->in_flight.empty() == false) && channel->error == 0)
+	{
+		std::chrono::milliseconds remaining = std::chrono::duration_cast<std::chrono::milliseconds>(linger_end - std::chrono::steady_clock::now());
+		if (remaining.count() <= 0)
+			break;
+
+		Jupiter::IOUring::Data::flush_sends(slot);
+		Jupiter::IOUring::Data::enter(1, remaining);
+		Jupiter::IOUring::Data::reap();
+	}
+
+	slots[descriptor] = -1;
+	channel->detached = true;
+
+	if (channel->original_flags != -1)
+		fcntl(descriptor, F_SETFL, channel->original_flags);
+
+	// Sends still in flight after the linger are blocked in the kernel and hold a reference to the socket; cancel
+	// them too, so that the channel is released and the descriptor actually closes
+	channel->cancel_pending = channel->armed;
+	channel->cancel_sends_pending = channel->in_flight.empty() == false;
+	if (channel->cancel_pending || channel->cancel_sends_pending)
+		Jupiter::IOUring::Data::cancel(slot);
+
+	if (channel->outstanding == 0)
+		Jupiter::IOUring::Data::release(slot);
+}
+
+void Jupiter::IOUring::Data::cancel(size_t slot)
+{
+	URingChannel *channel = channels[slot];
+	io_uring_sqe *sqe;
+
+	if (channel->cancel_pending)
+	{
+		sqe = Jupiter::IOUring::Data::get_sqe();
+		if (sqe == nullptr)
+		{
+			// Submission queue is still full; retry from prepare() once it's been submitted, since the channel
+			// is only released after its armed operation completes
+			Jupiter::IOUring::Data::mark_dirty(slot);
+			return;
+		}
+
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		switch (channel->mode)
+		{
+		case URingMode::STREAM:
+			sqe->addr = make_user_data(slot, URING_RECV);
+			break;
+		case URingMode::LISTENER:
+			sqe->addr = make_user_data(slot, URING_ACCEPT);
+			break;
+		case URingMode::WATCH:
+			sqe->addr = make_user_data(slot, URING_POLL);
+			break;
+		}
+		sqe->user_data = make_user_data(0, URING_CANCEL);
+		channel->cancel_pending = false;
+	}
+
+	if (channel->cancel_sends_pending)
+	{
+		sqe = Jupiter::IOUring::Data::get_sqe();
+		if (sqe == nullptr)
+		{
+			Jupiter::IOUring::Data::mark_dirty(slot);
+			return;
+		}
+
+		// Sends are linked, so cancelling the one that's blocked fails the rest of the chain along with it
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = make_user_data(slot, URING_SEND);
+#if defined IORING_ASYNC_CANCEL_ALL
+		sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+#endif // IORING_ASYNC_CANCEL_ALL
+		sqe->user_data = make_user_data(0, URING_CANCEL);
+		channel->cancel_sends_pending = false;
+	}
+}
+
+Jupiter::IOUring::Data::~Data()
+{
+	for (URingChannel *channel : channels)
+	{
+		if (channel != nullptr)
+		{
+			for (int descriptor : channel->accepted)
+				::close(descriptor);
+			for (const URingSend &send : channel->sends)
+				delete[] send.data;
+			for (const URingSend &send : channel->in_flight)
+				delete[] send.data;
+			delete channel;
+		}
+	}
+
+	// Closing the ring cancels all outstanding operations
+	if (ring_fd != -1)
+		::close(ring_fd);
+	if (sqes != MAP_FAILED)
+		munmap(sqes, sqes_size);
+	if (cq_ring != MAP_FAILED && cq_ring != sq_ring)
+		munmap(cq_ring, cq_ring_size);
+	if (sq_ring != MAP_FAILED)
+		munmap(sq_ring, sq_ring_size);
+
+	delete[] buffers;
+}
+
+/** IOUring */
+
+bool Jupiter::IOUring::isValid() const
+{
+	return Jupiter::IOUring::data_->valid;
+}
+
+int Jupiter::IOUring::submit(std::chrono::milliseconds wait)
+{
+	if (Jupiter::IOUring::data_->valid == false)
+		return -1;
+
+	Jupiter::IOUring::data_->prepare();
+
+	// Don't wait if there are already completions to collect
+	bool completions_ready = *Jupiter::IOUring::data_->cq_head != __atomic_load_n(Jupiter::IOUring::data_->cq_tail, __ATOMIC_ACQUIRE);
+	if (Jupiter::IOUring::data_->enter(wait.count() > 0 && completions_ready == false ? 1 : 0, wait) < 0 && errno != ETIME && errno != EINTR)
+		return -1;
+
+	return Jupiter::IOUring::data_->reap();
+}
+
+bool Jupiter::IOUring::attach(SocketType descriptor)
+{
+	if (Jupiter::IOUring::data_->valid == false)
+		return false;
+
+	int listening = 0;
+	socklen_t length = sizeof(listening);
+	if (getsockopt(descriptor, SOL_SOCKET, SO_ACCEPTCONN, &listening, &length) != 0)
+		return false;
+
+	return Jupiter::IOUring::data_->add(descriptor, listening != 0 ? URingMode::LISTENER : URingMode::STREAM) != nullptr;
+}
+
+bool Jupiter::IOUring::watch(SocketType descriptor)
+{
+	if (Jupiter::IOUring::data_->valid == false)
+		return false;
+
+	int slot = Jupiter::IOUring::data_->find_slot(descriptor);
+	if (slot < 0)
+	{
+		URingChannel *channel = Jupiter::IOUring::data_->add(descriptor, URingMode::WATCH);
+		if (channel == nullptr)
+			return false;
+
+		slot = Jupiter::IOUring::data_->find_slot(descriptor);
+	}
+
+	URingChannel *channel = Jupiter::IOUring::data_->channels[slot];
+	if (channel->mode != URingMode::WATCH)
+		return false;
+
+	channel->readable = false;
+	if (channel->armed == false)
+		Jupiter::IOUring::data_->arm(slot);
+
+	return true;
+}
+
+bool Jupiter::IOUring::isReadable(SocketType descriptor) const
+{
+	URingChannel *channel = Jupiter::IOUring::data_->find(descriptor);
+	return channel != nullptr && channel->readable;
+}
+
+void Jupiter::IOUring::detach(SocketType descriptor)
+{
+	Jupiter::IOUring::data_->detach(descriptor);
+}
+
+bool Jupiter::IOUring::hasPendingData(SocketType descriptor) const
+{
+	URingChannel *channel = Jupiter::IOUring::data_->find(descriptor);
+	if (channel == nullptr)
+		return false;
+
+	return channel->chunks.empty() == false || channel->accepted.empty() == false || channel->eof || channel->error != 0;
+}
+
+int Jupiter::IOUring::recv(SocketType descriptor, char *out_buffer, size_t in_capacity, bool in_peek)
+{
+	URingChannel *channel = Jupiter::IOUring::data_->find(descriptor);
+	if (channel == nullptr)
+	{
+		errno = EBADF;
+		return -1;
+	}
+
+	size_t total = 0;
+	auto itr = channel->chunks.begin();
+	while (itr != channel->chunks.end() && total != in_capacity)
+	{
+		size_t length = itr->length - itr->offset;
+		if (length > in_capacity - total)
+			length = in_capacity - total;
+
+		memcpy(out_buffer + total, Jupiter::IOUring::data_->buffers + static_cast<size_t>(itr->buffer_id) * Jupiter::IOUring::data_->buffer_size + itr->offset, length);
+		total += length;
+
+		if (in_peek)
+			++itr;
+		else
+		{
+			itr->offset += static_cast<uint32_t>(length);
+			if (itr->offset == itr->length)
+			{
+				Jupiter::IOUring::data_->returned_buffers.push_back(itr->buffer_id);
+				channel->chunks.pop_front();
+				itr = channel->chunks.begin();
+			}
+		}
+	}
+
+	if (total != 0)
+		return static_cast<int>(total);
+
+	if (channel->eof)
+		return 0;
+
+	errno = channel->error != 0 ? channel->error : EWOULDBLOCK;
+	return -1;
+}
+
+int Jupiter::IOUring::send(SocketType descriptor, const char *in_data, size_t in_length)
+{
+	int slot = Jupiter::IOUring::data_->find_slot(descriptor);
+	if (slot < 0)
+	{
+		errno = EBADF;
+		return -1;
+	}
+
+	URingChannel *channel = Jupiter::IOUring::data_->channels[slot];
+	if (channel->error != 0)
+	{
+		errno = channel->error;
+		return -1;
+	}
+
+	if (in_length == 0)
+		return 0;
+
+	URingSend send;
+	send.data = new char[in_length];
+	memcpy(send.data, in_data, in_length);
+	send.length = in_length;
+	send.offset = 0;
+	channel->sends.push_back(send);
+	Jupiter::IOUring::data_->mark_dirty(slot);
+	return static_cast<int>(in_length);
+}
+
+Jupiter::IOUring::SocketType Jupiter::IOUring::accept(SocketType descriptor)
+{
+	URingChannel *channel = Jupiter::IOUring::data_->find(descriptor);
+	if (channel == nullptr)
+	{
+		errno = EBADF;
+		return -1;
+	}
+
+	if (channel->accepted.empty())
+	{
+		errno = EWOULDBLOCK;
+		return -1;
+	}
+
+	SocketType result = channel->accepted.front();
+	channel->accepted.pop_front();
+	return result;
+}
+
+Jupiter::IOUring::IOUring(unsigned int in_entries, unsigned int in_buffer_count, unsigned int in_buffer_size)
+{
+	Jupiter::IOUring::data_ = new Jupiter::IOUring::Data();
+	Data *data = Jupiter::IOUring::data_;
+
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CLAMP;
+
+	data->ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, in_entries, &params));
+	if (data->ring_fd < 0)
+	{
+		data->ring_fd = -1;
+		return;
+	}
+
+	// EXT_ARG (5.11) is needed for timed waits; NODROP prevents completions from being lost.
+	if ((params.features & IORING_FEAT_EXT_ARG) == 0 || (params.features & IORING_FEAT_NODROP) == 0)
+		return;
+
+	// Verify that all required operations are supported
+	{
+		size_t probe_size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+		std::vector<char> probe_buffer(probe_size, 0);
+		io_uring_probe *probe = reinterpret_cast<io_uring_probe *>(probe_buffer.data());
+		if (syscall(__NR_io_uring_register, data->ring_fd, IORING_REGISTER_PROBE, probe, 256) < 0)
+			return;
+
+		static const uint8_t required_ops[] = { IORING_OP_RECV, IORING_OP_SEND, IORING_OP_ACCEPT, IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL, IORING_OP_PROVIDE_BUFFERS };
+		for (uint8_t op : required_ops)
+			if (op > probe->last_op || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0)
+				return;
+	}
+
+	// Map the rings
+	data->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	data->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (data->cq_ring_size > data->sq_ring_size)
+			data->sq_ring_size = data->cq_ring_size;
+		data->cq_ring_size = data->sq_ring_size;
+	}
+
+	data->sq_ring = mmap(nullptr, data->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, data->ring_fd, IORING_OFF_SQ_RING);
+	if (data->sq_ring == MAP_FAILED)
+		return;
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		data->cq_ring = data->sq_ring;
+	else
+	{
+		data->cq_ring = mmap(nullptr, data->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, data->ring_fd, IORING_OFF_CQ_RING);
+		if (data->cq_ring == MAP_FAILED)
+			return;
+	}
+
+	data->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+	data->sqes = static_cast<io_uring_sqe *>(mmap(nullptr, data->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, data->ring_fd, IORING_OFF_SQES));
+	if (data->sqes == MAP_FAILED)
+		return;
+
+	char *sq = static_cast<char *>(data->sq_ring);
+	data->sq_head = reinterpret_cast<unsigned int *>(sq + params.sq_off.head);
+	data->sq_tail = reinterpret_cast<unsigned int *>(sq + params.sq_off.tail);
+	data->sq_mask = reinterpret_cast<unsigned int *>(sq + params.sq_off.ring_mask);
+	data->sq_array = reinterpret_cast<unsigned int *>(sq + params.sq_off.array);
+	data->sq_entries = params.sq_entries;
+
+	char *cq = static_cast<char *>(data->cq_ring);
+	data->cq_head = reinterpret_cast<unsigned int *>(cq + params.cq_off.head);
+	data->cq_tail = reinterpret_cast<unsigned int *>(cq + params.cq_off.tail);
+	data->cq_mask = reinterpret_cast<unsigned int *>(cq + params.cq_off.ring_mask);
+	data->cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+	// Provide the receive buffers; buffer IDs are 16 bits
+	if (in_buffer_count > 65536)
+		in_buffer_count = 65536;
+	data->buffer_count = in_buffer_count;
+	data->buffer_size = in_buffer_size;
+	data->buffers = new char[static_cast<size_t>(in_buffer_count) * in_buffer_size];
+
+	io_uring_sqe *sqe = data->get_sqe();
+	sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+	sqe->fd = static_cast<int>(in_buffer_count);
+	sqe->addr = reinterpret_cast<uint64_t>(data->buffers);
+	sqe->len = in_buffer_size;
+	sqe->off = 0;
+	sqe->buf_group = URING_BUFFER_GROUP;
+	sqe->user_data = make_user_data(0, URING_PROVIDE);
+
+	if (data->enter(1, std::chrono::milliseconds(1000)) < 0)
+		return;
+
+	io_uring_cqe &cqe = data->cqes[*data->cq_head & *data->cq_mask];
+	bool provided = *data->cq_head != __atomic_load_n(data->cq_tail, __ATOMIC_ACQUIRE) && cqe.res >= 0;
+	data->reap();
+
+	data->valid = provided;
+}
+
+Jupiter::IOUring::~IOUring()
+{
+	delete Jupiter::IOUring::data_;
+}
+
+#else // __linux__
+
+/** io_uring is unavailable on this platform; the ring is never valid. */
+
+struct Jupiter::IOUring::Data
+{
+};
+
+bool Jupiter::IOUring::isValid() const
+{
+	return false;
+}
+
+int Jupiter::IOUring::submit(std::chrono::milliseconds)
+{
+	return -1;
+}
+
+bool Jupiter::IOUring::attach(SocketType)
+{
+	return false;
+}
+
+bool Jupiter::IOUring::watch(SocketType)
+{
+	return false;
+}
+
+bool Jupiter::IOUring::isReadable(SocketType) const
+{
+	return false;
+}
+
+void Jupiter::IOUring::detach(SocketType)
+{
+}
+
+bool Jupiter::IOUring::hasPendingData(SocketType) const
+{
+	return false;
+}
+
+int Jupiter::IOUring::recv(SocketType, char *, size_t, bool)
+{
+	return -1;
+}
+
+int Jupiter::IOUring::send(SocketType, const char *, size_t)
+{
+	return -1;
+}
+
+Jupiter::IOUring::SocketType Jupiter::IOUring::accept(SocketType)
+{
+	return static_cast<SocketType>(~0);
+}
+
+Jupiter::IOUring::IOUring(unsigned int, unsigned int, unsigned int)
+{
+	Jupiter::IOUring::data_ = new Jupiter::IOUring::Data();
+}
+
+Jupiter::IOUring::~IOUring()
+{
+	delete Jupiter::IOUring::data_;
+}
+
+#endif // __linux__
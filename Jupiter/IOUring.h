@@ -0,0 +1,165 @@
+/**
+ * Copyright (C) 2017 Jessica James.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Written by Jessica James <jessica.aj@outlook.com>
+ */
+
+#if !defined _IOURING_H_HEADER
+#define _IOURING_H_HEADER
+
+/**
+ * @file IOUring.h
+ * @brief Provides an io_uring based I/O backend for sockets.
+ */
+
+#include <chrono>
+#include "Jupiter.h"
+#include "Socket.h"
+
+namespace Jupiter
+{
+	/**
+	* @brief Provides an io_uring backed I/O backend, which sockets may be attached to using Socket::setIOUring().
+	* Operations on attached sockets never make system calls; instead, they are queued, and everything queued is
+	* submitted in a single io_uring_enter() call by submit(), which also collects completions.
+	*
+	* Attached stream sockets receive through a multishot recv using ring-provided buffers, listening sockets
+	* accept through a multishot accept, and sends on a socket are submitted as a linked chain so that they
+	* complete in order.
+	*
+	* Note: This is only available on Linux; check isValid() after construction, and fall back to another
+	* mechanism (i.e: epoll) when it returns false.
+	*/
+	class JUPITER_API IOUring
+	{
+	public:
+		typedef Jupiter::Socket::SocketType SocketType;
+
+		/**
+		* @brief Checks if the ring was successfully created, and the kernel supports all required operations.
+		*
+		* @return True if the ring is usable, false otherwise.
+		*/
+		bool isValid() const;
+
+		/**
+		* @brief Submits all queued operations, and collects any completions.
+		* This makes at most one io_uring_enter() call.
+		*
+		* @param wait Maximum amount of time to wait for a completion if none are available.
+		* @return Number of completions collected on success, -1 otherwise.
+		*/
+		int submit(std::chrono::milliseconds wait = std::chrono::milliseconds(0));
+
+		/**
+		* @brief Attaches a socket's descriptor to the ring. Listening sockets are armed for accepting; other sockets for receiving.
+		* Note: Socket::setIOUring() should be used instead of calling this directly.
+		*
+		* @param descriptor Socket descriptor to attach
+		* @return True on success, false otherwise.
+		*/
+		bool attach(SocketType descriptor);
+
+		/**
+		* @brief Watches a descriptor for readability, without the ring reading any data from it.
+		* The watch fires at most once; call watch() again after handling it to re-arm.
+		*
+		* @param descriptor Socket descriptor to watch
+		* @return True on success, false otherwise.
+		*/
+		bool watch(SocketType descriptor);
+
+		/**
+		* @brief Checks if a watched descriptor has been reported readable since it was last armed.
+		*
+		* @param descriptor Watched socket descriptor
+		* @return True if the descriptor is readable, false otherwise.
+		*/
+		bool isReadable(SocketType descriptor) const;
+
+		/**
+		* @brief Detaches a descriptor from the ring, cancelling any outstanding operations on it.
+		* Any data received but not yet read is discarded.
+		*
+		* @param descriptor Socket descriptor to detach
+		*/
+		void detach(SocketType descriptor);
+
+		/**
+		* @brief Checks if an attached descriptor has received data, accepted connections, or a result (end of file or error) waiting to be read.
+		*
+		* @param descriptor Attached socket descriptor
+		* @return True if the next recv() or accept() will not fail with EWOULDBLOCK, false otherwise.
+		*/
+		bool hasPendingData(SocketType descriptor) const;
+
+		/**
+		* @brief Copies received data for an attached descriptor into a buffer.
+		*
+		* @param descriptor Attached socket descriptor
+		* @param out_buffer Buffer to copy data to
+		* @param in_capacity Size of out_buffer
+		* @param in_peek True if the data should be left in place, false if it should be consumed
+		* @return Number of bytes copied on success, 0 on end of file, -1 otherwise (with errno set).
+		*/
+		int recv(SocketType descriptor, char *out_buffer, size_t in_capacity, bool in_peek = false);
+
+		/**
+		* @brief Queues data to be sent on an attached descriptor.
+		* The data is copied, and sent when submit() is next called.
+		*
+		* @param descriptor Attached socket descriptor
+		* @param in_data Data to send
+		* @param in_length Length of in_data
+		* @return in_length on success, -1 otherwise (with errno set).
+		*/
+		int send(SocketType descriptor, const char *in_data, size_t in_length);
+
+		/**
+		* @brief Fetches a connection accepted on an attached listening descriptor.
+		*
+		* @param descriptor Attached listening socket descriptor
+		* @return Accepted socket descriptor on success, -1 otherwise (with errno set).
+		*/
+		SocketType accept(SocketType descriptor);
+
+		/**
+		* @brief Constructor for the IOUring class.
+		*
+		* @param in_entries Number of submission queue entries
+		* @param in_buffer_count Number of receive buffers provided to the kernel
+		* @param in_buffer_size Size of each receive buffer
+		*/
+		IOUring(unsigned int in_entries = 256, unsigned int in_buffer_count = 256, unsigned int in_buffer_size = 4096);
+
+		/**
+		* @brief Copying an IOUring is forbidden.
+		*/
+		IOUring(const IOUring &) = delete;
+
+		/**
+		* @brief Destructor for the IOUring class.
+		* Note: All sockets should be detached before destroying the ring.
+		*/
+		~IOUring();
+
+	/** Private members */
+	private:
+		struct Data;
+		Data *data_;
+	}; // Jupiter::IOUring class
+} // Jupiter namespace
+
+#endif // _IOURING_H_HEADER
@@ -19,6 +19,9 @@
 #include <cstring>
 #include <cstdio>
 #include <ctime>
+#include <cctype>
+#include <algorithm>
+#include <type_traits>
 #include "Jupiter.h"
 #include "Functions.h"
 #include "IRC_Client.h"
@@ -37,12 +40,40 @@
 #include <unistd.h>
 #endif // _WIN32
 
+#if defined _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+
 using namespace Jupiter::literals;
 
+/** Copies strings passed to offloaded plugin hooks, since the originals only remain valid while the line is processed */
+static Jupiter::StringS copy_hook_argument(const Jupiter::ReadableString &in_string)
+{
+	return Jupiter::StringS(in_string);
+}
+
+template<typename T> static typename std::enable_if<std::is_arithmetic<T>::value, T>::type copy_hook_argument(T in_value)
+{
+	return in_value;
+}
+
+/** Returns the index of the lowest set bit in a non-zero mask (i.e: the most significant channel prefix) */
+static size_t find_first_set(uint32_t in_mask)
+{
+#if defined _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, in_mask);
+	return index;
+#else // _MSC_VER
+	return static_cast<size_t>(__builtin_ctz(in_mask));
+#endif // _MSC_VER
+}
+
 Jupiter::IRC::Client::Client(Jupiter::Config *in_primary_section, Jupiter::Config *in_secondary_section)
 {
 	m_primary_section = in_primary_section;
 	m_secondary_section = in_secondary_section;
+	m_network_thread = std::this_thread::get_id();
 
 	if (m_primary_section != nullptr)
 		m_primary_section_name = m_primary_section->getName();
@@ -82,35 +113,71 @@ Jupiter::IRC::Client::Client(Jupiter::Config *in_primary_section, Jupiter::Confi
 	m_server_port = (unsigned short)Jupiter::IRC::Client::readConfigInt("Port"_jrs, m_ssl ? 994 : 194);
 	m_default_chan_type = Jupiter::IRC::Client::readConfigInt("Channel.Type"_jrs);
 
+	m_flood_lines = std::max(Jupiter::IRC::Client::readConfigInt("FloodControl.Lines"_jrs), 0);
+	m_flood_bytes = std::max(Jupiter::IRC::Client::readConfigInt("FloodControl.Bytes"_jrs), 0);
+	m_flood_window = std::chrono::milliseconds(std::max(Jupiter::IRC::Client::readConfigInt("FloodControl.Window"_jrs, 10000), 0));
+	m_max_outbound_queue_size = std::max(Jupiter::IRC::Client::readConfigInt("FloodControl.MaxQueue"_jrs, 1024), 0);
+	Jupiter::IRC::Client::resetFloodTokens();
+
 	if (Jupiter::IRC::Client::readConfigBool("PrintOutput"_jrs, true))
-		m_output = stdout;
-	else
-		m_output = nullptr;
+		m_output = std::make_shared<Jupiter::LogWriter::Output>(stdout);
 	if (m_log_file_name.isNotEmpty())
-		m_log_file = fopen(m_log_file_name.c_str(), "a+b");
-	else m_log_file = nullptr;
+		m_log_output = std::make_shared<Jupiter::LogWriter::Output>(m_log_file_name.c_str(), static_cast<size_t>(std::max(Jupiter::IRC::Client::readConfigLong("LogFile.MaxSize"_jrs), 0L)), Jupiter::IRC::Client::readConfigBool("LogFile.RotateDaily"_jrs));
+
+	// Shared by every secure socket this client creates, so that reconnections can resume the last session
+	m_ssl_context = std::make_shared<Jupiter::SecureSocket::Context>();
+	if (m_ssl_certificate.isNotEmpty())
+		m_ssl_context->setCertificate(m_ssl_certificate, m_ssl_key);
 
 	if (m_ssl)
 	{
 		Jupiter::SecureTCPSocket *t = new Jupiter::SecureTCPSocket();
-		if (m_ssl_certificate.isNotEmpty())
-			t->setCertificate(m_ssl_certificate, m_ssl_key);
+		Jupiter::IRC::Client::setupSecureSocket(*t);
 		m_socket = t;
 	}
 	else m_socket = new Jupiter::TCPSocket();
 
 	m_connection_status = 0;
+
+	Jupiter::IRC::Client::setCommandHandler("PRIVMSG"_jrs, &Jupiter::IRC::Client::handlePRIVMSG);
+	Jupiter::IRC::Client::setCommandHandler("NOTICE"_jrs, &Jupiter::IRC::Client::handleNOTICE);
+	Jupiter::IRC::Client::setCommandHandler("NICK"_jrs, &Jupiter::IRC::Client::handleNICK);
+	Jupiter::IRC::Client::setCommandHandler("JOIN"_jrs, &Jupiter::IRC::Client::handleJOIN);
+	Jupiter::IRC::Client::setCommandHandler("PART"_jrs, &Jupiter::IRC::Client::handlePART);
+	Jupiter::IRC::Client::setCommandHandler("KICK"_jrs, &Jupiter::IRC::Client::handleKICK);
+	Jupiter::IRC::Client::setCommandHandler("QUIT"_jrs, &Jupiter::IRC::Client::handleQUIT);
+	Jupiter::IRC::Client::setCommandHandler("INVITE"_jrs, &Jupiter::IRC::Client::handleINVITE);
+	Jupiter::IRC::Client::setCommandHandler("MODE"_jrs, &Jupiter::IRC::Client::handleMODE);
+	Jupiter::IRC::Client::setCommandHandler("PING"_jrs, &Jupiter::IRC::Client::handlePING);
+	Jupiter::IRC::Client::setCommandHandler("ERROR"_jrs, &Jupiter::IRC::Client::handleERROR);
+	Jupiter::IRC::Client::setCommandHandler("AUTHENTICATE"_jrs, &Jupiter::IRC::Client::handleAUTHENTICATE);
+	// ACCOUNT, CHGHOST
+	Jupiter::IRC::Client::setNumericHandler(Reply::NAMREPLY, &Jupiter::IRC::Client::handleNAMREPLY);
+	Jupiter::IRC::Client::setNumericHandler(Reply::ENDOFNAMES, &Jupiter::IRC::Client::handleENDOFNAMES);
+	Jupiter::IRC::Client::setNumericHandler(Error::NOSUCHCHANNEL, &Jupiter::IRC::Client::handleJoinError);
+	Jupiter::IRC::Client::setNumericHandler(Error::TOOMANYCHANNELS, &Jupiter::IRC::Client::handleJoinError);
+	Jupiter::IRC::Client::setNumericHandler(Error::UNAVAILRESOURCE, &Jupiter::IRC::Client::handleJoinError);
+	Jupiter::IRC::Client::setNumericHandler(Error::LINKCHANNEL, &Jupiter::IRC::Client::handleJoinError);
+	Jupiter::IRC::Client::setNumericHandler(Error::CHANNELISFULL, &Jupiter::IRC::Client::handleJoinError);
+	Jupiter::IRC::Client::setNumericHandler(Error::INVITEONLYCHAN, &Jupiter::IRC::Client::handleJoinError);
+	Jupiter::IRC::Client::setNumericHandler(Error::BANNEDFROMCHAN, &Jupiter::IRC::Client::handleJoinError);
+	Jupiter::IRC::Client::setNumericHandler(Error::BADCHANNELKEY, &Jupiter::IRC::Client::handleJoinError);
+	Jupiter::IRC::Client::setNumericHandler(Error::BADCHANMASK, &Jupiter::IRC::Client::handleJoinError);
+	Jupiter::IRC::Client::setNumericHandler(Error::NEEDREGGEDNICK, &Jupiter::IRC::Client::handleJoinError);
+	Jupiter::IRC::Client::setNumericHandler(Error::SECUREONLYCHAN, &Jupiter::IRC::Client::handleJoinError);
+	Jupiter::IRC::Client::setNumericHandler(Error::OPERONLY, &Jupiter::IRC::Client::handleJoinError);
 }
 
 Jupiter::IRC::Client::~Client()
 {
+	// Wait for offloaded plugin hooks, which may still refer to this client
+	m_channel_strands.erase();
+	m_strand = nullptr;
+
 	m_socket->close();
 
 	if (m_socket != nullptr)
 		delete m_socket;
-
-	if (m_log_file != nullptr)
-		fclose(m_log_file);
 }
 
 void Jupiter::IRC::Client::OnConnect()
@@ -118,6 +185,11 @@ void Jupiter::IRC::Client::OnConnect()
 	return;
 }
 
+void Jupiter::IRC::Client::OnAutoJoinSynced()
+{
+	return;
+}
+
 void Jupiter::IRC::Client::OnDisconnect()
 {
 	return;
@@ -138,6 +210,11 @@ void Jupiter::IRC::Client::OnNumeric(long int, const Jupiter::ReadableString &)
 	return;
 }
 
+void Jupiter::IRC::Client::OnMessage(const Jupiter::IRC::Message &)
+{
+	return;
+}
+
 void Jupiter::IRC::Client::OnError(const Jupiter::ReadableString &)
 {
 	return;
@@ -251,6 +328,11 @@ const Jupiter::ReadableString &Jupiter::IRC::Client::getPrefixModes() const
 	return m_prefix_modes;
 }
 
+Jupiter::IRC::Client::CaseMapping Jupiter::IRC::Client::getCaseMapping() const
+{
+	return m_case_mapping;
+}
+
 const Jupiter::ReadableString &Jupiter::IRC::Client::getNickname() const
 {
 	return m_nickname;
@@ -303,29 +385,32 @@ int Jupiter::IRC::Client::getDefaultChanType() const
 
 FILE *Jupiter::IRC::Client::getPrintOutput() const
 {
-	return m_output;
-}
+	if (m_output == nullptr)
+		return nullptr;
 
-void Jupiter::IRC::Client::setPrintOutput(FILE *f)
-{
-	m_output = f;
+	return m_output->getStream();
 }
 
-inline Jupiter::ReferenceString getSender(const Jupiter::ReadableString &line)
+void Jupiter::IRC::Client::setPrintOutput(FILE *f)
 {
-	return Jupiter::ReferenceString::getWord(line, 0, ":! ");
+	if (f == nullptr)
+		m_output = nullptr;
+	else
+		m_output = std::make_shared<Jupiter::LogWriter::Output>(f);
 }
 
 int Jupiter::IRC::Client::getAccessLevel(const Channel &in_channel, const Jupiter::ReadableString &in_nickname) const
 {
-	char prefix = in_channel.getUserPrefix(in_nickname);
-	if (prefix != 0)
-		return static_cast<int>(m_prefixes.size() - m_prefixes.find(prefix));
+	Channel::User *user = in_channel.getUser(in_nickname);
+	if (user != nullptr && user->getPrefixMask() != 0)
+		return static_cast<int>(m_prefixes.size() - find_first_set(user->getPrefixMask()));
+
+	return 0;
 }
 
 int Jupiter::IRC::Client::getAccessLevel(const Jupiter::ReadableString &in_channel, const Jupiter::ReadableString &in_nickname) const
 {
-	Jupiter::IRC::Client::Channel *channel = m_channels.get(in_channel);
+	Jupiter::IRC::Client::Channel *channel = Jupiter::IRC::Client::getChannel(in_channel);
 
 	if (channel != nullptr)
 		return this->getAccessLevel(*channel, in_nickname);
@@ -333,12 +418,41 @@ int Jupiter::IRC::Client::getAccessLevel(const Jupiter::ReadableString &in_chann
 	return 0;
 }
 
-void Jupiter::IRC::Client::send(const Jupiter::ReadableString &rawMessage)
+void Jupiter::IRC::Client::send(const Jupiter::ReadableString &rawMessage, SendPriority in_priority)
 {
 	Jupiter::StringS out = rawMessage;
 	out += ENDL;
 
-	m_socket->send(out);
+	Jupiter::IRC::Client::scheduleSend(std::move(out), in_priority);
+}
+
+size_t Jupiter::IRC::Client::getOutboundQueueSize() const
+{
+	return m_outbound_queue_size;
+}
+
+size_t Jupiter::IRC::Client::getOutboundQueueSize(SendPriority in_priority) const
+{
+	return m_outbound_queues[static_cast<size_t>(in_priority)].size();
+}
+
+size_t Jupiter::IRC::Client::getOutboundDropCount() const
+{
+	return m_outbound_drop_count;
+}
+
+std::chrono::milliseconds Jupiter::IRC::Client::getSendLag() const
+{
+	if (m_outbound_queue_size == 0)
+		return std::chrono::milliseconds(0);
+
+	// Each lane is in queue order, so the oldest message is at the front of one of them
+	std::chrono::steady_clock::time_point oldest = std::chrono::steady_clock::time_point::max();
+	for (const auto &queue : m_outbound_queues)
+		if (queue.empty() == false && queue.front().m_queue_time < oldest)
+			oldest = queue.front().m_queue_time;
+
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - oldest);
 }
 
 const Jupiter::IRC::Client::UserTableType &Jupiter::IRC::Client::getUsers() const
@@ -353,7 +467,7 @@ size_t Jupiter::IRC::Client::getUserCount() const
 
 Jupiter::IRC::Client::User *Jupiter::IRC::Client::getUser(const Jupiter::ReadableString &in_nickname) const
 {
-	return m_users.get(in_nickname);
+	return Jupiter::IRC::Client::findUser(in_nickname);
 }
 
 const Jupiter::IRC::Client::ChannelTableType &Jupiter::IRC::Client::getChannels() const
@@ -368,7 +482,12 @@ size_t Jupiter::IRC::Client::getChannelCount() const
 
 Jupiter::IRC::Client::Channel *Jupiter::IRC::Client::getChannel(const Jupiter::ReadableString &in_channel) const
 {
-	return m_channels.get(in_channel);
+	std::shared_ptr<Channel> *channel = m_channels.get(Key(in_channel, m_case_mapping));
+
+	if (channel != nullptr)
+		return channel->get();
+
+	return nullptr;
 }
 
 bool Jupiter::IRC::Client::isAutoReconnect() const
@@ -383,61 +502,178 @@ void Jupiter::IRC::Client::setAutoReconnect(int val)
 
 void Jupiter::IRC::Client::joinChannel(const Jupiter::ReadableString &in_channel)
 {
-	m_socket->send(Jupiter::StringS::Format("JOIN %.*s" ENDL, in_channel.size(), in_channel.ptr()));
+	Jupiter::IRC::Client::scheduleSend(Jupiter::StringS::Format("JOIN %.*s" ENDL, in_channel.size(), in_channel.ptr()), SendPriority::INTERACTIVE);
 }
 
 void Jupiter::IRC::Client::joinChannel(const Jupiter::ReadableString &in_channel, const Jupiter::ReadableString &in_password)
 {
-	m_socket->send(Jupiter::StringS::Format("JOIN %.*s %.*s" ENDL, in_channel.size(), in_channel.ptr(), in_password.size(), in_password.ptr()));
+	Jupiter::IRC::Client::scheduleSend(Jupiter::StringS::Format("JOIN %.*s %.*s" ENDL, in_channel.size(), in_channel.ptr(), in_password.size(), in_password.ptr()), SendPriority::INTERACTIVE);
+}
+
+void Jupiter::IRC::Client::joinChannels(const std::vector<const Jupiter::ReadableString *> &in_channels, const std::vector<const Jupiter::ReadableString *> &in_keys)
+{
+	static constexpr size_t max_line_length = 512; // including line ending
+	static constexpr size_t command_length = 5; // "JOIN "
+
+	// Only the network thread may touch the socket; lines from offloaded hooks are marshalled back one by one
+	std::unique_ptr<Jupiter::Socket::Cork> cork;
+	if (Jupiter::IRC::Client::isNetworkThread())
+		cork.reset(new Jupiter::Socket::Cork(*m_socket));
+
+	size_t index = 0;
+	while (index != in_channels.size())
+	{
+		Jupiter::StringS channels(max_line_length);
+		Jupiter::StringS keys(max_line_length);
+		size_t channel_count = 0;
+		size_t key_count = 0;
+
+		// Add channels until the server's limit is reached, or the next channel won't fit
+		for (; index != in_channels.size(); ++index)
+		{
+			const Jupiter::ReadableString &channel = *in_channels[index];
+			const Jupiter::ReadableString *key = index < in_keys.size() && in_keys[index] != nullptr && in_keys[index]->isNotEmpty() ? in_keys[index] : nullptr;
+
+			if (channel_count != 0)
+			{
+				size_t channels_length = channels.size() + 1 + channel.size();
+				size_t keys_length = key == nullptr ? keys.size() : keys.size() + 1 + key->size();
+				if (channel_count == m_max_join_targets
+					|| (key != nullptr && key_count != channel_count) // keys only apply to the leading channels
+					|| command_length + channels_length + (keys_length != 0 ? 1 + keys_length : 0) + 2 > max_line_length)
+					break;
+
+				channels.concat(',');
+				if (key != nullptr)
+					keys.concat(',');
+			}
+
+			channels.concat(channel);
+			if (key != nullptr)
+			{
+				keys.concat(*key);
+				++key_count;
+			}
+			++channel_count;
+		}
+
+		Jupiter::StringS line(max_line_length);
+		line.concat("JOIN "_jrs);
+		line.concat(channels);
+		if (keys.isNotEmpty())
+		{
+			line.concat(' ');
+			line.concat(keys);
+		}
+		line.concat(ENDL);
+		Jupiter::IRC::Client::scheduleSend(std::move(line), SendPriority::INTERACTIVE);
+	}
+}
+
+bool Jupiter::IRC::Client::isAutoJoinSynced() const
+{
+	return m_pending_auto_joins.size() == 0;
+}
+
+size_t Jupiter::IRC::Client::getPendingAutoJoinCount() const
+{
+	return m_pending_auto_joins.size();
 }
 
 void Jupiter::IRC::Client::partChannel(const Jupiter::ReadableString &in_channel)
 {
-	m_socket->send(Jupiter::StringS::Format("PART %.*s" ENDL, in_channel.size(), in_channel.ptr()));
+	Jupiter::IRC::Client::scheduleSend(Jupiter::StringS::Format("PART %.*s" ENDL, in_channel.size(), in_channel.ptr()), SendPriority::INTERACTIVE);
 
-	m_channels.get(in_channel)->setType(-2);
+	Channel *channel = Jupiter::IRC::Client::getChannel(in_channel);
+	if (channel != nullptr)
+		channel->setType(-2);
 }
 
 void Jupiter::IRC::Client::partChannel(const Jupiter::ReadableString &in_channel, const Jupiter::ReadableString &in_message)
 {
-	m_socket->send(Jupiter::StringS::Format("PART %.*s :%.*s" ENDL, in_channel.size(), in_channel.ptr(), in_message.size(), in_message.ptr()));
+	Jupiter::IRC::Client::scheduleSend(Jupiter::StringS::Format("PART %.*s :%.*s" ENDL, in_channel.size(), in_channel.ptr(), in_message.size(), in_message.ptr()), SendPriority::INTERACTIVE);
 	
-	m_channels.get(in_channel)->setType(-2);
+	Channel *channel = Jupiter::IRC::Client::getChannel(in_channel);
+	if (channel != nullptr)
+		channel->setType(-2);
 }
 
 void Jupiter::IRC::Client::sendMessage(const Jupiter::ReadableString &dest, const Jupiter::ReadableString &message)
 {
-	m_socket->send(Jupiter::StringS::Format("PRIVMSG %.*s :%.*s" ENDL, dest.size(), dest.ptr(), message.size(), message.ptr()));
+	Jupiter::IRC::Client::scheduleSend(Jupiter::StringS::Format("PRIVMSG %.*s :%.*s" ENDL, dest.size(), dest.ptr(), message.size(), message.ptr()), SendPriority::INTERACTIVE);
 }
 
 void Jupiter::IRC::Client::sendNotice(const Jupiter::ReadableString &dest, const Jupiter::ReadableString &message)
 {
-	m_socket->send(Jupiter::StringS::Format("NOTICE %.*s :%.*s" ENDL, dest.size(), dest.ptr(), message.size(), message.ptr()));
+	Jupiter::IRC::Client::scheduleSend(Jupiter::StringS::Format("NOTICE %.*s :%.*s" ENDL, dest.size(), dest.ptr(), message.size(), message.ptr()), SendPriority::INTERACTIVE);
 }
 
 size_t Jupiter::IRC::Client::messageChannels(int type, const Jupiter::ReadableString &message)
 {
-	auto message_channel_callback = [this, type, &message](ChannelTableType::Bucket::Entry &in_entry)
+	std::vector<const Jupiter::ReadableString *> targets;
+	auto message_channel_callback = [type, &targets](ChannelTableType::Bucket::Entry &in_entry)
 	{
-		if (in_entry.value.getType() == type)
-			this->sendMessage(in_entry.value.getName(), message);
+		if (in_entry.value->getType() == type)
+			targets.push_back(&in_entry.value->getName());
 	};
 
 	m_channels.callback(message_channel_callback);
 
-	return m_channels.size();
+	Jupiter::IRC::Client::sendMessage(targets, message, SendPriority::BULK);
+	return targets.size();
 }
 
 size_t Jupiter::IRC::Client::messageChannels(const Jupiter::ReadableString &message)
 {
-	auto message_channel_callback = [this, &message](ChannelTableType::Bucket::Entry &in_entry)
+	std::vector<const Jupiter::ReadableString *> targets;
+	targets.reserve(m_channels.size());
+	auto message_channel_callback = [&targets](ChannelTableType::Bucket::Entry &in_entry)
 	{
-		this->sendMessage(in_entry.value.getName(), message);
+		targets.push_back(&in_entry.value->getName());
 	};
 
 	m_channels.callback(message_channel_callback);
 
-	return m_channels.size();
+	Jupiter::IRC::Client::sendMessage(targets, message, SendPriority::BULK);
+	return targets.size();
+}
+
+void Jupiter::IRC::Client::sendMessage(const std::vector<const Jupiter::ReadableString *> &in_targets, const Jupiter::ReadableString &in_message, SendPriority in_priority)
+{
+	static constexpr size_t max_line_length = 512; // including line ending
+
+	if (in_targets.empty())
+		return;
+
+	// The payload is formatted once, and shared by every line
+	Jupiter::StringS payload = Jupiter::StringS::Format(" :%.*s" ENDL, in_message.size(), in_message.ptr());
+
+	// Only the network thread may touch the socket; lines from offloaded hooks are marshalled back one by one
+	std::unique_ptr<Jupiter::Socket::Cork> cork;
+	if (Jupiter::IRC::Client::isNetworkThread())
+		cork.reset(new Jupiter::Socket::Cork(*m_socket));
+
+	size_t index = 0;
+	while (index != in_targets.size())
+	{
+		Jupiter::StringS line(max_line_length);
+		line.concat("PRIVMSG "_jrs);
+		line.concat(*in_targets[index]);
+		size_t target_count = 1;
+
+		// Add targets until the server's limit is reached, or the next target won't fit
+		while (++index != in_targets.size()
+			&& target_count != m_max_privmsg_targets
+			&& line.size() + 1 + in_targets[index]->size() + payload.size() <= max_line_length)
+		{
+			line.concat(',');
+			line.concat(*in_targets[index]);
+			++target_count;
+		}
+
+		line.concat(payload);
+		Jupiter::IRC::Client::scheduleSend(std::move(line), in_priority);
+	}
 }
 
 int Jupiter::IRC::Client::process_line(const Jupiter::ReadableString &line)
@@ -446,769 +682,910 @@ int Jupiter::IRC::Client::process_line(const Jupiter::ReadableString &line)
 	{
 		Jupiter::IRC::Client::writeToLogs(line);
 		if (m_output != nullptr)
-			line.println(m_output);
+			Jupiter::LogWriter::getDefault().write(m_output, line);
 
-		Jupiter::ReferenceString w1 = Jupiter::ReferenceString::getWord(line, 0, WHITESPACE);
-		if (w1.isNotEmpty())
+		Jupiter::IRC::Message message(line);
+		const Jupiter::ReferenceString &command = message.getCommand();
+		if (command.isNotEmpty())
 		{
-			Jupiter::ReferenceString w2 = Jupiter::ReferenceString::getWord(line, 1, WHITESPACE);
-			int numeric = w2.asInt(10);
-			if (w1[0] == ':') //Messages
+			int numeric = message.getNumeric();
+			if (message.getPrefix().isNotEmpty()) //Messages
 			{
-				if (w2.isNotEmpty())
+				switch (numeric) // Numerics that don't rely on a specific connectionStatus.
 				{
-					switch (numeric) // Numerics that don't rely on a specific connectionStatus.
-					{
-					case Reply::BOUNCE: // 010
+				case Reply::BOUNCE: // 010
+				{
+					const Jupiter::ReferenceString &portToken = message.getParameter(2);
+					unsigned short port;
+					if (portToken.isNotEmpty() && portToken[0] == '+') // This is most likely not used anywhere.
 					{
-						Jupiter::ReferenceString portToken = Jupiter::ReferenceString::getWord(line, 4, " ");
-						unsigned short port;
-						if (portToken[0] == '+') // This is most likely not used anywhere.
-						{
-							port = (unsigned short)portToken.asUnsignedInt(10);
-							if (m_ssl == false)
-							{
-								m_ssl = true;
-								delete m_socket;
-								m_socket = new Jupiter::SecureTCPSocket();
-							}
-						}
-						else
+						port = (unsigned short)portToken.asUnsignedInt(10);
+						if (m_ssl == false)
 						{
-							port = (unsigned short)portToken.asUnsignedInt(10);
-							if (m_ssl == true)
-							{
-								m_ssl = false;
-								delete m_socket;
-								m_socket = new Jupiter::TCPSocket();
-							}
+							m_ssl = true;
+							delete m_socket;
+							Jupiter::SecureTCPSocket *t = new Jupiter::SecureTCPSocket();
+							Jupiter::IRC::Client::setupSecureSocket(*t);
+							m_socket = t;
 						}
-						if (port != 0) // Don't default -- could be non-compliant input.
+					}
+					else
+					{
+						port = (unsigned short)portToken.asUnsignedInt(10);
+						if (m_ssl == true)
 						{
-							m_server_hostname = Jupiter::ReferenceString::getWord(line, 3, WHITESPACE);
-							m_server_port = port;
-							puts("Reconnecting due to old bounce.");
-							this->reconnect();
+							m_ssl = false;
+							delete m_socket;
+							m_socket = new Jupiter::TCPSocket();
 						}
-						else puts("Error: Failed to parse bounce token.");
 					}
-					break;
-					} // numeric switch
-					switch (m_connection_status)
+					if (port != 0) // Don't default -- could be non-compliant input.
+					{
+						m_server_hostname = message.getParameter(1);
+						m_server_port = port;
+						puts("Reconnecting due to old bounce.");
+						this->reconnect();
+					}
+					else puts("Error: Failed to parse bounce token.");
+				}
+				break;
+				} // numeric switch
+				switch (m_connection_status)
+				{
+				case 1: // Socket established -- attempting STARTTLS
+					switch (numeric)
 					{
-					case 1: // Socket established -- attempting STARTTLS
-						switch (numeric)
+					case Reply::BOUNCEOLD: // 005
+						if (message.getLastParameter().matchi("Try server *, port *"))
 						{
-						case Reply::BOUNCEOLD: // 005
-							if (line.matchi("*:Try server *, port *"))
-							{
-								Jupiter::ReferenceString portToken = Jupiter::ReferenceString::getWord(line, 6, " ");
-								unsigned short bouncePort = (unsigned short)Jupiter::ReferenceString::getWord(line, 6, " ").asInt(10);
+							const Jupiter::ReferenceString &text = message.getLastParameter();
+							Jupiter::ReferenceString portToken = text.getWord(4, " ");
+							unsigned short bouncePort;
 
-								if (portToken[0] == '+') // This is almost certainly not used anywhere.
-								{
-									bouncePort = (unsigned short)portToken.asInt(10);
-									if (m_ssl == false)
-									{
-										m_ssl = true;
-										delete m_socket;
-										m_socket = new Jupiter::SecureTCPSocket();
-									}
-								}
-								else
+							if (portToken.isNotEmpty() && portToken[0] == '+') // This is almost certainly not used anywhere.
+							{
+								bouncePort = (unsigned short)portToken.asInt(10);
+								if (m_ssl == false)
 								{
-									bouncePort = (unsigned short)portToken.asInt(10);
-									if (m_ssl == true)
-									{
-										m_ssl = false;
-										delete m_socket;
-										m_socket = new Jupiter::TCPSocket();
-									}
+									m_ssl = true;
+									delete m_socket;
+									Jupiter::SecureTCPSocket *t = new Jupiter::SecureTCPSocket();
+									Jupiter::IRC::Client::setupSecureSocket(*t);
+									m_socket = t;
 								}
-								if (bouncePort != 0)
+							}
+							else
+							{
+								bouncePort = (unsigned short)portToken.asInt(10);
+								if (m_ssl == true)
 								{
-									m_server_hostname = Jupiter::ReferenceString::getWord(line, 4, " ");
-									m_server_hostname.truncate(1); // trailing comma
-									m_server_port = bouncePort;
-									puts("Reconnecting due to old bounce.");
-									this->reconnect();
+									m_ssl = false;
+									delete m_socket;
+									m_socket = new Jupiter::TCPSocket();
 								}
-								else puts("Error: Failed to parse old bounce token.");
 							}
-							break;
-
-						case Error::UNKNOWNCOMMAND: // 421
-						{
-							Jupiter::ReferenceString command = Jupiter::ReferenceString::getWord(line, 2, " ");
-							if (command.equalsi("STARTTLS")) // Server doesn't support STARTTLS
-								Client::startCAP();
+							if (bouncePort != 0)
+							{
+								m_server_hostname = text.getWord(2, " ");
+								m_server_hostname.truncate(1); // trailing comma
+								m_server_port = bouncePort;
+								puts("Reconnecting due to old bounce.");
+								this->reconnect();
+							}
+							else puts("Error: Failed to parse old bounce token.");
 						}
 						break;
 
-						case Reply::STARTTLS: // 670
-						{
-							Jupiter::SecureTCPSocket *t = new Jupiter::SecureTCPSocket(std::move(*m_socket));
-							delete m_socket;
-							m_socket = t;
-							m_ssl = true;
-							// toggle blocking to prevent error
-							if (m_ssl_certificate.isNotEmpty())
-								t->setCertificate(m_ssl_certificate, m_ssl_key);
-
-							bool goodSSL;
-							if (t->getBlockingMode() == false)
-							{
-								t->setBlocking(true);
-								goodSSL = t->initSSL();
-								t->setBlocking(false);
-							}
-							else goodSSL = t->initSSL();
+					case Error::UNKNOWNCOMMAND: // 421
+						if (message.getParameter(1).equalsi("STARTTLS")) // Server doesn't support STARTTLS
+							Client::startCAP();
+						break;
 
-							if (goodSSL)
-								Client::startCAP();
-							else
-							{
-								// Something went wrong. Kill the socket.
-								t->close();
-							}
+					case Reply::STARTTLS: // 670
+					{
+						Jupiter::SecureTCPSocket *t = new Jupiter::SecureTCPSocket(std::move(*m_socket));
+						delete m_socket;
+						m_socket = t;
+						m_ssl = true;
+						Jupiter::IRC::Client::setupSecureSocket(*t);
+
+						// toggle blocking to prevent error
+						bool goodSSL;
+						if (t->getBlockingMode() == false)
+						{
+							t->setBlocking(true);
+							goodSSL = t->initSSL();
+							t->setBlocking(false);
 						}
-						break;
+						else goodSSL = t->initSSL();
 
-						case Error::STARTTLS: // 691
+						if (goodSSL)
 							Client::startCAP();
-							break;
+						else
+						{
+							// Something went wrong. Kill the socket.
+							t->close();
+						}
+					}
+					break;
+
+					case Error::STARTTLS: // 691
+						Client::startCAP();
+						break;
 
-						default:
-							break;
-						} // numeric switch
+					default:
 						break;
+					} // numeric switch
+					break;
 
-					case 2: // Capability negotiation
-						switch (numeric)
+				case 2: // Capability negotiation
+					switch (numeric)
+					{
+					case 0:
+						if (command.equalsi("CAP"))
 						{
-						case 0:
-							if (w2.equalsi("CAP"))
+							if (message.getParameter(1).equals("LS"))
 							{
-								Jupiter::ReferenceString w4 = Jupiter::ReferenceString::getWord(line, 3, WHITESPACE);
-								if (w4.equals("LS"))
+								const Jupiter::ReferenceString &listParams = message.getParameter(2);
+								unsigned int len = listParams.wordCount(WHITESPACE);
+								Jupiter::ReferenceString curr;
+								Jupiter::StringL req = "CAP REQ :";
+								bool sasl = false;
+								for (unsigned int i = 0; i < len; i++)
 								{
-									Jupiter::ReferenceString listParams = Jupiter::ReferenceString::gotoWord(line, 4, WHITESPACE);
-									if (listParams[0] == ':') listParams.shiftRight(1);
-									unsigned int len = listParams.wordCount(WHITESPACE);
-									Jupiter::ReferenceString curr;
-									Jupiter::StringL req = "CAP REQ :";
-									bool sasl = false;
-									for (unsigned int i = 0; i < len; i++)
+									curr = listParams.getWord(i, WHITESPACE);
+									if (curr.equalsi("multi-prefix")) req += "multi-prefix ";
+									else if (curr.equalsi("userhost-in-names")) req += "userhost-in-names ";
+									else if (curr.equalsi("sasl"))
 									{
-										curr = listParams.getWord(i, WHITESPACE);
-										if (curr.equalsi("multi-prefix")) req += "multi-prefix ";
-										else if (curr.equalsi("userhost-in-names")) req += "userhost-in-names ";
-										else if (curr.equalsi("sasl"))
+										if (m_sasl_password.isNotEmpty())
 										{
-											if (m_sasl_password.isNotEmpty())
-											{
-												req += "sasl "_jrs;
-												sasl = true;
-											}
+											req += "sasl "_jrs;
+											sasl = true;
 										}
-										// else; // We don't know what this is!
-									}
-									if (req.size() > 9)
-									{
-										req -= 1; // Trim off the extra space byte.
-										req += ENDL;
-										m_socket->send(req);
-										if (sasl)
-											m_socket->send("AUTHENTICATE PLAIN"_jrs ENDL);
-									}
-									if (!sasl)
-									{
-										m_socket->send("CAP END"_jrs ENDL);
-										Client::registerClient();
 									}
+									// else; // We don't know what this is!
+								}
+								if (req.size() > 9)
+								{
+									req -= 1; // Trim off the extra space byte.
+									req += ENDL;
+									m_socket->send(req);
+									if (sasl)
+										m_socket->send("AUTHENTICATE PLAIN"_jrs ENDL);
+								}
+								if (!sasl)
+								{
+									m_socket->send("CAP END"_jrs ENDL);
+									Client::registerClient();
 								}
 							}
-							break;
-						case Error::UNKNOWNCOMMAND: // 421
-							if (w2.equalsi("CAP")) // Server doesn't support CAP
-							{
-								Client::registerClient();
-							}
-							break;
-						default:
-							break;
-						} // numeric switch
+						}
+						break;
+					case Error::UNKNOWNCOMMAND: // 421
+						if (message.getParameter(1).equalsi("CAP")) // Server doesn't support CAP
+						{
+							Client::registerClient();
+						}
 						break;
+					default:
+						break;
+					} // numeric switch
+					break;
 
-					case 3: // Registration sent, but not verified.
+				case 3: // Registration sent, but not verified.
+				{
+					bool erroneous_nickname = false;
+					switch (numeric)
 					{
-						bool erroneous_nickname = false;
-						switch (numeric)
+						// We'll take any of these 4, just in-case any of them are missing. In general, this will trigger on 001.
+					case Reply::MYINFO: // 004
+						m_server_name = message.getParameter(1);
+					case Reply::WELCOME: // 001
+					case Reply::YOURHOST: // 002
+					case Reply::CREATED: // 003
+						m_connection_status = 4;
+						break;
+
+						// You have a bad nickname! Try the alt.
+						//case Error::NONICKNAMEGIVEN: // 431 -- Not consistently usable due to lack of command field.
+					case Error::ERRONEOUSNICKNAME: // 432
+						erroneous_nickname = true;
+					case Error::NICKNAMEINUSE: // 433
+					case Error::NICKCOLLISION: // 436
+					case Error::BANNICKCHANGE: // 437 -- Note: This conflicts with another token.
+						const Jupiter::ReadableString &altNick = Jupiter::IRC::Client::readConfigValue("AltNick"_jrs);
+						const Jupiter::ReadableString &configNick = Jupiter::IRC::Client::readConfigValue("Nick"_jrs, "Jupiter"_jrs);
+
+						if (altNick.isNotEmpty() && m_nickname.equalsi(altNick)) // The alternate nick failed.
 						{
-							// We'll take any of these 4, just in-case any of them are missing. In general, this will trigger on 001.
-						case Reply::MYINFO: // 004
-							m_server_name = Jupiter::ReferenceString::getWord(line, 3, " ");
-						case Reply::WELCOME: // 001
-						case Reply::YOURHOST: // 002
-						case Reply::CREATED: // 003
-							m_connection_status = 4;
-							break;
-
-							// You have a bad nickname! Try the alt.
-							//case Error::NONICKNAMEGIVEN: // 431 -- Not consistently usable due to lack of command field.
-						case Error::ERRONEOUSNICKNAME: // 432
-							erroneous_nickname = true;
-						case Error::NICKNAMEINUSE: // 433
-						case Error::NICKCOLLISION: // 436
-						case Error::BANNICKCHANGE: // 437 -- Note: This conflicts with another token.
-							const Jupiter::ReadableString &altNick = Jupiter::IRC::Client::readConfigValue("AltNick"_jrs);
-							const Jupiter::ReadableString &configNick = Jupiter::IRC::Client::readConfigValue("Nick"_jrs, "Jupiter"_jrs);
-
-							if (altNick.isNotEmpty() && m_nickname.equalsi(altNick)) // The alternate nick failed.
-							{
-								m_nickname = configNick;
-								m_nickname += "1";
-								
-								m_socket->send("NICK "_jrs + m_nickname + ENDL);
-							}
-							else if (m_nickname.equalsi(configNick)) // The config nick failed
+							m_nickname = configNick;
+							m_nickname += "1";
+							
+							m_socket->send("NICK "_jrs + m_nickname + ENDL);
+						}
+						else if (m_nickname.equalsi(configNick)) // The config nick failed
+						{
+							if (altNick.isEmpty())
 							{
-								if (altNick.isEmpty())
-								{
-									if (erroneous_nickname)
-										break; // If this nick is invalid, adding numbers won't help.
+								if (erroneous_nickname)
+									break; // If this nick is invalid, adding numbers won't help.
 
-									m_nickname += '1';
-								}
-								else
-									m_nickname = altNick;
-
-								m_socket->send("NICK "_jrs + m_nickname + ENDL);
+								m_nickname += '1';
 							}
-							// Note: Add a series of contains() functions to String_Type.
 							else
+								m_nickname = altNick;
+
+							m_socket->send("NICK "_jrs + m_nickname + ENDL);
+						}
+						// Note: Add a series of contains() functions to String_Type.
+						else
+						{
+							if (erroneous_nickname == false) // If this nick is invalid, adding numbers won't help.
 							{
-								if (erroneous_nickname == false) // If this nick is invalid, adding numbers won't help.
+								if (m_nickname.size() > configNick.size())
 								{
-									if (m_nickname.size() > configNick.size())
-									{
-										int n = Jupiter_strtoi_nospace_s(m_nickname.ptr() + configNick.size(), m_nickname.size() - configNick.size(), 10);
-										m_nickname.format("%.*s%d", configNick.size(), configNick.ptr(), n + 1);
+									int n = Jupiter_strtoi_nospace_s(m_nickname.ptr() + configNick.size(), m_nickname.size() - configNick.size(), 10);
+									m_nickname.format("%.*s%d", configNick.size(), configNick.ptr(), n + 1);
 
-										m_socket->send("NICK "_jrs + m_nickname + ENDL);
-									}
-									else
-									{
-										// Something strange is going on -- did somebody rehash?
-										// This can be somewhat edgy -- this will only trigger if someone rehashes AND the new nickname is shorter.
-										// However, it won't be fatal even if the new nickname's length is >= the old.
-										m_nickname = configNick;
-										m_socket->send("NICK "_jrs + m_nickname + ENDL);
-									}
+									m_socket->send("NICK "_jrs + m_nickname + ENDL);
 								}
 								else
 								{
-									// Disconnect and don't try again.
-									// Consider passing this to plugins so that they can figure it out (i.e: a plugin could display a prompt and ask for input).
+									// Something strange is going on -- did somebody rehash?
+									// This can be somewhat edgy -- this will only trigger if someone rehashes AND the new nickname is shorter.
+									// However, it won't be fatal even if the new nickname's length is >= the old.
+									m_nickname = configNick;
+									m_socket->send("NICK "_jrs + m_nickname + ENDL);
 								}
 							}
-							break;
+							else
+							{
+								// Disconnect and don't try again.
+								// Consider passing this to plugins so that they can figure it out (i.e: a plugin could display a prompt and ask for input).
+							}
 						}
+						break;
 					}
-					break;
+				}
+				break;
 
-					case 4: // Registration verified, but connection process in progress.
-						switch (numeric)
-						{
-						case Reply::ISUPPORT: // 005
+				case 4: // Registration verified, but connection process in progress.
+					switch (numeric)
+					{
+					case Reply::ISUPPORT: // 005
+					{
+						// Parameters 1 through n - 1 are tokens; the last parameter is a description.
+						for (size_t index = 1; index + 1 < message.getParameterCount(); ++index)
 						{
-							size_t pos = line.find("PREFIX=("_jrs);
-							if (pos != Jupiter::INVALID_INDEX)
+							const Jupiter::ReferenceString &token = message.getParameter(index);
+							if (token.find("PREFIX=("_jrs) == 0)
 							{
-								Jupiter::ReferenceString ref = Jupiter::ReferenceString::substring(line, pos + 8);
+								Jupiter::ReferenceString ref = Jupiter::ReferenceString::substring(token, 8);
+								Jupiter::StringS old_prefixes = m_prefixes;
 								m_prefix_modes = Jupiter::ReferenceString::getWord(ref, 0, ")");
-								ref.shiftRight(ref.find(')') + 1);
-								m_prefixes = Jupiter::ReferenceString::getWord(ref, 0, " " ENDL);
+								m_prefixes = Jupiter::ReferenceString::substring(ref, m_prefix_modes.size() + 1);
+								if (m_prefixes.equals(old_prefixes) == false)
+									Jupiter::IRC::Client::remapPrefixMasks(old_prefixes);
 							}
-							pos = line.find("CHANMODES="_jrs);
-							if (pos != Jupiter::INVALID_INDEX)
+							else if (token.find("CHANMODES="_jrs) == 0)
 							{
-								Jupiter::ReferenceString ref = Jupiter::ReferenceString::substring(line, pos + 10);
-								ref = ref.getWord(0, " ");
-								size_t pos2 = ref.find(',', 0);
-								if (pos != INVALID_INDEX)
+								Jupiter::ReferenceString ref = Jupiter::ReferenceString::substring(token, 10);
+								m_modeA = Jupiter::ReferenceString::getToken(ref, 0, ',');
+								m_modeB = Jupiter::ReferenceString::getToken(ref, 1, ',');
+								m_modeC = Jupiter::ReferenceString::getToken(ref, 2, ',');
+								m_modeD = Jupiter::ReferenceString::getToken(ref, 3, ',');
+							}
+							else if (token.find("CHANTYPES="_jrs) == 0)
+								m_chan_types = Jupiter::ReferenceString::substring(token, 10);
+							else if (token.find("TARGMAX="_jrs) == 0)
+							{
+								// Comma-separated command:limit pairs; an empty limit means there is none
+								Jupiter::ReferenceString ref = Jupiter::ReferenceString::substring(token, 8);
+								size_t count = ref.tokenCount(',');
+								for (size_t pair_index = 0; pair_index != count; ++pair_index)
 								{
-									m_modeA = ref.getWord(0, ", ");
-									ref.shiftRight(pos + 1);
-									pos2 = ref.find(',', 0);
-									if (pos != INVALID_INDEX)
+									Jupiter::ReferenceString pair = Jupiter::ReferenceString::getToken(ref, pair_index, ',');
+									Jupiter::ReferenceString command = Jupiter::ReferenceString::getToken(pair, 0, ':');
+									Jupiter::ReferenceString limit = Jupiter::ReferenceString::getToken(pair, 1, ':');
+									size_t max_targets = limit.isEmpty() ? SIZE_MAX : std::max(limit.asUnsignedInt(10), 1U);
+									if (command.equalsi("PRIVMSG"_jrs))
 									{
-										m_modeB = ref.getWord(0, ", ");
-										ref.shiftRight(pos + 1);
-										pos2 = ref.find(',', 0);
-										if (pos != INVALID_INDEX)
-										{
-											m_modeC = ref.getWord(0, ", ");
-											ref.shiftRight(pos + 1);
-											m_modeD = ref.getWord(0, ", ");
-										}
+										m_max_privmsg_targets = max_targets;
+										m_targmax_received = true;
 									}
+									else if (command.equalsi("JOIN"_jrs))
+										m_max_join_targets = max_targets;
 								}
 							}
-							pos = line.find("CHANTYPES="_jrs);
-							if (pos != Jupiter::INVALID_INDEX)
+							else if (token.find("MAXTARGETS="_jrs) == 0)
 							{
-								Jupiter::ReferenceString ref = Jupiter::ReferenceString::substring(line, pos + 10);
-								m_chan_types = ref.getWord(0, " ");
+								// Superseded by TARGMAX
+								if (m_targmax_received == false)
+								{
+									Jupiter::ReferenceString limit = Jupiter::ReferenceString::substring(token, 11);
+									m_max_privmsg_targets = limit.isEmpty() ? SIZE_MAX : std::max(limit.asUnsignedInt(10), 1U);
+								}
+							}
+							else if (token.find("CASEMAPPING="_jrs) == 0)
+							{
+								Jupiter::ReferenceString mapping = Jupiter::ReferenceString::substring(token, 12);
+								if (mapping.equalsi("rfc1459"))
+									Jupiter::IRC::Client::setCaseMapping(CaseMapping::RFC1459);
+								else if (mapping.equalsi("strict-rfc1459"))
+									Jupiter::IRC::Client::setCaseMapping(CaseMapping::STRICT_RFC1459);
+								else // ascii, or a mapping which isn't folded here (i.e: rfc7613)
+									Jupiter::IRC::Client::setCaseMapping(CaseMapping::ASCII);
 							}
 						}
-						break;
-						case Reply::LUSERCLIENT: // 251
+					}
+					break;
+					case Reply::LUSERCLIENT: // 251
+					{
+						// Send the raw data and auto-joins in as few segments as possible
+						Jupiter::Socket::Cork cork(*m_socket);
+						Jupiter::StringL key = "RawData.";
+						size_t offset;
+
+						unsigned int i = 1;
+						Jupiter::ReferenceString value;
+						auto config_loop_condition = [&]
 						{
-							Jupiter::StringL key = "RawData.";
-							size_t offset;
+							offset = key.aformat("%u", i);
+							value = Jupiter::IRC::Client::readConfigValue(key);
+							return !value.isEmpty();
+						};
+						while (config_loop_condition())
+						{
+							key.truncate(offset);
+							Jupiter::IRC::Client::send(value);
+							i++;
+						}
 
-							unsigned int i = 1;
-							Jupiter::ReferenceString value;
-							auto config_loop_condition = [&]
-							{
-								offset = key.aformat("%u", i);
-								value = Jupiter::IRC::Client::readConfigValue(key);
-								return !value.isEmpty();
-							};
-							while (config_loop_condition())
-							{
-								key.truncate(offset);
-								Jupiter::IRC::Client::send(value);
-								i++;
-							}
+						Jupiter::IRC::Client::autoJoinChannels();
 
-							auto auto_join_channels_callback = [this](Jupiter::Config::SectionHashTable::Bucket::Entry &in_entry)
-							{
-								if (in_entry.value.get<bool>("AutoJoin"_jrs, false))
-									this->joinChannel(in_entry.value.getName());
-							};
+						m_connection_status = 5;
+						m_reconnect_attempts = 0;
+						this->OnConnect();
+						Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::CONNECT, Jupiter::ReferenceString::empty, &Jupiter::Plugin::OnConnect);
 
-							Jupiter::Config *config = m_primary_section->getSection("Channels"_jrs);
+						if (m_pending_auto_joins.size() == 0)
+						{
+							this->OnAutoJoinSynced();
+							Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::AUTO_JOIN_SYNCED, Jupiter::ReferenceString::empty, &Jupiter::Plugin::OnAutoJoinSynced);
+						}
+					}
+					break;
+					}
+					break;
 
-							if (config != nullptr)
-								config->getSections().callback(auto_join_channels_callback);
+				default: // Post-registration.
+					Jupiter::IRC::Client::dispatch(message);
+					break;
+				}
+			}
+			else
+				Jupiter::IRC::Client::dispatch(message);
+			if (numeric != 0)
+			{
+				this->OnNumeric(numeric, line);
+				Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::getNumericSubscribers(numeric), Jupiter::Plugin::Event::NUMERIC, Jupiter::ReferenceString::empty, &Jupiter::Plugin::OnNumeric, numeric, line);
+			}
+			this->OnMessage(message);
+			const std::vector<Jupiter::Plugin *> &message_subscribers = Jupiter::Plugin::getCommandSubscribers(Jupiter::Plugin::Event::MESSAGE, command);
+			for (size_t i = 0; i < message_subscribers.size(); i++)
+			{
+				Jupiter::Plugin *plugin = message_subscribers[i];
+				if (plugin->isOffloaded(Jupiter::Plugin::Event::MESSAGE))
+				{
+					// The message only views the line; parse a copy of it on the worker instead
+					std::shared_ptr<Jupiter::StringS> copy = std::make_shared<Jupiter::StringS>(line);
+					Jupiter::IRC::Client::offload(Jupiter::ReferenceString::empty, plugin, [this, plugin, copy]
+					{
+						Jupiter::IRC::Message copy_message(*copy);
+						Jupiter::Plugin::HookTimer timer(plugin, Jupiter::Plugin::Event::MESSAGE);
+						plugin->OnMessage(this, copy_message);
+					});
+				}
+				else
+				{
+					Jupiter::Plugin::HookTimer timer(plugin, Jupiter::Plugin::Event::MESSAGE);
+					plugin->OnMessage(this, message);
+				}
+			}
+		}
+		this->OnRaw(line);
+		Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::getCommandSubscribers(Jupiter::Plugin::Event::RAW, command), Jupiter::Plugin::Event::RAW, Jupiter::ReferenceString::empty, &Jupiter::Plugin::OnRaw, line);
+	}
 
-							config = m_secondary_section->getSection("Channels"_jrs);
+	return 0;
+}
 
-							if (config != nullptr)
-								config->getSections().callback(auto_join_channels_callback);
+static Jupiter::StringS to_command_key(const Jupiter::ReadableString &in_command)
+{
+	Jupiter::StringS result = in_command;
+	for (size_t index = 0; index != result.size(); ++index)
+		result.set(index, static_cast<char>(toupper(static_cast<unsigned char>(result.get(index)))));
 
-							m_connection_status = 5;
-							m_reconnect_attempts = 0;
-							this->OnConnect();
-							for (i = 0; i < Jupiter::plugins->size(); i++) Jupiter::plugins->get(i)->OnConnect(this);
-						}
-						break;
-						}
-						break;
+	return result;
+}
 
-					default: // Post-registration.
-						if (w2.equalsi("PRIVMSG"))
-						{
-							Jupiter::ReferenceString chan = Jupiter::ReferenceString::getWord(line, 2, WHITESPACE);
-							if (chan.isNotEmpty())
-							{
-								Jupiter::ReferenceString nick = getSender(line);
-								if (nick.isNotEmpty())
-								{
-									Jupiter::ReferenceString premessage = Jupiter::ReferenceString::substring(line, line.find(':', 1) + 1);
-									if (premessage[0] == '\001') //CTCP (ACTIONs are included)
-									{
-										Jupiter::ReferenceString rawmessage(premessage.ptr() + 1, premessage.size() - 1);
-										Jupiter::ReferenceString command = rawmessage.getWord(0, WHITESPACE);
-										if (command[command.size() - 1] == IRC::CTCP) command.truncate(1);
-										Jupiter::ReferenceString message = rawmessage.substring(rawmessage.find(' ') + 1, rawmessage.find(IRC::CTCP));
-										if (message[message.size() - 1] == IRC::CTCP) message.truncate(1);
+void Jupiter::IRC::Client::setCommandHandler(const Jupiter::ReadableString &in_command, CommandHandler in_handler)
+{
+	Jupiter::StringS command = to_command_key(in_command);
+	if (in_handler)
+		m_command_handlers.set(command, in_handler);
+	else
+		m_command_handlers.remove(command);
+}
 
-										if (command.equals("ACTION"))
-										{
-											this->OnAction(chan, nick, message);
-											for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-												Jupiter::plugins->get(i)->OnAction(this, chan, nick, message);
-										}
-										else
-										{
-											Jupiter::StringL response = "NOTICE ";
-											response += nick;
-											response += " :" IRCCTCP;
-											response += command;
-											response += ' ';
-											if (command.equals("PING")) response += message;
-											else if (command.equals("VERSION")) response += Jupiter::version;
-											else if (command.equals("FINGER")) response += "Oh, yeah, a little to the left.";
-											else if (command.equals("SOURCE")) response += "https://github.com/JAJames/Jupiter";
-											else if (command.equals("USERINFO")) response += "Hey, I'm Jupiter! If you have questions, ask Agent! (irc.cncirc.net)";
-											else if (command.equals("CLIENTINFO")) response += "I'll tell you what I don't know: This command!";
-											else if (command.equals("TIME")) response += getTime();
-											else if (command.equals("ERRMSG")) response += message;
-											else
-											{
-												response = "NOTICE ";
-												response += nick;
-												response += " :" IRCCTCP "ERRMSG ";
-												response += command;
-												response += " :Query is unknown";
-											}
-											response += IRCCTCP ENDL;
-											m_socket->send(response);
-											this->OnCTCP(chan, nick, command, message);
-											for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-												Jupiter::plugins->get(i)->OnCTCP(this, chan, nick, message);
-										}
-									}
-									else
-									{
-										Jupiter::ReferenceString message = premessage;
-										this->OnChat(chan, nick, message);
-										for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-											Jupiter::plugins->get(i)->OnChat(this, chan, nick, message);
-									}
-								}
-							}
-						}
-						else if (w2.equalsi("NOTICE"))
-						{
-							Jupiter::ReferenceString chan = Jupiter::ReferenceString::getWord(line, 2, WHITESPACE);
-							if (chan.isNotEmpty())
-							{
-								size_t pos = line.find('!', 0);
-								auto message = Jupiter::ReferenceString::substring(line, line.find(':', 1) + 1, line.size());
-								if (pos < line.find(' '))
-								{
-									auto nick = Jupiter::ReferenceString::substring(line, 1, pos);
-									this->OnNotice(chan, nick, message);
-									for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-										Jupiter::plugins->get(i)->OnNotice(this, chan, nick, message);
-								}
-								else
-								{
-									auto sender = getSender(line);
-									if (sender.isNotEmpty())
-									{
-										this->OnServerNotice(chan, sender, message);
-										for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-											Jupiter::plugins->get(i)->OnServerNotice(this, chan, sender, message);
-									}
-								}
-							}
-						}
-						else if (w2.equalsi("NICK"))
-						{
-							auto nick = getSender(line);
-							Jupiter::ReferenceString newnick = Jupiter::ReferenceString::substring(line, line.find(' ', 1) + 1);
-							if (newnick.isNotEmpty() && newnick[0] == ':') newnick.shiftRight(1);
-							if (nick.equalsi(m_nickname))
-							{
-								m_nickname = newnick;
-							}
-							Jupiter::IRC::Client::User *user = Client::findUser(nick);
-							if (user != nullptr)
-							{
-								user->m_nickname = newnick;
-								this->OnNick(nick, newnick);
-							}
-							for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-								Jupiter::plugins->get(i)->OnNick(this, nick, newnick);
-						}
-						else if (w2.equalsi("JOIN"))
-						{
-							auto nick = getSender(line);
-							Jupiter::ReferenceString chan = Jupiter::ReferenceString::getWord(line, 2, WHITESPACE);
-							
-							if (chan[0] == ':')
-								chan.shiftRight(1);
+void Jupiter::IRC::Client::setNumericHandler(int in_numeric, CommandHandler in_handler)
+{
+	if (in_numeric <= 0 || in_numeric > 999)
+		return;
 
-							Channel *channel = m_channels.get(chan);
+	if (static_cast<size_t>(in_numeric) >= m_numeric_handlers.size())
+	{
+		if (!in_handler)
+			return;
 
-							if (m_nickname.equalsi(nick))
-							{
-								// TODO: Optimize by simply wiping channel data, rather than removing and re-adding
-								if (channel != nullptr)
-									Client::delChannel(channel->getName());
+		m_numeric_handlers.resize(in_numeric + 1);
+	}
 
-								Client::addChannel(chan);
-								channel = m_channels.get(chan);
-								channel->m_adding_names = true;
+	m_numeric_handlers[in_numeric] = std::move(in_handler);
+}
 
-								if (channel->getType() < 0)
-								{
-									if (m_auto_part_message.isNotEmpty())
-										Jupiter::IRC::Client::partChannel(chan, m_auto_part_message);
-									else
-										Jupiter::IRC::Client::partChannel(chan);
-								}
-							}
-							else if (channel != nullptr)
-								channel->addUser(Client::findUserOrAdd(nick));
+Jupiter::IRC::Client::CommandHandler Jupiter::IRC::Client::getCommandHandler(const Jupiter::ReadableString &in_command) const
+{
+	Jupiter::StringS command = to_command_key(in_command);
 
-							this->OnJoin(chan, nick);
+	CommandHandler *handler = m_command_handlers.get(command);
+	if (handler == nullptr)
+		return CommandHandler();
 
-							for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-								Jupiter::plugins->get(i)->OnJoin(this, chan, nick);
-						}
-						else if (w2.equalsi("PART"))
-						{
-							auto nick = getSender(line);
-							if (nick.isNotEmpty())
-							{
-								Jupiter::ReferenceString chan = Jupiter::ReferenceString::getWord(line, 2, WHITESPACE);
-								if (chan.isNotEmpty())
-								{
-									Channel *channel = m_channels.get(chan);
-									if (channel != nullptr)
-									{
-										Jupiter::IRC::Client::User *user = m_users.get(nick);
-										if (user != nullptr)
-										{
-											channel->delUser(nick);
-											Jupiter::ReferenceString reason;
-											size_t pos = line.find(':', 1);
-
-											if (pos != Jupiter::INVALID_INDEX)
-												reason = Jupiter::ReferenceString::substring(line, pos + 1);
-
-											this->OnPart(chan, nick, reason);
-											
-											for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-												Jupiter::plugins->get(i)->OnPart(this, chan, nick, reason);
-											
-											if (nick.equalsi(m_nickname))
-												Client::delChannel(chan);
-											
-											if (user->getChannelCount() == 0)
-												m_users.remove(nick);
-										}
-									}
-								}
-							}
-						}
-						else if (w2.equalsi("KICK"))
-						{
-							Jupiter::ReferenceString chan = Jupiter::ReferenceString::getWord(line, 2, WHITESPACE);
-							if (chan.isNotEmpty())
-							{
-								Jupiter::ReferenceString kicker = getSender(line);
-								if (kicker.isNotEmpty())
-								{
-									Jupiter::ReferenceString kicked = Jupiter::ReferenceString::getWord(line, 3, WHITESPACE);
-									if (kicked.isNotEmpty())
-									{
-										Channel *channel = m_channels.get(chan);
-										if (channel != nullptr)
-										{
-											Jupiter::IRC::Client::User *user = m_users.get(kicked);
-											if (user != nullptr)
-											{
-												channel->delUser(kicked);
-												size_t pos = line.find(':', 1);
-												Jupiter::ReferenceString reason;
-
-												if (pos != Jupiter::INVALID_INDEX)
-													reason = Jupiter::ReferenceString::substring(line, pos + 1);
-
-												this->OnKick(chan, kicker, kicked, reason);
-
-												for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-													Jupiter::plugins->get(i)->OnKick(this, chan, kicker, kicked, reason);
-
-												if (kicked.equalsi(m_nickname))
-												{
-													Client::delChannel(chan);
-													if (m_join_on_kick)
-														Jupiter::IRC::Client::joinChannel(chan);
-												}
-
-												if (user->getChannelCount() == 0)
-													m_users.remove(kicked);
-											}
-										}
-									}
-								}
-							}
-						}
-						else if (w2.equalsi("QUIT"))
-						{
-							Jupiter::ReferenceString nick = getSender(line);
-							Jupiter::ReferenceString message = Jupiter::ReferenceString::substring(line, line.find(':', 1) + 1);
-							Jupiter::IRC::Client::User *user = m_users.get(nick);
-							if (user != nullptr)
-							{
-								auto remove_user_callback = [&nick](ChannelTableType::Bucket::Entry &in_entry)
-								{
-									in_entry.value.delUser(nick);
-								};
+	return *handler;
+}
 
-								m_channels.callback(remove_user_callback);
+Jupiter::IRC::Client::CommandHandler Jupiter::IRC::Client::getNumericHandler(int in_numeric) const
+{
+	if (in_numeric <= 0 || static_cast<size_t>(in_numeric) >= m_numeric_handlers.size())
+		return CommandHandler();
 
-								this->OnQuit(nick, message);
+	return m_numeric_handlers[in_numeric];
+}
 
-								for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-									Jupiter::plugins->get(i)->OnQuit(this, nick, message);
+bool Jupiter::IRC::Client::dispatch(const Jupiter::IRC::Message &in_message)
+{
+	int numeric = in_message.getNumeric();
+	if (numeric != 0)
+	{
+		if (static_cast<size_t>(numeric) < m_numeric_handlers.size() && m_numeric_handlers[numeric])
+		{
+			m_numeric_handlers[numeric](*this, in_message);
+			return true;
+		}
+		return false;
+	}
 
-								m_users.remove(nick);
-							}
-						}
-						else if (w2.equalsi("INVITE"))
-						{
-							Jupiter::ReferenceString inviter = getSender(line);
-							Jupiter::ReferenceString invited = Jupiter::ReferenceString::getWord(line, 2, WHITESPACE);
-							Jupiter::ReferenceString chan = Jupiter::ReferenceString::substring(line, line.find(':', 1) + 1);
-							this->OnInvite(chan, inviter, invited);
-							for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-								Jupiter::plugins->get(i)->OnInvite(this, chan, inviter, invited);
-						}
-						else if (w2.equalsi("MODE"))
-						{
-							Jupiter::ReferenceString chan = Jupiter::ReferenceString::getWord(line, 2, WHITESPACE);
-							if (chan.isNotEmpty())
-							{
-								if (m_chan_types.contains(chan[0]))
-								{
-									auto nick = getSender(line);
-									if (nick.isNotEmpty())
-									{
-										Jupiter::ReferenceString modestring = Jupiter::ReferenceString::substring(line, line.find(' ', 2) + 1);
-										if (modestring.wordCount(" ") > 1)
-										{
-											Jupiter::ReferenceString modes = modestring.getWord(0, " ");
-											if (modes.isNotEmpty())
-											{
-												modestring.shiftRight(modestring.find(' ') + 1);
-												Jupiter::ReferenceString tword;
-												unsigned char g = 0;
-												char symb = 0;
-												for (uint8_t z = 0; z != modes.size(); z++)
-												{
-													if (modes[z] == '+' || modes[z] == '-')
-														symb = modes[z];
-													else if (m_prefix_modes.contains(modes[z])) // user prefix mode
-													{
-
-														tword = modestring.getWord(g, " ");
-														if (tword.isNotEmpty())
-														{
-															Jupiter::IRC::Client::Channel *channel = m_channels.get(chan);
-															if (channel != nullptr)
-															{
-																if (symb == '+')
-																	channel->addUserPrefix(Jupiter::ReferenceString(tword), m_prefixes[m_prefix_modes.find(modes[z])]);
-																else
-																	channel->delUserPrefix(Jupiter::ReferenceString(tword), m_prefixes[m_prefix_modes.find(modes[z])]);
-															}
-														}
-														g++;
-													}
-													else if (m_modeA.contains(modes[z])) // mode type A
-														g++;
-													else if (m_modeB.contains(modes[z])) // mode type B
-														g++;
-													else if (m_modeC.contains(modes[z]) && symb == '+') // mode type C (with parameter)
-														g++;
-													// else; // mode type D
-												}
-											}
-										}
-										this->OnMode(chan, nick, modestring);
-										for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-											Jupiter::plugins->get(i)->OnMode(this, chan, nick, modestring);
-									}
-								}
-							}
-						}
-						// else if ACCOUNT
-						// else if CHGHOST
-						else if (numeric == Reply::NAMREPLY) // Some names.
-						{
-							Jupiter::ReferenceString chan = Jupiter::ReferenceString::getWord(line, 4, " ");
-							Jupiter::ReferenceString names = Jupiter::ReferenceString::substring(line, line.find(':', 1) + 1);
+	const Jupiter::ReferenceString &command = in_message.getCommand();
+	CommandHandler *handler = m_command_handlers.get(command);
+	if (handler == nullptr)
+	{
+		// Commands are registered in upper-case; servers are expected to send them that way.
+		char upper[32];
+		if (command.size() > sizeof(upper))
+			return false;
 
-							Channel *channel = m_channels.get(chan);
-							if (channel != nullptr)
-							{
-								if (channel->m_adding_names == false)
-								{
-									Client::delChannel(chan);
-									Client::addChannel(chan);
-									channel = Jupiter::IRC::Client::getChannel(chan);
-									channel->m_adding_names = true;
-								}
+		bool has_lower = false;
+		for (size_t index = 0; index != command.size(); ++index)
+		{
+			upper[index] = static_cast<char>(toupper(static_cast<unsigned char>(command.get(index))));
+			if (upper[index] != command.get(index))
+				has_lower = true;
+		}
 
-								// addNamesToChannel can be cut/pasted here
-								Client::addNamesToChannel(*channel, names);
-							}
-						}
-						else if (numeric == Reply::ENDOFNAMES) // We're done here.
-						{
-							Jupiter::ReferenceString chan = Jupiter::ReferenceString::getWord(line, 3, " ");
-							Channel *channel = m_channels.get(chan);
+		if (has_lower == false)
+			return false;
 
-							if (channel != nullptr)
-								channel->m_adding_names = false;
-						}
-						break;
-					}
-				}
-			}
-			else
+		handler = m_command_handlers.get(Jupiter::ReferenceString(upper, command.size()));
+		if (handler == nullptr)
+			return false;
+	}
+
+	(*handler)(*this, in_message);
+	return true;
+}
+
+void Jupiter::IRC::Client::handlePRIVMSG(const Jupiter::IRC::Message &in_message)
+{
+	const Jupiter::ReferenceString &chan = in_message.getParameter(0);
+	if (chan.isNotEmpty())
+	{
+		const Jupiter::ReferenceString &nick = in_message.getNickname();
+		if (nick.isNotEmpty())
+		{
+			// Parameters which aren't present are empty, and have no data to index
+			const Jupiter::ReferenceString &premessage = in_message.getParameter(1);
+			if (premessage.isNotEmpty() && premessage[0] == '\001') //CTCP (ACTIONs are included)
 			{
-				if (w1.equals("PING"))
+				Jupiter::ReferenceString rawmessage(premessage.ptr() + 1, premessage.size() - 1);
+				Jupiter::ReferenceString ctcp_command = rawmessage.getWord(0, WHITESPACE);
+				if (ctcp_command.isNotEmpty() && ctcp_command[ctcp_command.size() - 1] == IRC::CTCP) ctcp_command.truncate(1);
+				Jupiter::ReferenceString ctcp_message = rawmessage.substring(rawmessage.find(' ') + 1, rawmessage.find(IRC::CTCP));
+				if (ctcp_message.isNotEmpty() && ctcp_message[ctcp_message.size() - 1] == IRC::CTCP) ctcp_message.truncate(1);
+
+				if (ctcp_command.equals("ACTION"))
 				{
-					m_socket->send(Jupiter::StringS::Format("PONG %.*s" ENDL, w2.size(), w2.ptr()));
+					this->OnAction(chan, nick, ctcp_message);
+					Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::ACTION, chan, &Jupiter::Plugin::OnAction, chan, nick, ctcp_message);
 				}
-				else if (w1.equals("NICK"))
+				else
 				{
-					if (w2.isNotEmpty())
-						m_nickname = w2;
+					Jupiter::StringL response = "NOTICE ";
+					response += nick;
+					response += " :" IRCCTCP;
+					response += ctcp_command;
+					response += ' ';
+					if (ctcp_command.equals("PING")) response += ctcp_message;
+					else if (ctcp_command.equals("VERSION")) response += Jupiter::version;
+					else if (ctcp_command.equals("FINGER")) response += "Oh, yeah, a little to the left.";
+					else if (ctcp_command.equals("SOURCE")) response += "https://github.com/JAJames/Jupiter";
+					else if (ctcp_command.equals("USERINFO")) response += "Hey, I'm Jupiter! If you have questions, ask Agent! (irc.cncirc.net)";
+					else if (ctcp_command.equals("CLIENTINFO")) response += "I'll tell you what I don't know: This command!";
+					else if (ctcp_command.equals("TIME")) response += getTime();
+					else if (ctcp_command.equals("ERRMSG")) response += ctcp_message;
+					else
+					{
+						response = "NOTICE ";
+						response += nick;
+						response += " :" IRCCTCP "ERRMSG ";
+						response += ctcp_command;
+						response += " :Query is unknown";
+					}
+					response += IRCCTCP ENDL;
+					Jupiter::IRC::Client::scheduleSend(Jupiter::StringS(response), SendPriority::INTERACTIVE); // flood controlled, since anyone can trigger it
+					this->OnCTCP(chan, nick, ctcp_command, ctcp_message);
+					Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::CTCP, chan, &Jupiter::Plugin::OnCTCP, chan, nick, ctcp_message);
 				}
-				else if (w1.equals("ERROR"))
+			}
+			else
+			{
+				this->OnChat(chan, nick, premessage);
+				Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::CHAT, chan, &Jupiter::Plugin::OnChat, chan, nick, premessage);
+			}
+		}
+	}
+}
+
+void Jupiter::IRC::Client::handleNOTICE(const Jupiter::IRC::Message &in_message)
+{
+	const Jupiter::ReferenceString &chan = in_message.getParameter(0);
+	if (chan.isNotEmpty())
+	{
+		const Jupiter::ReferenceString &notice = in_message.getParameter(1);
+		const Jupiter::ReferenceString &sender = in_message.getNickname();
+		if (in_message.isUserPrefix())
+		{
+			this->OnNotice(chan, sender, notice);
+			Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::NOTICE, chan, &Jupiter::Plugin::OnNotice, chan, sender, notice);
+		}
+		else if (sender.isNotEmpty())
+		{
+			this->OnServerNotice(chan, sender, notice);
+			Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::SERVER_NOTICE, Jupiter::ReferenceString::empty, &Jupiter::Plugin::OnServerNotice, chan, sender, notice);
+		}
+	}
+}
+
+void Jupiter::IRC::Client::handleNICK(const Jupiter::IRC::Message &in_message)
+{
+	const Jupiter::ReferenceString &newnick = in_message.getParameter(0);
+
+	if (in_message.getPrefix().isEmpty()) // Nickname assigned by the server
+	{
+		if (newnick.isNotEmpty())
+			m_nickname = newnick;
+		return;
+	}
+
+	const Jupiter::ReferenceString &nick = in_message.getNickname();
+	if (nick.equalsi(m_nickname))
+	{
+		m_nickname = newnick;
+	}
+	if (Client::renameUser(nick, newnick) != nullptr)
+		this->OnNick(nick, newnick);
+
+	Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::NICK, Jupiter::ReferenceString::empty, &Jupiter::Plugin::OnNick, nick, newnick);
+}
+
+void Jupiter::IRC::Client::handleJOIN(const Jupiter::IRC::Message &in_message)
+{
+	const Jupiter::ReferenceString &nick = in_message.getNickname();
+	const Jupiter::ReferenceString &chan = in_message.getParameter(0);
+	if (nick.isEmpty())
+		return;
+
+	Channel *channel = Jupiter::IRC::Client::getChannel(chan);
+
+	if (m_nickname.equalsi(nick))
+	{
+		// TODO: Optimize by simply wiping channel data, rather than removing and re-adding
+		if (channel != nullptr)
+			Client::delChannel(channel->getName());
+
+		Client::addChannel(chan);
+		channel = Jupiter::IRC::Client::getChannel(chan);
+		channel->m_adding_names = true;
+
+		if (channel->getType() < 0)
+		{
+			if (m_auto_part_message.isNotEmpty())
+				Jupiter::IRC::Client::partChannel(chan, m_auto_part_message);
+			else
+				Jupiter::IRC::Client::partChannel(chan);
+		}
+	}
+	else if (channel != nullptr)
+		channel->addUser(Client::findUserOrAdd(nick));
+
+	this->OnJoin(chan, nick);
+
+	Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::JOIN, chan, &Jupiter::Plugin::OnJoin, chan, nick);
+}
+
+void Jupiter::IRC::Client::handlePART(const Jupiter::IRC::Message &in_message)
+{
+	const Jupiter::ReferenceString &nick = in_message.getNickname();
+	if (nick.isNotEmpty())
+	{
+		const Jupiter::ReferenceString &chan = in_message.getParameter(0);
+		if (chan.isNotEmpty())
+		{
+			Channel *channel = Jupiter::IRC::Client::getChannel(chan);
+			if (channel != nullptr)
+			{
+				Jupiter::IRC::Client::User *user = Client::findUser(nick);
+				if (user != nullptr)
 				{
-					Jupiter::ReferenceString reason = Jupiter::ReferenceString::substring(line, line.find(':') + 1);
-					this->OnError(reason);
-					for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-						Jupiter::plugins->get(i)->OnError(this, reason);
-					Jupiter::IRC::Client::disconnect();
+					channel->delUser(nick);
+					const Jupiter::ReferenceString &reason = in_message.getParameter(1);
+
+					this->OnPart(chan, nick, reason);
+					
+					Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::PART, chan, &Jupiter::Plugin::OnPart, chan, nick, reason);
+					
+					if (nick.equalsi(m_nickname))
+						Client::delChannel(chan);
+					
+					Client::delUser(nick);
 				}
-				else if (w1.equals("AUTHENTICATE"))
+			}
+		}
+	}
+}
+
+void Jupiter::IRC::Client::handleKICK(const Jupiter::IRC::Message &in_message)
+{
+	const Jupiter::ReferenceString &chan = in_message.getParameter(0);
+	if (chan.isNotEmpty())
+	{
+		const Jupiter::ReferenceString &kicker = in_message.getNickname();
+		if (kicker.isNotEmpty())
+		{
+			const Jupiter::ReferenceString &kicked = in_message.getParameter(1);
+			if (kicked.isNotEmpty())
+			{
+				Channel *channel = Jupiter::IRC::Client::getChannel(chan);
+				if (channel != nullptr)
 				{
-					if (m_sasl_password.isNotEmpty())
+					Jupiter::IRC::Client::User *user = Client::findUser(kicked);
+					if (user != nullptr)
 					{
-						Jupiter::StringS auth_str = m_nickname + '\0' + m_sasl_account + '\0' + m_sasl_password;
+						channel->delUser(kicked);
+						const Jupiter::ReferenceString &reason = in_message.getParameter(2);
+
+						this->OnKick(chan, kicker, kicked, reason);
+
+						Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::KICK, chan, &Jupiter::Plugin::OnKick, chan, kicker, kicked, reason);
 
-						char *enc = Jupiter::base64encode(auth_str.ptr(), auth_str.size());
-						m_socket->send("AUTHENTICATE "_jrs + enc + ENDL);
-						delete[] enc;
+						if (kicked.equalsi(m_nickname))
+						{
+							Client::delChannel(chan);
+							if (m_join_on_kick)
+								Jupiter::IRC::Client::joinChannel(chan);
+						}
+
+						Client::delUser(kicked);
 					}
-					m_socket->send("CAP END" ENDL);
-					Client::registerClient();
 				}
 			}
-			if (numeric != 0)
+		}
+	}
+}
+
+void Jupiter::IRC::Client::handleQUIT(const Jupiter::IRC::Message &in_message)
+{
+	const Jupiter::ReferenceString &nick = in_message.getNickname();
+	const Jupiter::ReferenceString &reason = in_message.getParameter(0);
+	Jupiter::IRC::Client::User *user = Client::findUser(nick);
+	if (user != nullptr)
+	{
+		// Only the channels the user is actually in need to be visited; each removal unlinks itself from m_channels
+		std::vector<Channel *> channels = user->m_channels;
+		for (Channel *channel : channels)
+			channel->delUser(nick);
+
+		this->OnQuit(nick, reason);
+
+		Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::QUIT, Jupiter::ReferenceString::empty, &Jupiter::Plugin::OnQuit, nick, reason);
+
+		m_users.remove(Key(nick, m_case_mapping));
+	}
+}
+
+void Jupiter::IRC::Client::handleINVITE(const Jupiter::IRC::Message &in_message)
+{
+	const Jupiter::ReferenceString &inviter = in_message.getNickname();
+	const Jupiter::ReferenceString &invited = in_message.getParameter(0);
+	const Jupiter::ReferenceString &chan = in_message.getParameter(1);
+	this->OnInvite(chan, inviter, invited);
+	Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::INVITE, chan, &Jupiter::Plugin::OnInvite, chan, inviter, invited);
+}
+
+void Jupiter::IRC::Client::handleMODE(const Jupiter::IRC::Message &in_message)
+{
+	const Jupiter::ReferenceString &chan = in_message.getParameter(0);
+	if (chan.isNotEmpty())
+	{
+		if (m_chan_types.contains(chan[0]))
+		{
+			const Jupiter::ReferenceString &nick = in_message.getNickname();
+			if (nick.isNotEmpty())
 			{
-				this->OnNumeric(numeric, line);
-				for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-					Jupiter::plugins->get(i)->OnNumeric(this, numeric, line);
+				Jupiter::ReferenceString modestring = in_message.getParametersFrom(1);
+				if (in_message.getParameterCount() > 2)
+				{
+					const Jupiter::ReferenceString &modes = in_message.getParameter(1);
+					if (modes.isNotEmpty())
+					{
+						unsigned char g = 2;
+						char symb = 0;
+						for (uint8_t z = 0; z != modes.size(); z++)
+						{
+							if (modes[z] == '+' || modes[z] == '-')
+								symb = modes[z];
+							else if (m_prefix_modes.contains(modes[z])) // user prefix mode
+							{
+								const Jupiter::ReferenceString &tword = in_message.getParameter(g);
+								if (tword.isNotEmpty())
+								{
+									Jupiter::IRC::Client::Channel *channel = Jupiter::IRC::Client::getChannel(chan);
+									if (channel != nullptr)
+									{
+										if (symb == '+')
+											channel->addUserPrefix(tword, m_prefixes[m_prefix_modes.find(modes[z])]);
+										else
+											channel->delUserPrefix(tword, m_prefixes[m_prefix_modes.find(modes[z])]);
+									}
+								}
+								g++;
+							}
+							else if (m_modeA.contains(modes[z])) // mode type A
+								g++;
+							else if (m_modeB.contains(modes[z])) // mode type B
+								g++;
+							else if (m_modeC.contains(modes[z]) && symb == '+') // mode type C (with parameter)
+								g++;
+							// else; // mode type D
+						}
+					}
+				}
+				this->OnMode(chan, nick, modestring);
+				Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::MODE, chan, &Jupiter::Plugin::OnMode, chan, nick, modestring);
 			}
 		}
-		this->OnRaw(line);
-		for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-			Jupiter::plugins->get(i)->OnRaw(this, line);
 	}
+}
 
-	return 0;
+void Jupiter::IRC::Client::handlePING(const Jupiter::IRC::Message &in_message)
+{
+	const Jupiter::ReferenceString &token = in_message.getParameter(0);
+	Jupiter::IRC::Client::scheduleSend(Jupiter::StringS::Format("PONG :%.*s" ENDL, token.size(), token.ptr()), SendPriority::PROTOCOL);
+}
+
+void Jupiter::IRC::Client::handleERROR(const Jupiter::IRC::Message &in_message)
+{
+	const Jupiter::ReferenceString &reason = in_message.getParameter(0);
+	this->OnError(reason);
+	Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::SERVER_ERROR, Jupiter::ReferenceString::empty, &Jupiter::Plugin::OnError, reason);
+	Jupiter::IRC::Client::disconnect();
+}
+
+void Jupiter::IRC::Client::handleAUTHENTICATE(const Jupiter::IRC::Message &in_message)
+{
+	if (m_sasl_password.isNotEmpty())
+	{
+		Jupiter::StringS auth_str = m_nickname + '\0' + m_sasl_account + '\0' + m_sasl_password;
+
+		char *enc = Jupiter::base64encode(auth_str.ptr(), auth_str.size());
+		m_socket->send("AUTHENTICATE "_jrs + enc + ENDL);
+		delete[] enc;
+	}
+	m_socket->send("CAP END" ENDL);
+	Client::registerClient();
+}
+
+void Jupiter::IRC::Client::handleNAMREPLY(const Jupiter::IRC::Message &in_message)
+{
+	const Jupiter::ReferenceString &chan = in_message.getParameter(2);
+	Jupiter::ReferenceString names = in_message.getParameter(3);
+
+	Channel *channel = Jupiter::IRC::Client::getChannel(chan);
+	if (channel != nullptr)
+	{
+		if (channel->m_adding_names == false)
+		{
+			Client::delChannel(chan);
+			Client::addChannel(chan);
+			channel = Jupiter::IRC::Client::getChannel(chan);
+			channel->m_adding_names = true;
+		}
+
+		// addNamesToChannel can be cut/pasted here
+		Client::addNamesToChannel(*channel, names);
+	}
+}
+
+void Jupiter::IRC::Client::handleENDOFNAMES(const Jupiter::IRC::Message &in_message)
+{
+	const Jupiter::ReferenceString &chan = in_message.getParameter(1);
+	Channel *channel = Jupiter::IRC::Client::getChannel(chan);
+
+	if (channel != nullptr)
+		channel->m_adding_names = false;
+
+	Jupiter::IRC::Client::completeAutoJoin(chan);
+}
+
+void Jupiter::IRC::Client::handleJoinError(const Jupiter::IRC::Message &in_message)
+{
+	// The channel is always the second parameter; for numerics shared with other commands, this is simply not pending
+	Jupiter::IRC::Client::completeAutoJoin(in_message.getParameter(1));
 }
 
 bool Jupiter::IRC::Client::connect()
 {
-	const Jupiter::ReadableString &clientAddress = Jupiter::IRC::Client::readConfigValue("ClientAddress"_jrs);
-	if (m_socket->connect(m_server_hostname.c_str(), m_server_port, clientAddress.isEmpty() ? nullptr : Jupiter::CStringS(clientAddress).c_str(), (unsigned short)Jupiter::IRC::Client::readConfigLong("ClientPort"_jrs)) == false)
+	// The address is normally resolved in advance by reconnect(); this only blocks if it wasn't
+	if (m_server_address == nullptr)
+		m_server_address = Jupiter::Resolver::getDefault().resolve(m_server_hostname.c_str(), m_server_port);
+	m_server_address->wait();
+	if (Jupiter::IRC::Client::startConnect() == false)
 		return false;
 
+	// Wait for the connection; reconnect() instead checks on it each think()
+	int status;
+	do
+		status = m_socket->pollConnect(std::chrono::seconds(1));
+	while (status == 0);
+
+	return status > 0 && Jupiter::IRC::Client::finishConnect();
+}
+
+bool Jupiter::IRC::Client::startConnect()
+{
+	std::shared_ptr<Jupiter::Resolver::Result> server_address = std::move(m_server_address);
+	m_server_address = nullptr;
+
+	const Jupiter::ReadableString &clientAddress = Jupiter::IRC::Client::readConfigValue("ClientAddress"_jrs);
+	return m_socket->connectAsync(*server_address, clientAddress.isEmpty() ? nullptr : Jupiter::CStringS(clientAddress).c_str(), (unsigned short)Jupiter::IRC::Client::readConfigLong("ClientPort"_jrs));
+}
+
+bool Jupiter::IRC::Client::finishConnect()
+{
+	m_socket->setAppendMode(true);
+	m_socket->setQueueMode(true);
+	m_socket->clearBuffer(); // discard any partial line from a previous connection
 	m_socket->setBlocking(false);
 	if (m_ssl == false && Jupiter::IRC::Client::readConfigBool("STARTTLS"_jrs, true))
 	{
@@ -1226,6 +1603,17 @@ void Jupiter::IRC::Client::disconnect(bool stayDead)
 	m_connection_status = 0;
 	m_socket->close();
 	m_reconnect_time = time(0) + m_reconnect_delay;
+
+	// Held back messages were meant for this connection; start the next one with a fresh allowance
+	for (auto &queue : m_outbound_queues)
+		queue.clear();
+	m_outbound_queue_size = 0;
+	Jupiter::IRC::Client::resetFloodTokens();
+	m_max_privmsg_targets = 1; // until the next server says otherwise
+	m_max_join_targets = SIZE_MAX;
+	m_targmax_received = false;
+	m_pending_auto_joins.erase();
+
 	m_dead = stayDead;
 	this->OnDisconnect();
 	bool ssl = Jupiter::IRC::Client::readConfigBool("SSL"_jrs);
@@ -1235,266 +1623,769 @@ void Jupiter::IRC::Client::disconnect(bool stayDead)
 		if (m_ssl)
 		{
 			Jupiter::SecureTCPSocket *t = new Jupiter::SecureTCPSocket(std::move(*m_socket));
-			if (m_ssl_certificate.isNotEmpty())
-				t->setCertificate(m_ssl_certificate, m_ssl_key);
+			Jupiter::IRC::Client::setupSecureSocket(*t);
+
+			delete m_socket;
+			m_socket = t;
+		}
+		else
+		{
+			Jupiter::TCPSocket *t = new Jupiter::TCPSocket(std::move(*m_socket));
+			delete m_socket;
+			m_socket = t;
+		}
+	}
+	Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::DISCONNECT, Jupiter::ReferenceString::empty, &Jupiter::Plugin::OnDisconnect);
+}
+
+void Jupiter::IRC::Client::disconnect(const Jupiter::ReadableString &message, bool stayDead)
+{
+	m_socket->send(Jupiter::StringS::Format("QUIT :%.*s" ENDL, message.size(), message.ptr()));
+	Jupiter::IRC::Client::disconnect(stayDead);
+}
+
+void Jupiter::IRC::Client::reconnect()
+{
+	auto attempted = [this](bool successConnect)
+	{
+		this->OnReconnectAttempt(successConnect);
+		Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::RECONNECT_ATTEMPT, Jupiter::ReferenceString::empty, &Jupiter::Plugin::OnReconnectAttempt, successConnect);
+	};
+
+	if (m_connection_status != 0) Jupiter::IRC::Client::disconnect();
+
+	if (m_socket->isConnecting() == false)
+	{
+		// Resolve the server's address in the background; think() calls back in here until it's available
+		if (m_server_address != nullptr && (m_server_address->getPort() != m_server_port || m_server_hostname.equals(m_server_address->getHostname()) == false))
+			m_server_address = nullptr; // server changed (i.e: bounce) while resolving
+		if (m_server_address == nullptr)
+			m_server_address = Jupiter::Resolver::getDefault().resolve(m_server_hostname.c_str(), m_server_port);
+		if (m_server_address->isReady() == false)
+			return;
+
+		m_reconnect_attempts++;
+		if (Jupiter::IRC::Client::startConnect() == false)
+		{
+			attempted(false);
+			return;
+		}
+	}
+
+	// Check on the connection; think() calls back in here until it completes
+	int status = m_socket->pollConnect();
+	if (status != 0)
+		attempted(status > 0 && Jupiter::IRC::Client::finishConnect());
+}
+
+int Jupiter::IRC::Client::think()
+{
+	auto handle_error = [this](int error_code)
+	{
+		if (this->m_dead == true)
+			return error_code;
+
+		if (this->m_max_reconnect_attempts < 0 || this->m_reconnect_attempts < this->m_max_reconnect_attempts)
+		{
+			if (this->m_server_address != nullptr || this->m_socket->isConnecting() || !this->m_reconnect_delay || this->m_reconnect_time < time(0))
+				this->reconnect();
+
+			return 0;
+		}
+
+		return error_code;
+	};
+
+	if (m_connection_status == 0)
+		return handle_error(-1);
+
+	m_network_thread = std::this_thread::get_id();
+	int tmp;
+
+	// Release anything flood control has since made room for, then write anything which was queued while the socket was busy
+	Jupiter::IRC::Client::flushOutbound();
+	if (m_socket->getQueuedSize() != 0 && m_socket->flush() < 0)
+	{
+		tmp = m_socket->getLastError();
+		Jupiter::IRC::Client::disconnect();
+		return handle_error(tmp);
+	}
+
+	tmp = m_socket->recv();
+	if (tmp > 0)
+	{
+		// Process each complete line in place; a trailing partial line stays in the socket's buffer until the rest of it arrives
+		Jupiter::Socket *socket = m_socket;
+		size_t scan_offset = socket->getBuffer().size() - tmp; // only newly received data can complete a line
+		const char *line_end;
+
+		while (true)
+		{
+			const Jupiter::ReadableString &buffer = socket->getBuffer();
+			line_end = reinterpret_cast<const char *>(memchr(buffer.ptr() + scan_offset, '\n', buffer.size() - scan_offset));
+			if (line_end == nullptr)
+				break;
+
+			Jupiter::ReferenceString line(buffer.ptr(), line_end - buffer.ptr());
+			if (line.isNotEmpty() && line.get(line.size() - 1) == '\r')
+				line.truncate(1);
+
+			// Consume before processing, since processing may replace the socket (i.e: STARTTLS); the line remains valid until the next recv()
+			socket->consume(line_end - buffer.ptr() + 1);
+			scan_offset = 0;
+
+			if (Jupiter::IRC::Client::process_line(line) != 0)
+				return handle_error(1);
+
+			// Remaining data belongs to a connection which has since been replaced
+			if (m_socket != socket || m_connection_status == 0)
+				break;
+		}
+
+		return 0;
+	}
+
+	// No incoming data; check for errors
+	tmp = m_socket->getLastError();
+
+	if (tmp == 10035) // Operation would block
+		return 0;
+
+	// Serious error; disconnect if necessary
+	if (m_connection_status != 0)
+		Jupiter::IRC::Client::disconnect();
+
+	return handle_error(tmp);
+}
+
+const Jupiter::ReadableString &Jupiter::IRC::Client::readConfigValue(const Jupiter::ReadableString &key, const Jupiter::ReadableString &defaultValue) const
+{
+	if (m_primary_section != nullptr)
+	{
+		const Jupiter::ReadableString &val = m_primary_section->get(key);
+
+		if (val.isNotEmpty())
+			return val;
+	}
+
+	if (m_secondary_section != nullptr)
+		return m_secondary_section->get(key, defaultValue);
+
+	return defaultValue;
+}
+
+bool Jupiter::IRC::Client::readConfigBool(const Jupiter::ReadableString &key, bool defaultValue) const
+{
+	if (m_primary_section != nullptr)
+	{
+		const Jupiter::ReadableString &val = m_primary_section->get(key);
+
+		if (val.isNotEmpty())
+			return val.asBool();
+	}
+
+	if (m_secondary_section != nullptr)
+		return m_secondary_section->get<bool>(key, defaultValue);
+
+	return defaultValue;
+}
+
+int Jupiter::IRC::Client::readConfigInt(const Jupiter::ReadableString &key, int defaultValue) const
+{
+	if (m_primary_section != nullptr)
+	{
+		const Jupiter::ReadableString &val = m_primary_section->get(key);
+
+		if (val.isNotEmpty())
+			return val.asInt();
+	}
+
+	if (m_secondary_section != nullptr)
+		return m_secondary_section->get<int>(key, defaultValue);
+
+	return defaultValue;
+}
+
+long Jupiter::IRC::Client::readConfigLong(const Jupiter::ReadableString &key, long defaultValue) const
+{
+	if (m_primary_section != nullptr)
+	{
+		const Jupiter::ReadableString &val = m_primary_section->get(key);
+
+		if (val.isNotEmpty())
+			return val.asInt();
+	}
+
+	if (m_secondary_section != nullptr)
+		return m_secondary_section->get<long>(key, defaultValue);
+
+	return defaultValue;
+}
+
+double Jupiter::IRC::Client::readConfigDouble(const Jupiter::ReadableString &key, double defaultValue) const
+{
+	if (m_primary_section != nullptr)
+	{
+		const Jupiter::ReadableString &val = m_primary_section->get(key);
+
+		if (val.isNotEmpty())
+			return val.asDouble();
+	}
+
+	if (m_secondary_section != nullptr)
+		return m_secondary_section->get<double>(key, defaultValue);
+
+	return defaultValue;
+}
+
+void Jupiter::IRC::Client::writeToLogs(const Jupiter::ReadableString &message)
+{
+	if (m_log_output != nullptr)
+		Jupiter::LogWriter::getDefault().write(m_log_output, message);
+}
+
+/**
+* @brief IRC Client Private Function Implementations
+*/
+
+void Jupiter::IRC::Client::delChannel(const Jupiter::ReadableString &in_channel)
+{
+	Key key(in_channel, m_case_mapping);
+	std::shared_ptr<Channel> *entry = m_channels.get(key);
+	if (entry == nullptr)
+		return;
+
+	// Hold onto the channel until its memberships are unlinked below
+	std::shared_ptr<Channel> channel = *entry;
+	m_channels.remove(key);
+
+	// Users which are only known through this channel are forgotten along with it
+	std::vector<Jupiter::StringS> nicknames;
+	auto find_lone_users_callback = [&nicknames](Channel::UserTableType::Bucket::Entry &in_entry)
+	{
+		if (in_entry.value->getChannelCount() == 1)
+			nicknames.push_back(in_entry.value->getNickname());
+	};
+
+	channel->m_users.callback(find_lone_users_callback);
+	channel.reset(); // unlinks each membership
+
+	// Forget the channel's strand once its offloaded events have finished; otherwise, it's kept until the client is deleted
+	std::shared_ptr<Jupiter::WorkerPool::Strand> *strand = m_channel_strands.get(key);
+	if (strand != nullptr && (*strand)->isIdle())
+		m_channel_strands.remove(key);
+
+	for (const Jupiter::StringS &nickname : nicknames)
+		Client::delUser(nickname);
+}
+
+void Jupiter::IRC::Client::setCaseMapping(CaseMapping in_case_mapping)
+{
+	if (in_case_mapping == m_case_mapping)
+		return;
+
+	// Tables kept from a previous connection (i.e: after a reconnect or bounce) are keyed under the old mapping
+	std::vector<std::shared_ptr<Channel>> channels;
+	auto collect_channels_callback = [&channels](ChannelTableType::Bucket::Entry &in_entry)
+	{
+		channels.push_back(in_entry.value);
+	};
+
+	std::vector<std::shared_ptr<User>> users;
+	auto collect_users_callback = [&users](UserTableType::Bucket::Entry &in_entry)
+	{
+		users.push_back(in_entry.value);
+	};
+
+	std::vector<std::shared_ptr<Channel::User>> channel_users;
+	auto collect_channel_users_callback = [&channel_users](Channel::UserTableType::Bucket::Entry &in_entry)
+	{
+		channel_users.push_back(in_entry.value);
+	};
+
+	m_channels.callback(collect_channels_callback);
+	m_users.callback(collect_users_callback);
+
+	// Strands can only be found through their channel's name; any others are left to finish and forgotten
+	std::vector<std::pair<std::shared_ptr<Channel>, std::shared_ptr<Jupiter::WorkerPool::Strand>>> strands;
+	for (const std::shared_ptr<Channel> &channel : channels)
+	{
+		std::shared_ptr<Jupiter::WorkerPool::Strand> *strand = m_channel_strands.get(Key(channel->getName(), m_case_mapping));
+		if (strand != nullptr)
+			strands.emplace_back(channel, *strand);
+	}
+
+	m_case_mapping = in_case_mapping;
+	m_channels.erase();
+	m_users.erase();
+	m_channel_strands.erase();
+
+	for (const std::shared_ptr<Channel> &channel : channels)
+	{
+		channel_users.clear();
+		channel->m_users.callback(collect_channel_users_callback);
+		channel->m_users.erase();
+		for (const std::shared_ptr<Channel::User> &channel_user : channel_users)
+			channel->m_users.set(Key(channel_user->getNickname(), m_case_mapping), channel_user);
+
+		m_channels.set(Key(channel->getName(), m_case_mapping), channel);
+	}
+
+	for (const std::shared_ptr<User> &user : users)
+	{
+		Key key(user->getNickname(), m_case_mapping);
+		if (m_users.get(key) == nullptr)
+		{
+			m_users.set(key, user);
+			continue;
+		}
+
+		// Two nicknames now fold to the same key; the second user's memberships must go along with it
+		std::vector<Channel *> user_channels = user->m_channels; // shrinks as memberships are removed
+		for (Channel *channel : user_channels)
+		{
+			std::shared_ptr<Channel::User> *entry = channel->m_users.get(key);
+			if (entry != nullptr && (*entry)->getUser() == user.get())
+				channel->m_users.remove(key);
+		}
+	}
+
+	for (const auto &strand : strands)
+		m_channel_strands.set(Key(strand.first->getName(), m_case_mapping), strand.second);
+}
+
+void Jupiter::IRC::Client::remapPrefixMasks(const Jupiter::ReadableString &in_old_prefixes)
+{
+	// Memberships kept from a previous connection hold bits for the old PREFIX; prefixes which no longer exist are dropped
+	uint32_t remap[32];
+	size_t index;
+	for (index = 0; index != 32; ++index)
+	{
+		size_t new_index = index < in_old_prefixes.size() ? m_prefixes.find(in_old_prefixes.get(index)) : JUPITER_INVALID_INDEX;
+		remap[index] = new_index < 32 ? uint32_t{ 1 } << new_index : 0;
+	}
+
+	auto remap_user_callback = [&remap](Channel::UserTableType::Bucket::Entry &in_entry)
+	{
+		uint32_t old_mask = in_entry.value->m_prefix_mask;
+		uint32_t new_mask = 0;
+		while (old_mask != 0)
+		{
+			new_mask |= remap[find_first_set(old_mask)];
+			old_mask &= old_mask - 1;
+		}
+
+		in_entry.value->m_prefix_mask = new_mask;
+	};
+
+	auto remap_channel_callback = [&remap_user_callback](ChannelTableType::Bucket::Entry &in_entry)
+	{
+		in_entry.value->m_users.callback(remap_user_callback);
+	};
+
+	m_channels.callback(remap_channel_callback);
+}
+
+Jupiter::IRC::Client::User *Jupiter::IRC::Client::findUser(const Jupiter::ReadableString &in_nickname) const
+{
+	std::shared_ptr<User> *user = m_users.get(Key(in_nickname, m_case_mapping));
+
+	if (user != nullptr)
+		return user->get();
+
+	return nullptr;
+}
+
+Jupiter::IRC::Client::User *Jupiter::IRC::Client::findUserOrAdd(const Jupiter::ReadableString &name)
+{
+	Jupiter::ReferenceString nick = Jupiter::ReferenceString::getWord(name, 0, "!");
+	Jupiter::IRC::Client::User *result = Jupiter::IRC::Client::findUser(nick);
+
+	if (result != nullptr)
+		return result;
+
+	std::shared_ptr<User> user = std::make_shared<User>();
+	user->m_nickname = nick;
+	user->m_username = Jupiter::ReferenceString::getWord(name, 1, "!@");
+	user->m_hostname = Jupiter::ReferenceString::getWord(name, 2, "!@");
+	m_users.set(Key(nick, m_case_mapping), user);
+
+	return user.get();
+}
+
+Jupiter::IRC::Client::User *Jupiter::IRC::Client::renameUser(const Jupiter::ReadableString &in_nickname, const Jupiter::ReadableString &in_new_nickname)
+{
+	Key key(in_nickname, m_case_mapping);
+	std::shared_ptr<User> *user_entry = m_users.get(key);
+	if (user_entry == nullptr)
+		return nullptr;
+
+	std::shared_ptr<User> user = *user_entry;
+	Key new_key(in_new_nickname, m_case_mapping);
+
+	// A stale user may already hold the new nickname (i.e: one left over from before a reconnect). Its memberships
+	// must go before its entry is replaced, since each one refers back to it.
+	std::shared_ptr<User> *existing_entry = m_users.get(new_key);
+	if (existing_entry != nullptr && existing_entry->get() != user.get())
+	{
+		std::shared_ptr<User> existing = *existing_entry;
+		std::vector<Channel *> channels = existing->m_channels; // shrinks as memberships are removed
+		for (Channel *channel : channels)
+			channel->m_users.remove(new_key);
+
+		m_users.remove(new_key);
+	}
+
+	m_users.remove(key);
+
+	// Re-key the user's entry in each channel it's in; both keys are only folded and hashed once
+	for (Channel *channel : user->m_channels)
+	{
+		std::shared_ptr<Channel::User> *entry = channel->m_users.get(key);
+		if (entry != nullptr)
+		{
+			std::shared_ptr<Channel::User> channel_user = *entry;
+			channel->m_users.remove(key);
+			channel->m_users.set(new_key, channel_user);
+		}
+	}
+
+	user->m_nickname = in_new_nickname;
+	m_users.set(new_key, user);
+
+	return user.get();
+}
+
+void Jupiter::IRC::Client::delUser(const Jupiter::ReadableString &in_nickname)
+{
+	Jupiter::IRC::Client::User *user = Client::findUser(in_nickname);
+
+	if (user != nullptr && user->getChannelCount() == 0)
+		m_users.remove(Key(in_nickname, m_case_mapping));
+}
+
+void Jupiter::IRC::Client::addNamesToChannel(Channel &in_channel, Jupiter::ReadableString &in_names)
+{
+	Jupiter::ReferenceString tmp;
+	size_t offset;
+	unsigned int nameLen = in_names.wordCount(" ");
+
+	for (size_t i = 0; i != nameLen; i++)
+	{
+		tmp = Jupiter::ReferenceString::getWord(in_names, i, " ");
+
+		if (tmp.isNotEmpty())
+		{
+			offset = tmp.span(m_prefixes);
+			tmp.shiftRight(offset);
+
+			Client::User *user = Client::findUserOrAdd(tmp);
+			tmp.shiftLeft(offset);
+
+			in_channel.addUser(user);
+
+			while (offset > 0)
+			{
+				--offset;
 
-			delete m_socket;
-			m_socket = t;
-		}
-		else
-		{
-			Jupiter::TCPSocket *t = new Jupiter::TCPSocket(std::move(*m_socket));
-			delete m_socket;
-			m_socket = t;
+				in_channel.addUserPrefix(user->getNickname(), tmp[offset]);
+			}
 		}
 	}
-	for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-		Jupiter::plugins->get(i)->OnDisconnect(this);
 }
 
-void Jupiter::IRC::Client::disconnect(const Jupiter::ReadableString &message, bool stayDead)
+void Jupiter::IRC::Client::addChannel(const Jupiter::ReadableString &in_channel)
 {
-	m_socket->send(Jupiter::StringS::Format("QUIT :%.*s" ENDL, message.size(), message.ptr()));
-	Jupiter::IRC::Client::disconnect(stayDead);
+	m_channels.set(Key(in_channel, m_case_mapping), std::make_shared<Channel>(in_channel, this));
 }
 
-void Jupiter::IRC::Client::reconnect()
+void Jupiter::IRC::Client::setupSecureSocket(Jupiter::SecureSocket &in_socket)
 {
-	if (m_connection_status != 0) Jupiter::IRC::Client::disconnect();
-	m_reconnect_attempts++;
-	bool successConnect = Jupiter::IRC::Client::connect();
-	this->OnReconnectAttempt(successConnect);
-	for (size_t i = 0; i < Jupiter::plugins->size(); i++)
-		Jupiter::plugins->get(i)->OnReconnectAttempt(this, successConnect);
+	in_socket.setContext(m_ssl_context);
+	in_socket.setDrainMode(true); // hand bursts (i.e: NAMES replies) to the parser at once
+	if (Jupiter::IRC::Client::readConfigBool("SSL.Offload"_jrs))
+		in_socket.setOffload(&Jupiter::WorkerPool::getDefault());
 }
 
-int Jupiter::IRC::Client::think()
+void Jupiter::IRC::Client::autoJoinChannels()
 {
-	auto handle_error = [this](int error_code)
-	{
-		if (this->m_dead == true)
-			return error_code;
+	// Keyed channels are joined first, since a JOIN's keys apply to its leading channels
+	std::vector<const Jupiter::ReadableString *> keyed_channels;
+	std::vector<const Jupiter::ReadableString *> keys;
+	std::vector<const Jupiter::ReadableString *> channels;
 
-		if (this->m_max_reconnect_attempts < 0 || this->m_reconnect_attempts < this->m_max_reconnect_attempts)
+	auto auto_join_channels_callback = [&](Jupiter::Config::SectionHashTable::Bucket::Entry &in_entry)
+	{
+		if (in_entry.value.get<bool>("AutoJoin"_jrs, false)
+			&& m_pending_auto_joins.set(Key(in_entry.value.getName(), m_case_mapping))) // not already configured in the other section
 		{
-			if (!this->m_reconnect_delay || this->m_reconnect_time < time(0))
-				this->reconnect();
-
-			return 0;
+			const Jupiter::ReadableString &key = in_entry.value.get("Key"_jrs);
+			if (key.isEmpty())
+				channels.push_back(&in_entry.value.getName());
+			else
+			{
+				keyed_channels.push_back(&in_entry.value.getName());
+				keys.push_back(&key);
+			}
 		}
-
-		return error_code;
 	};
 
-	if (m_connection_status == 0)
-		return handle_error(-1);
-
-	int tmp = m_socket->recv();
-	if (tmp > 0)
-	{
-		// Process incoming data
-		Jupiter::ReadableString::TokenizeResult<Jupiter::Reference_String> result = Jupiter::ReferenceString::tokenize(m_socket->getBuffer(), "\r\n"_jrs);
-		if (result.token_count != 0)
-		{
-			if (result.tokens[0].size() > 0)
-			{
-				// Ensure there's not a token getting split over separate buffers
-				if (m_last_line.size() > 0)
-				{
-					if (result.tokens[0][0] == '\n' && m_last_line[m_last_line.size() - 1] == '\r')
-					{
-						m_last_line.truncate(1); // Remove \r
+	m_pending_auto_joins.erase();
 
-						Jupiter::IRC::Client::process_line(m_last_line);
-						m_last_line.erase();
+	Jupiter::Config *config = m_primary_section->getSection("Channels"_jrs);
 
-						result.tokens[0].shiftRight(1); // Remove \n
-					}
-				}
+	if (config != nullptr)
+		config->getSections().callback(auto_join_channels_callback);
 
-				m_last_line += result.tokens[0];
-			}
+	config = m_secondary_section->getSection("Channels"_jrs);
 
-			if (result.token_count != 1)
-			{
-				Jupiter::IRC::Client::process_line(m_last_line);
-				m_last_line = result.tokens[result.token_count - 1];
+	if (config != nullptr)
+		config->getSections().callback(auto_join_channels_callback);
 
-				for (size_t index = 1; index != result.token_count - 1; ++index)
-					if (Jupiter::IRC::Client::process_line(result.tokens[index]) != 0)
-						return handle_error(1);
-			}
-		}
+	keyed_channels.insert(keyed_channels.end(), channels.begin(), channels.end());
+	Jupiter::IRC::Client::joinChannels(keyed_channels, keys);
+}
 
-		return 0;
+void Jupiter::IRC::Client::completeAutoJoin(const Jupiter::ReadableString &in_channel)
+{
+	if (m_pending_auto_joins.remove(Key(in_channel, m_case_mapping)) && m_pending_auto_joins.size() == 0)
+	{
+		this->OnAutoJoinSynced();
+		Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event::AUTO_JOIN_SYNCED, Jupiter::ReferenceString::empty, &Jupiter::Plugin::OnAutoJoinSynced);
 	}
+}
 
-	// No incoming data; check for errors
-	tmp = m_socket->getLastError();
+bool Jupiter::IRC::Client::isFloodControlled() const
+{
+	return m_flood_window.count() > 0 && (m_flood_lines != 0 || m_flood_bytes != 0);
+}
 
-	if (tmp == 10035) // Operation would block
-		return 0;
+void Jupiter::IRC::Client::resetFloodTokens()
+{
+	m_flood_line_tokens = static_cast<double>(m_flood_lines);
+	m_flood_byte_tokens = static_cast<double>(m_flood_bytes);
+	m_flood_refill_time = std::chrono::steady_clock::now();
+}
 
-	// Serious error; disconnect if necessary
-	if (m_connection_status != 0)
-		Jupiter::IRC::Client::disconnect();
+void Jupiter::IRC::Client::refillFloodTokens()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double windows = std::chrono::duration<double, std::milli>(now - m_flood_refill_time).count() / m_flood_window.count();
+	m_flood_refill_time = now;
 
-	return handle_error(tmp);
+	m_flood_line_tokens = std::min(m_flood_line_tokens + windows * m_flood_lines, static_cast<double>(m_flood_lines));
+	m_flood_byte_tokens = std::min(m_flood_byte_tokens + windows * m_flood_bytes, static_cast<double>(m_flood_bytes));
 }
 
-const Jupiter::ReadableString &Jupiter::IRC::Client::readConfigValue(const Jupiter::ReadableString &key, const Jupiter::ReadableString &defaultValue) const
+bool Jupiter::IRC::Client::takeFloodTokens(size_t in_size)
 {
-	if (m_primary_section != nullptr)
-	{
-		const Jupiter::ReadableString &val = m_primary_section->get(key);
-
-		if (val.isNotEmpty())
-			return val;
-	}
+	// A line larger than the whole byte allowance can still be sent once the bucket is full
+	double bytes = static_cast<double>(std::min(in_size, m_flood_bytes));
 
-	if (m_secondary_section != nullptr)
-		return m_secondary_section->get(key, defaultValue);
+	if ((m_flood_lines != 0 && m_flood_line_tokens < 1.0) || m_flood_byte_tokens < bytes)
+		return false;
 
-	return defaultValue;
+	if (m_flood_lines != 0)
+		m_flood_line_tokens -= 1.0;
+	m_flood_byte_tokens -= bytes;
+	return true;
 }
 
-bool Jupiter::IRC::Client::readConfigBool(const Jupiter::ReadableString &key, bool defaultValue) const
+void Jupiter::IRC::Client::scheduleSend(Jupiter::StringS &&in_data, SendPriority in_priority)
 {
-	if (m_primary_section != nullptr)
+	if (Jupiter::IRC::Client::isNetworkThread() == false)
 	{
-		const Jupiter::ReadableString &val = m_primary_section->get(key);
+		// Called from an offloaded plugin hook; hand the data back to the network thread
+		std::lock_guard<std::mutex> guard(m_marshalled_mutex);
+		m_marshalled_sends.emplace_back(std::move(in_data), in_priority);
+		++m_marshalled_count;
+		return;
+	}
 
-		if (val.isNotEmpty())
-			return val.asBool();
+	if (Jupiter::IRC::Client::isFloodControlled() == false)
+	{
+		m_socket->send(in_data);
+		return;
 	}
 
-	if (m_secondary_section != nullptr)
-		return m_secondary_section->get<bool>(key, defaultValue);
+	if (m_outbound_queue_size == 0)
+	{
+		Jupiter::IRC::Client::refillFloodTokens();
+		if (Jupiter::IRC::Client::takeFloodTokens(in_data.size()))
+		{
+			m_socket->send(in_data);
+			return;
+		}
+	}
 
-	return defaultValue;
+	size_t lane = static_cast<size_t>(in_priority);
+	if (m_max_outbound_queue_size != 0 && m_outbound_queue_size >= m_max_outbound_queue_size)
+	{
+		// Make room by dropping the oldest message of the lowest priority lane which is no more important than this one;
+		// the protocol lane itself is never scanned, since protocol traffic is never dropped
+		size_t floor = in_priority == SendPriority::PROTOCOL ? static_cast<size_t>(SendPriority::INTERACTIVE) : lane;
+		size_t index = sizeof(m_outbound_queues) / sizeof(*m_outbound_queues);
+		while (index != floor && m_outbound_queues[index - 1].empty())
+			--index;
+
+		if (index != floor)
+		{
+			m_outbound_queues[index - 1].pop_front();
+			--m_outbound_queue_size;
+			++m_outbound_drop_count;
+		}
+		else if (in_priority != SendPriority::PROTOCOL) // nothing less important to drop; drop this one instead
+		{
+			++m_outbound_drop_count;
+			return;
+		}
+		// else protocol traffic is never dropped; let the queue overflow, which may leave it holding more than MaxQueue messages
+	}
+
+	m_outbound_queues[lane].push_back({ std::move(in_data), std::chrono::steady_clock::now() });
+	++m_outbound_queue_size;
+	Jupiter::IRC::Client::flushOutbound();
 }
 
-int Jupiter::IRC::Client::readConfigInt(const Jupiter::ReadableString &key, int defaultValue) const
+size_t Jupiter::IRC::Client::flushOutbound()
 {
-	if (m_primary_section != nullptr)
+	if (m_marshalled_count != 0)
+		Jupiter::IRC::Client::drainMarshalledSends();
+
+	if (m_outbound_queue_size == 0)
+		return 0;
+
+	Jupiter::IRC::Client::refillFloodTokens();
+
+	size_t count = 0;
+	Jupiter::Socket::Cork cork(*m_socket);
+	for (auto &queue : m_outbound_queues)
 	{
-		const Jupiter::ReadableString &val = m_primary_section->get(key);
+		while (queue.empty() == false)
+		{
+			if (Jupiter::IRC::Client::takeFloodTokens(queue.front().m_data.size()) == false)
+				return count; // lower priority lanes must wait for the higher priority ones
 
-		if (val.isNotEmpty())
-			return val.asInt();
+			m_socket->send(queue.front().m_data);
+			queue.pop_front();
+			--m_outbound_queue_size;
+			++count;
+		}
 	}
 
-	if (m_secondary_section != nullptr)
-		return m_secondary_section->get<int>(key, defaultValue);
+	return count;
+}
 
-	return defaultValue;
+bool Jupiter::IRC::Client::isNetworkThread() const
+{
+	return std::this_thread::get_id() == m_network_thread.load(std::memory_order_relaxed);
 }
 
-long Jupiter::IRC::Client::readConfigLong(const Jupiter::ReadableString &key, long defaultValue) const
+void Jupiter::IRC::Client::drainMarshalledSends()
 {
-	if (m_primary_section != nullptr)
+	m_network_thread = std::this_thread::get_id();
+	std::vector<std::pair<Jupiter::StringS, SendPriority>> sends;
 	{
-		const Jupiter::ReadableString &val = m_primary_section->get(key);
-
-		if (val.isNotEmpty())
-			return val.asInt();
+		std::lock_guard<std::mutex> guard(m_marshalled_mutex);
+		sends.swap(m_marshalled_sends);
+		m_marshalled_count = 0;
 	}
 
-	if (m_secondary_section != nullptr)
-		return m_secondary_section->get<long>(key, defaultValue);
-
-	return defaultValue;
+	for (auto &send : sends)
+		Jupiter::IRC::Client::scheduleSend(std::move(send.first), send.second);
 }
 
-double Jupiter::IRC::Client::readConfigDouble(const Jupiter::ReadableString &key, double defaultValue) const
+Jupiter::WorkerPool::Strand &Jupiter::IRC::Client::getStrand(const Jupiter::ReadableString &in_channel)
 {
-	if (m_primary_section != nullptr)
+	// Private messages and events outside of a channel share the client's strand
+	if (in_channel.isEmpty() || m_chan_types.contains(in_channel.get(0)) == false)
 	{
-		const Jupiter::ReadableString &val = m_primary_section->get(key);
+		if (m_strand == nullptr)
+			m_strand.reset(new Jupiter::WorkerPool::Strand(Jupiter::Plugin::getHookPool()));
 
-		if (val.isNotEmpty())
-			return val.asDouble();
+		return *m_strand;
 	}
 
-	if (m_secondary_section != nullptr)
-		return m_secondary_section->get<double>(key, defaultValue);
+	Key key(in_channel, m_case_mapping);
+	std::shared_ptr<Jupiter::WorkerPool::Strand> *strand = m_channel_strands.get(key);
+	if (strand != nullptr)
+		return **strand;
 
-	return defaultValue;
+	std::shared_ptr<Jupiter::WorkerPool::Strand> new_strand = std::make_shared<Jupiter::WorkerPool::Strand>(Jupiter::Plugin::getHookPool());
+	m_channel_strands.set(key, new_strand);
+	return *new_strand;
 }
 
-void Jupiter::IRC::Client::writeToLogs(const Jupiter::ReadableString &message)
+void Jupiter::IRC::Client::offload(const Jupiter::ReadableString &in_channel, Jupiter::Plugin *in_plugin, std::function<void()> in_task)
 {
-	if (m_log_file != nullptr)
+	// Plugin::free() waits for the plugin's calls, so that none run after it's unloaded
+	in_plugin->beginOffloadedCall();
+	++m_offloaded_tasks;
+	Jupiter::IRC::Client::getStrand(in_channel).post([this, in_plugin, in_task]
 	{
-		message.println(m_log_file);
-		fflush(m_log_file);
-	}
+		in_task();
+		--m_offloaded_tasks;
+		in_plugin->endOffloadedCall();
+	});
 }
 
-/**
-* @brief IRC Client Private Function Implementations
-*/
-
-void Jupiter::IRC::Client::delChannel(const Jupiter::ReadableString &in_channel)
+template<typename... HookArgsT, typename... ArgsT>
+void Jupiter::IRC::Client::callPlugins(const std::vector<Jupiter::Plugin *> &in_subscribers, Jupiter::Plugin::Event in_event, const Jupiter::ReadableString &in_channel, void (Jupiter::Plugin::*in_hook)(Jupiter::IRC::Client *, HookArgsT...), const ArgsT &... in_args)
 {
-	m_channels.remove(in_channel);
+	Jupiter::Plugin *plugin;
+	for (size_t index = 0; index < in_subscribers.size(); ++index)
+	{
+		plugin = in_subscribers[index];
+		if (plugin->isOffloaded(in_event))
+		{
+			std::function<void()> call = std::bind(in_hook, plugin, this, copy_hook_argument(in_args)...);
+			Jupiter::IRC::Client::offload(in_channel, plugin, [plugin, in_event, call]
+			{
+				Jupiter::Plugin::HookTimer timer(plugin, in_event);
+				call();
+			});
+		}
+		else
+		{
+			Jupiter::Plugin::HookTimer timer(plugin, in_event);
+			(plugin->*in_hook)(this, in_args...);
+		}
+	}
 }
 
-Jupiter::IRC::Client::User *Jupiter::IRC::Client::findUser(const Jupiter::ReadableString &in_nickname) const
+template<typename... HookArgsT, typename... ArgsT>
+void Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::Event in_event, const Jupiter::ReadableString &in_channel, void (Jupiter::Plugin::*in_hook)(Jupiter::IRC::Client *, HookArgsT...), const ArgsT &... in_args)
 {
-	return m_users.get(in_nickname);
+	Jupiter::IRC::Client::callPlugins(Jupiter::Plugin::getSubscribers(in_event), in_event, in_channel, in_hook, in_args...);
 }
 
-Jupiter::IRC::Client::User *Jupiter::IRC::Client::findUserOrAdd(const Jupiter::ReadableString &name)
+std::chrono::milliseconds Jupiter::IRC::Client::getOutboundDelay()
 {
-	Jupiter::ReferenceString nick = Jupiter::ReferenceString::getWord(name, 0, "!");
-	Jupiter::IRC::Client::User *result = Jupiter::IRC::Client::findUser(nick);
-
-	if (result != nullptr)
-		return result;
-
-	User user;
-	user.m_nickname = nick;
-	user.m_username = Jupiter::ReferenceString::getWord(name, 1, "!@");
-	user.m_hostname = Jupiter::ReferenceString::getWord(name, 2, "!@");
-	m_users.set(nick, user);
-
-	return m_users.get(nick);
-}
+	if (m_outbound_queue_size == 0)
+		return std::chrono::milliseconds::max();
 
-void Jupiter::IRC::Client::addNamesToChannel(Channel &in_channel, Jupiter::ReadableString &in_names)
-{
-	Jupiter::ReferenceString tmp;
-	size_t offset;
-	unsigned int nameLen = in_names.wordCount(" ");
+	Jupiter::IRC::Client::refillFloodTokens();
 
-	for (size_t i = 0; i != nameLen; i++)
+	// Time until enough tokens are available to send the next message
+	const OutboundMessage *next = nullptr;
+	for (const auto &queue : m_outbound_queues)
 	{
-		tmp = Jupiter::ReferenceString::getWord(in_names, i, " ");
-
-		if (tmp.isNotEmpty())
+		if (queue.empty() == false)
 		{
-			offset = tmp.span(m_prefixes);
-			tmp.shiftRight(offset);
-
-			Client::User *user = Client::findUserOrAdd(tmp);
-			tmp.shiftLeft(offset);
-
-			in_channel.addUser(user);
-
-			while (offset > 0)
-			{
-				--offset;
-
-				in_channel.addUserPrefix(user->getNickname(), tmp[offset]);
-			}
+			next = &queue.front();
+			break;
 		}
 	}
-}
 
-void Jupiter::IRC::Client::addChannel(const Jupiter::ReadableString &in_channel)
-{
-	m_channels.set(in_channel, Channel(in_channel, this));
+	double windows = 0.0;
+	if (m_flood_lines != 0 && m_flood_line_tokens < 1.0)
+		windows = (1.0 - m_flood_line_tokens) / m_flood_lines;
+
+	double bytes = static_cast<double>(std::min(next->m_data.size(), m_flood_bytes));
+	if (m_flood_byte_tokens < bytes)
+		windows = std::max(windows, (bytes - m_flood_byte_tokens) / m_flood_bytes);
+
+	return std::chrono::milliseconds(static_cast<std::chrono::milliseconds::rep>(windows * m_flood_window.count()) + 1);
 }
 
 bool Jupiter::IRC::Client::startCAP()
@@ -1509,6 +2400,7 @@ bool Jupiter::IRC::Client::registerClient()
 	const char *localHostname = Jupiter::Socket::getLocalHostname();
 	Jupiter::StringS messageToSend;
 
+	m_socket->cork();
 	messageToSend.format("USER %.*s %s %.*s :%.*s" ENDL, m_nickname.size(), m_nickname.ptr(), localHostname, m_server_hostname.size(), m_server_hostname.ptr(), m_realname.size(), m_realname.ptr());
 	
 	if (m_socket->send(messageToSend) <= 0)
@@ -1519,10 +2411,93 @@ bool Jupiter::IRC::Client::registerClient()
 	if (m_socket->send(messageToSend) <= 0)
 		result = false;
 
+	if (m_socket->uncork() == false)
+		result = false;
+
 	m_connection_status = 3;
 	return result;
 }
 
+/**
+* Key Implementation
+*/
+
+namespace
+{
+	struct CaseMappingTables
+	{
+		char ascii[256];
+		char rfc1459[256];
+		char strict_rfc1459[256];
+
+		CaseMappingTables()
+		{
+			for (size_t index = 0; index != sizeof(ascii); ++index)
+				ascii[index] = static_cast<char>(index >= 'A' && index <= 'Z' ? index + ('a' - 'A') : index);
+
+			memcpy(strict_rfc1459, ascii, sizeof(ascii));
+			strict_rfc1459['['] = '{';
+			strict_rfc1459[']'] = '}';
+			strict_rfc1459['\\'] = '|';
+
+			memcpy(rfc1459, strict_rfc1459, sizeof(strict_rfc1459));
+			rfc1459['^'] = '~';
+		}
+	};
+
+	const char *get_case_mapping_table(Jupiter::IRC::Client::CaseMapping in_case_mapping)
+	{
+		static const CaseMappingTables tables;
+
+		switch (in_case_mapping)
+		{
+		case Jupiter::IRC::Client::CaseMapping::ASCII:
+			return tables.ascii;
+		case Jupiter::IRC::Client::CaseMapping::STRICT_RFC1459:
+			return tables.strict_rfc1459;
+		default:
+			return tables.rfc1459;
+		}
+	}
+}
+
+Jupiter::IRC::Client::Key::Key(const Jupiter::ReadableString &in_name, CaseMapping in_case_mapping)
+{
+	const char *table = get_case_mapping_table(in_case_mapping);
+
+	m_folded.resize(in_name.size());
+	for (size_t index = 0; index != in_name.size(); ++index)
+		m_folded[index] = table[static_cast<unsigned char>(in_name.get(index))];
+
+	if (sizeof(size_t) >= sizeof(uint64_t))
+		m_hash = static_cast<size_t>(Jupiter::fnv1a(m_folded.data(), m_folded.size()));
+	else
+		m_hash = static_cast<size_t>(Jupiter::fnv1a_32(m_folded.data(), m_folded.size()));
+}
+
+const std::string &Jupiter::IRC::Client::Key::getFolded() const
+{
+	return m_folded;
+}
+
+size_t Jupiter::IRC::Client::Key::getHash() const
+{
+	return m_hash;
+}
+
+bool Jupiter::IRC::Client::Key::operator==(const Key &in_key) const
+{
+	// memcmp is vectorized by the runtime; the hash rejects nearly every mismatch before it's reached
+	return m_hash == in_key.m_hash
+		&& m_folded.size() == in_key.m_folded.size()
+		&& memcmp(m_folded.data(), in_key.m_folded.data(), m_folded.size()) == 0;
+}
+
+size_t Jupiter::IRC::Client::Key::hash(const Key &in_key)
+{
+	return in_key.m_hash;
+}
+
 /**
 * User Implementation
 */
@@ -1544,7 +2519,12 @@ const Jupiter::ReadableString &Jupiter::IRC::Client::User::getHostname() const
 
 size_t Jupiter::IRC::Client::User::getChannelCount() const
 {
-	return m_channel_count;
+	return m_channels.size();
+}
+
+const std::vector<Jupiter::IRC::Client::Channel *> &Jupiter::IRC::Client::User::getChannels() const
+{
+	return m_channels;
 }
 
 /**
@@ -1588,46 +2568,46 @@ Jupiter::IRC::Client::Channel::Channel(const Jupiter::ReadableString &in_name, J
 
 Jupiter::IRC::Client::Channel::User *Jupiter::IRC::Client::Channel::addUser(Jupiter::IRC::Client::User *user)
 {
-	Channel::User channel_user;
-	channel_user.m_user = user;
-
-	++user->m_channel_count;
+	std::shared_ptr<Channel::User> channel_user = std::make_shared<Channel::User>(user, this);
 
-	m_users.set(channel_user.getNickname(), channel_user);
-	return m_users.get(channel_user.getNickname());
+	m_users.set(Key(channel_user->getNickname(), m_parent->getCaseMapping()), channel_user);
+	return channel_user.get();
 }
 
 Jupiter::IRC::Client::Channel::User *Jupiter::IRC::Client::Channel::addUser(Jupiter::IRC::Client::User *user, const char prefix)
 {
-	Channel::User channel_user;
-	channel_user.m_user = user;
-	channel_user.m_prefixes = prefix;
+	std::shared_ptr<Channel::User> channel_user = std::make_shared<Channel::User>(user, this);
+	size_t index = m_parent->m_prefixes.find(prefix);
+	if (index < 32)
+		channel_user->m_prefix_mask = uint32_t{ 1 } << index;
 
-	++user->m_channel_count;
-
-	m_users.set(channel_user.getNickname(), channel_user);
-	return m_users.get(channel_user.getNickname());
+	m_users.set(Key(channel_user->getNickname(), m_parent->getCaseMapping()), channel_user);
+	return channel_user.get();
 }
 
 void Jupiter::IRC::Client::Channel::delUser(const Jupiter::ReadableString &in_nickname)
 {
-	m_users.remove(in_nickname);
+	m_users.remove(Key(in_nickname, m_parent->getCaseMapping()));
 }
 
 void Jupiter::IRC::Client::Channel::addUserPrefix(const Jupiter::ReadableString &in_nickname, char prefix)
 {
-	Channel::User *user = m_users.get(in_nickname);
+	Channel::User *user = Channel::getUser(in_nickname);
+
+	size_t index = m_parent->m_prefixes.find(prefix);
 
-	if (user != nullptr && user->m_prefixes.contains(prefix) == false)
-		user->m_prefixes += prefix;
+	if (user != nullptr && index < 32)
+		user->m_prefix_mask |= uint32_t{ 1 } << index;
 }
 
 void Jupiter::IRC::Client::Channel::delUserPrefix(const Jupiter::ReadableString &in_nickname, char prefix)
 {
-	Channel::User *user = m_users.get(in_nickname);
+	Channel::User *user = Channel::getUser(in_nickname);
 
-	if (user != nullptr)
-		user->m_prefixes.remove(prefix);
+	size_t index = m_parent->m_prefixes.find(prefix);
+
+	if (user != nullptr && index < 32)
+		user->m_prefix_mask &= ~(uint32_t{ 1 } << index);
 }
 
 const Jupiter::ReadableString &Jupiter::IRC::Client::Channel::getName() const
@@ -1637,23 +2617,25 @@ const Jupiter::ReadableString &Jupiter::IRC::Client::Channel::getName() const
 
 Jupiter::IRC::Client::Channel::User *Jupiter::IRC::Client::Channel::getUser(const Jupiter::ReadableString &in_nickname) const
 {
-	return m_users.get(in_nickname);
+	std::shared_ptr<Channel::User> *user = m_users.get(Key(in_nickname, m_parent->getCaseMapping()));
+
+	if (user != nullptr)
+		return user->get();
+
+	return nullptr;
 }
 
 char Jupiter::IRC::Client::Channel::getUserPrefix(const Channel::User &in_user) const
 {
-	const Jupiter::ReadableString &prefixes = m_parent->getPrefixes();
-
-	for (size_t index = 0; index != prefixes.size(); ++index)
-		if (in_user.m_prefixes.contains(prefixes[index]))
-			return prefixes[index];
+	if (in_user.m_prefix_mask == 0)
+		return 0;
 
-	return 0;
+	return m_parent->m_prefixes[find_first_set(in_user.m_prefix_mask)];
 }
 
 char Jupiter::IRC::Client::Channel::getUserPrefix(const Jupiter::ReadableString &in_nickname) const
 {
-	Channel::User *user = m_users.get(in_nickname);
+	Channel::User *user = Channel::getUser(in_nickname);
 
 	if (user != nullptr)
 		return this->getUserPrefix(*user);
@@ -1681,14 +2663,26 @@ void Jupiter::IRC::Client::Channel::setType(int in_type)
 	m_type = in_type;
 }
 
+bool Jupiter::IRC::Client::Channel::isSynced() const
+{
+	return m_adding_names == false;
+}
+
 /**
 * Channel User Implementation
 */
 
+Jupiter::IRC::Client::Channel::User::User(Jupiter::IRC::Client::User *in_user, Jupiter::IRC::Client::Channel *in_channel)
+{
+	m_user = in_user;
+	m_channel = in_channel;
+	m_user->m_channels.push_back(m_channel);
+}
+
 Jupiter::IRC::Client::Channel::User::~User()
 {
-	if (m_user != nullptr)
-		--m_user->m_channel_count;
+	std::vector<Channel *> &channels = m_user->m_channels;
+	channels.erase(std::find(channels.begin(), channels.end(), m_channel));
 }
 
 Jupiter::IRC::Client::User *Jupiter::IRC::Client::Channel::User::getUser() const
@@ -1696,9 +2690,21 @@ Jupiter::IRC::Client::User *Jupiter::IRC::Client::Channel::User::getUser() const
 	return m_user;
 }
 
-const Jupiter::ReadableString &Jupiter::IRC::Client::Channel::User::getPrefixes() const
+Jupiter::StringS Jupiter::IRC::Client::Channel::User::getPrefixes() const
 {
-	return m_prefixes;
+	const Jupiter::ReadableString &prefixes = m_channel->m_parent->getPrefixes();
+	Jupiter::StringS result;
+
+	for (size_t index = 0; index != prefixes.size() && index != 32; ++index)
+		if (m_prefix_mask & (uint32_t{ 1 } << index))
+			result += prefixes[index];
+
+	return result;
+}
+
+uint32_t Jupiter::IRC::Client::Channel::User::getPrefixMask() const
+{
+	return m_prefix_mask;
 }
 
 const Jupiter::ReadableString &Jupiter::IRC::Client::Channel::User::getNickname() const
@@ -1719,4 +2725,9 @@ const Jupiter::ReadableString &Jupiter::IRC::Client::Channel::User::getHostname(
 size_t Jupiter::IRC::Client::Channel::User::getChannelCount() const
 {
 	return m_user->getChannelCount();
+}
+
+Jupiter::IRC::Client::Channel *Jupiter::IRC::Client::Channel::User::getChannel() const
+{
+	return m_channel;
 }
\ No newline at end of file
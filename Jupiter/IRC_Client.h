@@ -26,12 +26,26 @@
 
 #include <cstdlib>
 #include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
 #include "Jupiter.h"
 #include "Thinker.h"
 #include "IRC.h"
+#include "IRC_Message.h"
 #include "Reference_String.h"
 #include "Config.h"
-#include "Socket.h"
+#include "SecureSocket.h"
+#include "Resolver.h"
+#include "LogWriter.h"
+#include "WorkerPool.h"
+#include "Plugin.h"
 
 /** DLL Linkage Nagging */
 #if defined _MSC_VER
@@ -43,11 +57,14 @@ namespace Jupiter
 {
 	namespace IRC
 	{
+		class ClientManager;
+
 		/**
 		* @brief Provides connectivity to IRC servers.
 		*/
 		class JUPITER_API Client : public Jupiter::Thinker
 		{
+			friend class Jupiter::IRC::ClientManager;
 		protected:
 
 			/**
@@ -56,6 +73,13 @@ namespace Jupiter
 			*/
 			virtual void OnConnect();
 
+			/**
+			* @brief This is called once every channel auto-joined upon connecting has either finished joining
+			* (i.e: its names list has been received) or failed to join.
+			* If no channels are auto-joined, this is called immediately after OnConnect().
+			*/
+			virtual void OnAutoJoinSynced();
+
 			/**
 			* @brief This is called when at the end of disconnect().
 			* This is called upon any connection failure or error.
@@ -86,6 +110,13 @@ namespace Jupiter
 			*/
 			virtual void OnNumeric(long int in_numeric, const Jupiter::ReadableString &in_message);
 
+			/**
+			* @brief This is called after a message has been parsed and processed, before OnRaw.
+			*
+			* @param in_message The parsed message.
+			*/
+			virtual void OnMessage(const Jupiter::IRC::Message &in_message);
+
 			/**
 			* @brief This is called when an ERROR is received.
 			* This indicates a connection termination, and thus, disconnect() is called immediately after this.
@@ -203,6 +234,76 @@ namespace Jupiter
 		public:
 			class Channel;
 
+			/**
+			* @brief Priority lanes for outbound messages.
+			* When flood control holds messages back, higher priority lanes are always sent first.
+			*/
+			enum class SendPriority
+			{
+				PROTOCOL, /** Traffic which the connection depends upon (i.e: PONG); never dropped */
+				INTERACTIVE, /** Replies and other directly requested output */
+				BULK /** Broadcasts and other output which may be delayed or dropped first */
+			};
+
+			/**
+			* @brief Case mappings which a server may advertise through CASEMAPPING.
+			*/
+			enum class CaseMapping
+			{
+				ASCII, /** A-Z are equivalent to a-z */
+				RFC1459, /** ASCII, plus []\^ are equivalent to {}|~ */
+				STRICT_RFC1459 /** ASCII, plus []\ are equivalent to {}| */
+			};
+
+			/**
+			* @brief Table key for nicknames and channel names.
+			* The name is folded according to a case mapping and hashed once, upon construction.
+			*/
+			class JUPITER_API Key
+			{
+			public:
+				/**
+				* @brief Fetches the folded name.
+				*
+				* @return Folded name
+				*/
+				const std::string &getFolded() const;
+
+				/**
+				* @brief Fetches the hash of the folded name.
+				*
+				* @return Hash of the folded name
+				*/
+				size_t getHash() const;
+
+				/**
+				* @brief Compares two keys' folded names.
+				*
+				* @return True if the keys are equivalent, false otherwise.
+				*/
+				bool operator==(const Key &in_key) const;
+
+				/**
+				* @brief Hash function for tables keyed by Key.
+				*
+				* @param in_key Key to fetch the hash of
+				* @return Precomputed hash of the key
+				*/
+				static size_t hash(const Key &in_key);
+
+				/**
+				* @brief Folds a name according to a case mapping.
+				*
+				* @param in_name Nickname or channel name
+				* @param in_case_mapping Case mapping to fold the name with
+				*/
+				Key(const Jupiter::ReadableString &in_name, CaseMapping in_case_mapping);
+
+			private:
+				std::string m_folded;
+				size_t m_hash;
+			};
+
 			/**
 			* @brief Stores data about users.
 			*/
@@ -240,9 +341,16 @@ namespace Jupiter
 				*/
 				size_t getChannelCount() const;
 
+				/**
+				* @brief Fetches the channels the user shares with the local client.
+				*
+				* @return Channels the user is in.
+				*/
+				const std::vector<Jupiter::IRC::Client::Channel *> &getChannels() const;
+
 				/** Private members */
 			private:
-				unsigned int m_channel_count = 0;
+				std::vector<Jupiter::IRC::Client::Channel *> m_channels; // Maintained by Channel::User; one entry per membership
 				Jupiter::StringS m_nickname;
 				Jupiter::StringS m_username;
 				Jupiter::StringS m_hostname;
@@ -262,6 +370,7 @@ namespace Jupiter
 				class JUPITER_API User
 				{
 					friend class Jupiter::IRC::Client::Channel;
+					friend class Jupiter::IRC::Client;
 				public:
 
 					/**
@@ -274,9 +383,17 @@ namespace Jupiter
 					/**
 					* @brief Returns the user's string of channel prefixes.
 					*
-					* @return String containing the user's channel prefixes.
+					* @return String containing the user's channel prefixes, most significant first.
+					*/
+					Jupiter::StringS getPrefixes() const;
+
+					/**
+					* @brief Returns the user's channel prefixes as a bitmask.
+					* Bit N is set if the user has the Nth prefix advertised by the server (see Client::getPrefixes()).
+					*
+					* @return Bitmask of the user's channel prefixes.
 					*/
-					const Jupiter::ReadableString &getPrefixes() const;
+					uint32_t getPrefixMask() const;
 
 					/**
 					* @brief Fetches the user's nickname.
@@ -306,15 +423,35 @@ namespace Jupiter
 					*/
 					size_t getChannelCount() const;
 
+					/**
+					* @brief Returns the channel this membership belongs to.
+					*
+					* @return Channel the user is in.
+					*/
+					Jupiter::IRC::Client::Channel *getChannel() const;
+
+					/**
+					* @brief Constructor for the Channel::User class.
+					* This links the membership into the user's channel list; the destructor unlinks it.
+					*
+					* @param in_user User who is in the channel
+					* @param in_channel Channel the user is in
+					*/
+					User(Jupiter::IRC::Client::User *in_user, Jupiter::IRC::Client::Channel *in_channel);
+
+					User(const User &) = delete;
+					User &operator=(const User &) = delete;
 					~User();
 
 				/** Private members */
 				private:
-					Jupiter::IRC::Client::User *m_user = nullptr;
-					Jupiter::StringS m_prefixes;
+					Jupiter::IRC::Client::User *m_user;
+					Jupiter::IRC::Client::Channel *m_channel;
+					uint32_t m_prefix_mask = 0;
 				};
 
-				typedef Jupiter::Hash_Table<Jupiter::StringS, Channel::User, Jupiter::ReadableString> UserTableType;
+				/** Entries are shared so that they keep their address when the table grows */
+				typedef Jupiter::Hash_Table<Client::Key, std::shared_ptr<Channel::User>, Client::Key, std::shared_ptr<Channel::User>, &Client::Key::hash> UserTableType;
 
 				/**
 				* @brief Returns the name of the channel.
@@ -408,6 +545,13 @@ namespace Jupiter
 				*/
 				void setType(int iType);
 
+				/**
+				* @brief Checks if the channel's user list has been fully received since joining.
+				*
+				* @return True if the channel's names list is complete, false otherwise.
+				*/
+				bool isSynced() const;
+
 				Channel() = default;
 
 				/**
@@ -425,11 +569,12 @@ namespace Jupiter
 				int m_type;
 				UserTableType m_users;
 
-				bool m_adding_names;
+				bool m_adding_names = false;
 			}; // Jupiter::IRC::Client::Channel class
 
-			typedef Jupiter::Hash_Table<Jupiter::StringS, Client::Channel, Jupiter::ReadableString> ChannelTableType;
-			typedef Jupiter::Hash_Table<Jupiter::StringS, Client::User, Jupiter::ReadableString> UserTableType;
+			/** Entries are shared so that memberships can refer to them when the tables grow */
+			typedef Jupiter::Hash_Table<Client::Key, std::shared_ptr<Client::Channel>, Client::Key, std::shared_ptr<Client::Channel>, &Client::Key::hash> ChannelTableType;
+			typedef Jupiter::Hash_Table<Client::Key, std::shared_ptr<Client::User>, Client::Key, std::shared_ptr<Client::User>, &Client::Key::hash> UserTableType;
 
 			/**
 			* @brief Returns the name of the primary config section this client reads from.
@@ -489,6 +634,14 @@ namespace Jupiter
 			*/
 			const Jupiter::ReadableString &getPrefixModes() const;
 
+			/**
+			* @brief Returns the case mapping advertised by the connected server.
+			* Nicknames and channel names are compared according to this mapping.
+			*
+			* @return Case mapping in use (RFC1459 until the server advertises otherwise).
+			*/
+			CaseMapping getCaseMapping() const;
+
 			/**
 			* @brief Returns the client's current nickname.
 			*
@@ -636,6 +789,29 @@ namespace Jupiter
 			*/
 			void joinChannel(const Jupiter::ReadableString &in_channel, const Jupiter::ReadableString &in_password);
 
+			/**
+			* @brief Sends join requests for multiple channels.
+			* Channels are combined into as few JOIN lines as the line length and the server's TARGMAX allow.
+			*
+			* @param in_channels Channels to join.
+			* @param in_keys Keys for the channels, by index; channels with keys should be ordered before those without.
+			*/
+			void joinChannels(const std::vector<const Jupiter::ReadableString *> &in_channels, const std::vector<const Jupiter::ReadableString *> &in_keys = {});
+
+			/**
+			* @brief Checks if every channel auto-joined upon connecting has finished joining or failed to join.
+			*
+			* @return True if no auto-joins are pending, false otherwise.
+			*/
+			bool isAutoJoinSynced() const;
+
+			/**
+			* @brief Fetches the number of auto-joined channels which have not yet finished joining.
+			*
+			* @return Number of pending auto-joins.
+			*/
+			size_t getPendingAutoJoinCount() const;
+
 			/**
 			* @brief Parts a channel.
 			*
@@ -663,6 +839,7 @@ namespace Jupiter
 
 			/**
 			* @brief Sends a message.
+			* This may be called from offloaded plugin hooks; see Plugin::setOffloaded().
 			*
 			* @param dest String containing the destination of the message (nickname or channel).
 			* @param message String containing the message to send.
@@ -671,18 +848,29 @@ namespace Jupiter
 
 			/**
 			* @brief Sends a notice.
+			* This may be called from offloaded plugin hooks; see Plugin::setOffloaded().
 			*
 			* @param dest String containing the destination of the message (nickname or channel).
 			* @param message String containing the message to send.
 			*/
 			void sendNotice(const Jupiter::ReadableString &in_destination, const Jupiter::ReadableString &in_message);
 
+			/**
+			* @brief Sends a message to multiple destinations.
+			* Destinations are combined into as few lines as the server's TARGMAX (or MAXTARGETS) allows.
+			*
+			* @param in_targets Destinations of the message (nicknames or channels).
+			* @param in_message String containing the message to send.
+			* @param in_priority Lane to queue the lines in, if flood control holds them back.
+			*/
+			void sendMessage(const std::vector<const Jupiter::ReadableString *> &in_targets, const Jupiter::ReadableString &in_message, SendPriority in_priority = SendPriority::INTERACTIVE);
+
 			/**
 			* @brief Sends a message to all channels of a given type.
 			*
 			* @param type Type of channel to messasge.
 			* @param message String containing the message to send.
-			* @return Number of messages sent.
+			* @return Number of channels messaged.
 			*/
 			size_t messageChannels(int type, const Jupiter::ReadableString &in_message);
 
@@ -690,7 +878,7 @@ namespace Jupiter
 			* @brief Sends a message to all channels with a type of at least 0.
 			*
 			* @param message String containing the message to send.
-			* @return Number of messages sent.
+			* @return Number of channels messaged.
 			*/
 			size_t messageChannels(const Jupiter::ReadableString &in_message);
 
@@ -711,10 +899,41 @@ namespace Jupiter
 			/**
 			* @brief Sends data to the server.
 			* Endlines are automatically added.
+			* This may be called from offloaded plugin hooks; see Plugin::setOffloaded().
 			*
 			* @param rawMessage String containing the data to send.
+			* @param in_priority Lane to queue the message in, if flood control holds it back.
+			*/
+			void send(const Jupiter::ReadableString &in_message, SendPriority in_priority = SendPriority::INTERACTIVE);
+
+			/**
+			* @brief Fetches the number of messages held back by flood control.
+			*
+			* @return Number of messages waiting to be sent.
+			*/
+			size_t getOutboundQueueSize() const;
+
+			/**
+			* @brief Fetches the number of messages held back by flood control in a single lane.
+			*
+			* @param in_priority Lane to fetch the size of
+			* @return Number of messages waiting to be sent in the lane.
 			*/
-			void send(const Jupiter::ReadableString &in_message);
+			size_t getOutboundQueueSize(SendPriority in_priority) const;
+
+			/**
+			* @brief Fetches the number of messages which were dropped because the outbound queue was full.
+			*
+			* @return Number of messages dropped since the client was created.
+			*/
+			size_t getOutboundDropCount() const;
+
+			/**
+			* @brief Fetches how long the oldest message held back by flood control has been waiting.
+			*
+			* @return Age of the oldest queued message, or 0 if no messages are queued.
+			*/
+			std::chrono::milliseconds getSendLag() const;
 
 			/**
 			* @brief Processes an input line of IRC protocol data.
@@ -723,6 +942,43 @@ namespace Jupiter
 			*/
 			int process_line(const Jupiter::ReadableString &in_line);
 
+			/** Function called to handle a command or numeric received from the server */
+			typedef std::function<void(Jupiter::IRC::Client &, const Jupiter::IRC::Message &)> CommandHandler;
+
+			/**
+			* @brief Sets the handler for a command, replacing any existing handler (including built-in handlers).
+			* Handlers are only called for post-registration messages, and for messages without a prefix.
+			*
+			* @param in_command Command to handle (i.e: PRIVMSG); this is matched case-insensitively.
+			* @param in_handler Handler to call when the command is received; an empty handler removes the existing handler.
+			*/
+			void setCommandHandler(const Jupiter::ReadableString &in_command, CommandHandler in_handler);
+
+			/**
+			* @brief Sets the handler for a numeric, replacing any existing handler (including built-in handlers).
+			*
+			* @param in_numeric Numeric to handle (1-999)
+			* @param in_handler Handler to call when the numeric is received; an empty handler removes the existing handler.
+			*/
+			void setNumericHandler(int in_numeric, CommandHandler in_handler);
+
+			/**
+			* @brief Fetches the handler for a command.
+			* This can be used to chain to a built-in handler when replacing it.
+			*
+			* @param in_command Command to fetch the handler of
+			* @return Handler for the command if one is set, an empty handler otherwise.
+			*/
+			CommandHandler getCommandHandler(const Jupiter::ReadableString &in_command) const;
+
+			/**
+			* @brief Fetches the handler for a numeric.
+			*
+			* @param in_numeric Numeric to fetch the handler of
+			* @return Handler for the numeric if one is set, an empty handler otherwise.
+			*/
+			CommandHandler getNumericHandler(int in_numeric) const;
+
 			/**
 			* @brief Returns a key's value.
 			* This reads from the client's config section first, then default if it doesn't exist.
@@ -771,6 +1027,7 @@ namespace Jupiter
 
 			/**
 			* @brief Writes to the server's log file.
+			* The line is written asynchronously by the default LogWriter.
 			*
 			* @param message String containing the text to write to the file.
 			*/
@@ -801,6 +1058,8 @@ namespace Jupiter
 			/**
 			* @brief Calls disconnect() if the client has not already, then calls connect().
 			* Note: This will increment the current reconnect attempts by 1.
+			* The server's hostname is resolved, and the connection established, without blocking; until the connection
+			* completes, this only starts (or checks on) the resolution or connection, and think() calls this again.
 			*/
 			void reconnect();
 
@@ -828,12 +1087,14 @@ namespace Jupiter
 		/** Private members */
 		private:
 			Jupiter::Socket *m_socket;
+			std::shared_ptr<Jupiter::Resolver::Result> m_server_address; // set while the server's hostname is being resolved
 			uint16_t m_server_port;
 			Jupiter::CStringS m_server_hostname;
 
 			bool m_ssl;
 			Jupiter::StringS m_ssl_certificate;
 			Jupiter::StringS m_ssl_key;
+			std::shared_ptr<Jupiter::SecureSocket::Context> m_ssl_context;
 
 			Jupiter::StringS m_sasl_account;
 			Jupiter::StringS m_sasl_password;
@@ -843,7 +1104,6 @@ namespace Jupiter
 			Jupiter::Config *m_primary_section;
 			Jupiter::Config *m_secondary_section;
 			Jupiter::CStringS m_log_file_name;
-			Jupiter::StringS m_last_line;
 			Jupiter::StringS m_server_name;
 			Jupiter::StringS m_nickname;
 			Jupiter::StringS m_realname;
@@ -855,6 +1115,10 @@ namespace Jupiter
 			Jupiter::StringS m_modeB = "k";
 			Jupiter::StringS m_modeC = "l";
 			Jupiter::StringS m_modeD = "psitnm";
+			CaseMapping m_case_mapping = CaseMapping::RFC1459;
+			size_t m_max_privmsg_targets = 1;
+			size_t m_max_join_targets = SIZE_MAX;
+			bool m_targmax_received = false;
 
 			UserTableType m_users;
 			ChannelTableType m_channels;
@@ -865,19 +1129,93 @@ namespace Jupiter
 			time_t m_reconnect_time;
 			int m_max_reconnect_attempts;
 			int m_reconnect_attempts;
-			FILE *m_output;
-			FILE *m_log_file;
+			std::shared_ptr<Jupiter::LogWriter::Output> m_output;
+			std::shared_ptr<Jupiter::LogWriter::Output> m_log_output;
 			int m_default_chan_type;
 			bool m_dead = false;
 
+			Jupiter::Hash_Table<Client::Key, bool, Client::Key, bool, &Client::Key::hash> m_pending_auto_joins;
+
+			Jupiter::Hash_Table<Jupiter::StringS, CommandHandler, Jupiter::ReadableString> m_command_handlers; // keyed by upper-case command
+			std::vector<CommandHandler> m_numeric_handlers; // indexed by numeric
+
+			/** Outbound message held back by flood control */
+			struct OutboundMessage
+			{
+				Jupiter::StringS m_data; // includes line ending
+				std::chrono::steady_clock::time_point m_queue_time;
+			};
+
+			std::deque<OutboundMessage> m_outbound_queues[3]; // indexed by SendPriority
+			size_t m_outbound_queue_size = 0;
+			size_t m_outbound_drop_count = 0;
+			size_t m_max_outbound_queue_size; // 0 for unlimited
+			size_t m_flood_lines; // lines per window; 0 for unlimited
+			size_t m_flood_bytes; // bytes per window; 0 for unlimited
+			std::chrono::milliseconds m_flood_window; // 0 to disable flood control
+			double m_flood_line_tokens;
+			double m_flood_byte_tokens;
+			std::chrono::steady_clock::time_point m_flood_refill_time;
+
+			typedef Jupiter::Hash_Table<Client::Key, std::shared_ptr<Jupiter::WorkerPool::Strand>, Client::Key, std::shared_ptr<Jupiter::WorkerPool::Strand>, &Client::Key::hash> StrandTableType;
+
+			std::atomic<std::thread::id> m_network_thread; // thread which processes lines and owns the socket; read by offloaded hooks
+			std::unique_ptr<Jupiter::WorkerPool::Strand> m_strand; // offloaded events outside of a channel
+			StrandTableType m_channel_strands; // offloaded events for each channel
+			std::atomic<size_t> m_offloaded_tasks{ 0 };
+			std::mutex m_marshalled_mutex;
+			std::vector<std::pair<Jupiter::StringS, SendPriority>> m_marshalled_sends; // sent from other threads
+			std::atomic<size_t> m_marshalled_count{ 0 };
+
+			bool startConnect();
+			bool finishConnect();
+			void setupSecureSocket(Jupiter::SecureSocket &in_socket);
 			void delChannel(const Jupiter::ReadableString &in_channel);
+			void setCaseMapping(CaseMapping in_case_mapping); // re-keys every table
+			void remapPrefixMasks(const Jupiter::ReadableString &in_old_prefixes); // after PREFIX changes
 			void addNamesToChannel(Channel &in_channel, Jupiter::ReadableString &in_names);
 			void addChannel(const Jupiter::ReadableString &in_channel);
+			void autoJoinChannels();
+			void completeAutoJoin(const Jupiter::ReadableString &in_channel);
+
+			bool isFloodControlled() const;
+			void resetFloodTokens();
+			void refillFloodTokens();
+			bool takeFloodTokens(size_t in_size);
+			void scheduleSend(Jupiter::StringS &&in_data, SendPriority in_priority);
+			size_t flushOutbound();
+			void drainMarshalledSends();
+			bool isNetworkThread() const;
+
+			Jupiter::WorkerPool::Strand &getStrand(const Jupiter::ReadableString &in_channel);
+			void offload(const Jupiter::ReadableString &in_channel, Jupiter::Plugin *in_plugin, std::function<void()> in_task);
+			template<typename... HookArgsT, typename... ArgsT> void callPlugins(const std::vector<Jupiter::Plugin *> &in_subscribers, Jupiter::Plugin::Event in_event, const Jupiter::ReadableString &in_channel, void (Jupiter::Plugin::*in_hook)(Jupiter::IRC::Client *, HookArgsT...), const ArgsT &... in_args);
+			template<typename... HookArgsT, typename... ArgsT> void callPlugins(Jupiter::Plugin::Event in_event, const Jupiter::ReadableString &in_channel, void (Jupiter::Plugin::*in_hook)(Jupiter::IRC::Client *, HookArgsT...), const ArgsT &... in_args);
+			std::chrono::milliseconds getOutboundDelay();
+
+			bool dispatch(const Jupiter::IRC::Message &in_message);
+			void handlePRIVMSG(const Jupiter::IRC::Message &in_message);
+			void handleNOTICE(const Jupiter::IRC::Message &in_message);
+			void handleNICK(const Jupiter::IRC::Message &in_message);
+			void handleJOIN(const Jupiter::IRC::Message &in_message);
+			void handlePART(const Jupiter::IRC::Message &in_message);
+			void handleKICK(const Jupiter::IRC::Message &in_message);
+			void handleQUIT(const Jupiter::IRC::Message &in_message);
+			void handleINVITE(const Jupiter::IRC::Message &in_message);
+			void handleMODE(const Jupiter::IRC::Message &in_message);
+			void handlePING(const Jupiter::IRC::Message &in_message);
+			void handleERROR(const Jupiter::IRC::Message &in_message);
+			void handleAUTHENTICATE(const Jupiter::IRC::Message &in_message);
+			void handleNAMREPLY(const Jupiter::IRC::Message &in_message);
+			void handleENDOFNAMES(const Jupiter::IRC::Message &in_message);
+			void handleJoinError(const Jupiter::IRC::Message &in_message);
 
 			bool startCAP();
 			bool registerClient();
 			Jupiter::IRC::Client::User *findUser(const Jupiter::ReadableString &in_nickname) const;
 			Jupiter::IRC::Client::User *findUserOrAdd(const Jupiter::ReadableString &in_nickname);
+			Jupiter::IRC::Client::User *renameUser(const Jupiter::ReadableString &in_nickname, const Jupiter::ReadableString &in_new_nickname);
+			void delUser(const Jupiter::ReadableString &in_nickname);
 		}; // Jupiter::IRC::Client class
 
 	} // Jupiter::IRC namespace
@@ -0,0 +1,439 @@
+/**
+ * Copyright (C) 2017 Jessica James.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Written by Jessica James <jessica.aj@outlook.com>
+ */
+
+#include <algorithm>
+#include <ctime>
+#if defined __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif // __linux__
+#include "IRC_ClientManager.h"
+#include "IOUring.h"
+#include "ArrayList.h"
+
+namespace
+{
+	struct ClientEntry
+	{
+		Jupiter::IRC::Client *client;
+		Jupiter::Socket::SocketType descriptor; // descriptor registered for polling; only valid when 'registered' is set
+		int reconnect_attempts; // used to detect a reconnect which re-used the same descriptor
+		bool registered = false;
+		bool uring_attached = false; // socket is attached to the ring (rather than just watched)
+		bool want_write = false; // polling for writability, to flush the socket's send queue
+	};
+}
+
+struct Jupiter::IRC::ClientManager::Data
+{
+	Jupiter::ArrayList<ClientEntry> entries;
+	Jupiter::ArrayList<ClientEntry> released; // entries removed during think(); freed once no event can refer to them
+	std::chrono::milliseconds max_wait;
+	Jupiter::IOUring *uring = nullptr;
+	static constexpr std::chrono::milliseconds pending_interval{ 10 };
+#if defined __linux__
+	static constexpr int max_events = 64;
+	int epoll_fd;
+	epoll_event events[max_events];
+#endif // __linux__
+
+	void unregister(ClientEntry *entry);
+	void flushOutbound();
+	std::chrono::milliseconds sync();
+	void dispatch(ClientEntry *entry);
+	void release(ClientEntry *entry);
+	ClientEntry *find(Jupiter::IRC::Client *client) const;
+};
+
+constexpr std::chrono::milliseconds Jupiter::IRC::ClientManager::Data::pending_interval;
+
+void Jupiter::IRC::ClientManager::Data::unregister(ClientEntry *entry)
+{
+	if (entry->registered)
+	{
+		if (Jupiter::IRC::ClientManager::Data::uring != nullptr)
+		{
+			// Attached sockets detach themselves when closed
+			if (entry->uring_attached == false)
+				Jupiter::IRC::ClientManager::Data::uring->detach(entry->descriptor);
+			else if (entry->client != nullptr && entry->client->m_socket->getIOUring() == Jupiter::IRC::ClientManager::Data::uring)
+				entry->client->m_socket->setIOUring(nullptr);
+		}
+#if defined __linux__
+		else // The descriptor may already be closed (and thus implicitly removed); that's fine.
+			epoll_ctl(Jupiter::IRC::ClientManager::Data::epoll_fd, EPOLL_CTL_DEL, entry->descriptor, nullptr);
+#endif // __linux__
+		entry->registered = false;
+	}
+}
+
+/**
+* Releases messages held back by flood control for polled clients, since those are only thought
+* when data arrives. Unregistered clients release their own messages in think().
+*/
+void Jupiter::IRC::ClientManager::Data::flushOutbound()
+{
+	ClientEntry *entry;
+	for (size_t index = 0; index != Jupiter::IRC::ClientManager::Data::entries.size(); ++index)
+	{
+		entry = Jupiter::IRC::ClientManager::Data::entries.get(index);
+		if (entry->registered && entry->client->m_connection_status != 0 && (entry->client->m_outbound_queue_size != 0 || entry->client->m_marshalled_count != 0))
+			entry->client->flushOutbound();
+	}
+}
+
+/**
+* Brings epoll registrations up to date with each client's socket, and determines how long
+* think() may wait before a disconnected client's reconnect is due.
+*
+* All stale registrations are removed before any new ones are added, since a descriptor
+* closed by one client may have already been re-used by another.
+*/
+std::chrono::milliseconds Jupiter::IRC::ClientManager::Data::sync()
+{
+	std::chrono::milliseconds wait = Jupiter::IRC::ClientManager::Data::max_wait;
+	time_t now = time(0);
+	ClientEntry *entry;
+	Jupiter::IRC::Client *client;
+	size_t index;
+
+	// Remove stale registrations
+	for (index = 0; index != Jupiter::IRC::ClientManager::Data::entries.size(); ++index)
+	{
+		entry = Jupiter::IRC::ClientManager::Data::entries.get(index);
+		client = entry->client;
+		if (entry->registered && (client->m_connection_status == 0
+			|| entry->descriptor != client->m_socket->getDescriptor()
+			|| entry->reconnect_attempts != client->m_reconnect_attempts))
+			Jupiter::IRC::ClientManager::Data::unregister(entry);
+	}
+
+	// Add new registrations, and find the nearest reconnect
+	for (index = 0; index != Jupiter::IRC::ClientManager::Data::entries.size(); ++index)
+	{
+		entry = Jupiter::IRC::ClientManager::Data::entries.get(index);
+		client = entry->client;
+		entry->reconnect_attempts = client->m_reconnect_attempts;
+
+		if (client->m_connection_status == 0)
+		{
+			if (client->m_dead == false && ((client->m_server_address != nullptr && client->m_server_address->isReady() == false) || client->m_socket->isConnecting()))
+			{
+				// Resolving the server's address or connecting to it; check back shortly
+				if (Data::pending_interval < wait)
+					wait = Data::pending_interval;
+			}
+			else if (client->m_dead
+				|| client->m_reconnect_delay == 0
+				|| client->m_reconnect_time < now
+				|| (client->m_max_reconnect_attempts >= 0 && client->m_reconnect_attempts >= client->m_max_reconnect_attempts))
+				wait = std::chrono::milliseconds(0);
+			else if (std::chrono::seconds(client->m_reconnect_time + 1 - now) < wait)
+				wait = std::chrono::seconds(client->m_reconnect_time + 1 - now);
+		}
+		else if (entry->registered == false)
+		{
+			entry->descriptor = client->m_socket->getDescriptor();
+			if (Jupiter::IRC::ClientManager::Data::uring != nullptr)
+			{
+				// SecureSockets can't be attached; poll them through the ring instead
+				entry->uring_attached = client->m_socket->setIOUring(Jupiter::IRC::ClientManager::Data::uring);
+				entry->registered = entry->uring_attached || Jupiter::IRC::ClientManager::Data::uring->watch(entry->descriptor);
+			}
+#if defined __linux__
+			else if (Jupiter::IRC::ClientManager::Data::epoll_fd != -1)
+			{
+				epoll_event event;
+				event.events = EPOLLIN;
+				event.data.ptr = entry;
+				entry->want_write = false;
+				entry->registered = epoll_ctl(Jupiter::IRC::ClientManager::Data::epoll_fd, EPOLL_CTL_ADD, entry->descriptor, &event) == 0;
+			}
+#endif // __linux__
+
+			// Unregistered clients must be polled by calling think()
+			if (entry->registered == false)
+				wait = std::chrono::milliseconds(0);
+		}
+
+		if (entry->registered && entry->uring_attached == false && client->m_connection_status != 0)
+		{
+			// Check back once flood control will allow the next held back message to be sent
+			if (client->m_outbound_queue_size != 0)
+				wait = std::min(wait, client->getOutboundDelay());
+
+			// Offloaded plugin hooks may hand replies back at any moment
+			if ((client->m_offloaded_tasks != 0 || client->m_marshalled_count != 0) && Data::pending_interval < wait)
+				wait = Data::pending_interval;
+
+			bool want_write = client->m_socket->getQueuedSize() != 0;
+			if (Jupiter::IRC::ClientManager::Data::uring != nullptr)
+			{
+				// Watches only report readability; check back shortly to flush
+				if (want_write && Data::pending_interval < wait)
+					wait = Data::pending_interval;
+			}
+#if defined __linux__
+			else if (want_write != entry->want_write)
+			{
+				epoll_event event;
+				event.events = want_write ? EPOLLIN | EPOLLOUT : EPOLLIN;
+				event.data.ptr = entry;
+				if (epoll_ctl(Jupiter::IRC::ClientManager::Data::epoll_fd, EPOLL_CTL_MOD, entry->descriptor, &event) == 0)
+					entry->want_write = want_write;
+			}
+#endif // __linux__
+		}
+	}
+
+	return wait;
+}
+
+void Jupiter::IRC::ClientManager::Data::dispatch(ClientEntry *entry)
+{
+	if (entry->client == nullptr) // removed earlier in this think()
+		return;
+
+	do
+	{
+		if (entry->client->think() != 0)
+		{
+			Jupiter::IRC::Client *client = entry->client;
+			Jupiter::IRC::ClientManager::Data::release(entry);
+			delete client;
+			return;
+		}
+	}
+	// Data which has already been read from the descriptor (i.e: by SSL) will not be reported by epoll
+	while (entry->client != nullptr && entry->client->m_connection_status != 0 && entry->client->m_socket->hasPendingData());
+}
+
+void Jupiter::IRC::ClientManager::Data::release(ClientEntry *entry)
+{
+	size_t index = Jupiter::IRC::ClientManager::Data::entries.size();
+	while (index != 0)
+	{
+		if (Jupiter::IRC::ClientManager::Data::entries.get(--index) == entry)
+		{
+			Jupiter::IRC::ClientManager::Data::entries.remove(index);
+			break;
+		}
+	}
+
+	Jupiter::IRC::ClientManager::Data::unregister(entry);
+	entry->client = nullptr;
+	Jupiter::IRC::ClientManager::Data::released.add(entry);
+}
+
+ClientEntry *Jupiter::IRC::ClientManager::Data::find(Jupiter::IRC::Client *client) const
+{
+	ClientEntry *entry;
+	size_t index = Jupiter::IRC::ClientManager::Data::entries.size();
+	while (index != 0)
+	{
+		entry = Jupiter::IRC::ClientManager::Data::entries.get(--index);
+		if (entry->client == client)
+			return entry;
+	}
+
+	return nullptr;
+}
+
+/** ClientManager */
+
+int Jupiter::IRC::ClientManager::think()
+{
+	Jupiter::IRC::ClientManager::data_->flushOutbound();
+	std::chrono::milliseconds wait = Jupiter::IRC::ClientManager::data_->sync();
+	ClientEntry *entry;
+	size_t index;
+
+	if (Jupiter::IRC::ClientManager::data_->uring != nullptr)
+	{
+		// Submits everything queued since the last iteration (i.e: sends), and collects completions
+		Jupiter::IRC::ClientManager::data_->uring->submit(wait);
+
+		index = Jupiter::IRC::ClientManager::data_->entries.size();
+		while (index != 0)
+		{
+			if (--index >= Jupiter::IRC::ClientManager::data_->entries.size()) // entries were removed by a previous client
+				continue;
+
+			entry = Jupiter::IRC::ClientManager::data_->entries.get(index);
+			if (entry->registered == false)
+				Jupiter::IRC::ClientManager::data_->dispatch(entry);
+			else if (entry->uring_attached)
+			{
+				if (entry->client->m_socket->hasPendingData())
+					Jupiter::IRC::ClientManager::data_->dispatch(entry);
+			}
+			else if (Jupiter::IRC::ClientManager::data_->uring->isReadable(entry->descriptor))
+			{
+				Jupiter::IRC::ClientManager::data_->dispatch(entry);
+
+				// Re-arm the watch if the client is still on the same connection
+				if (entry->client != nullptr && entry->client->m_connection_status != 0 && entry->client->m_socket->getDescriptor() == entry->descriptor)
+					Jupiter::IRC::ClientManager::data_->uring->watch(entry->descriptor);
+			}
+		}
+
+		Jupiter::IRC::ClientManager::data_->released.emptyAndDelete();
+		return 0;
+	}
+
+#if defined __linux__
+	if (Jupiter::IRC::ClientManager::data_->epoll_fd != -1)
+	{
+		int count = epoll_wait(Jupiter::IRC::ClientManager::data_->epoll_fd, Jupiter::IRC::ClientManager::data_->events, Data::max_events, static_cast<int>(wait.count()));
+
+		// Start decrypting every readable offloaded connection before thinking any of them, so that they decrypt in parallel
+		for (int index = 0; index < count; ++index)
+		{
+			entry = static_cast<ClientEntry *>(Jupiter::IRC::ClientManager::data_->events[index].data.ptr);
+			if ((Jupiter::IRC::ClientManager::data_->events[index].events & EPOLLIN) != 0 && entry->client != nullptr && entry->client->m_ssl && entry->client->m_connection_status != 0)
+				static_cast<Jupiter::SecureSocket *>(entry->client->m_socket)->prefetch();
+		}
+
+		for (int index = 0; index < count; ++index)
+		{
+			entry = static_cast<ClientEntry *>(Jupiter::IRC::ClientManager::data_->events[index].data.ptr);
+
+			// Only writable; flush without thinking, since think() would block on recv()
+			if (Jupiter::IRC::ClientManager::data_->events[index].events == EPOLLOUT)
+			{
+				if (entry->client != nullptr && entry->client->m_connection_status != 0)
+					entry->client->m_socket->flush();
+			}
+			else
+				Jupiter::IRC::ClientManager::data_->dispatch(entry);
+		}
+	}
+#endif // __linux__
+
+	// Think disconnected clients (to handle reconnects), and any clients which aren't being polled
+	index = Jupiter::IRC::ClientManager::data_->entries.size();
+	while (index != 0)
+	{
+		if (--index >= Jupiter::IRC::ClientManager::data_->entries.size()) // entries were removed by a previous client
+			continue;
+
+		entry = Jupiter::IRC::ClientManager::data_->entries.get(index);
+		if (entry->registered == false)
+			Jupiter::IRC::ClientManager::data_->dispatch(entry);
+	}
+
+	Jupiter::IRC::ClientManager::data_->released.emptyAndDelete();
+	return 0;
+}
+
+void Jupiter::IRC::ClientManager::add(Jupiter::IRC::Client *in_client)
+{
+	ClientEntry *entry = new ClientEntry();
+	entry->client = in_client;
+	entry->reconnect_attempts = in_client->m_reconnect_attempts;
+	Jupiter::IRC::ClientManager::data_->entries.add(entry);
+}
+
+bool Jupiter::IRC::ClientManager::remove(Jupiter::IRC::Client *in_client)
+{
+	ClientEntry *entry = Jupiter::IRC::ClientManager::data_->find(in_client);
+	if (entry == nullptr)
+		return false;
+
+	Jupiter::IRC::ClientManager::data_->release(entry);
+	return true;
+}
+
+size_t Jupiter::IRC::ClientManager::size() const
+{
+	return Jupiter::IRC::ClientManager::data_->entries.size();
+}
+
+Jupiter::IRC::Client *Jupiter::IRC::ClientManager::get(size_t index) const
+{
+	if (index < Jupiter::IRC::ClientManager::data_->entries.size())
+		return Jupiter::IRC::ClientManager::data_->entries.get(index)->client;
+
+	return nullptr;
+}
+
+void Jupiter::IRC::ClientManager::setMaxWait(std::chrono::milliseconds in_max_wait)
+{
+	Jupiter::IRC::ClientManager::data_->max_wait = in_max_wait;
+}
+
+std::chrono::milliseconds Jupiter::IRC::ClientManager::getMaxWait() const
+{
+	return Jupiter::IRC::ClientManager::data_->max_wait;
+}
+
+bool Jupiter::IRC::ClientManager::enableIOUring(unsigned int in_entries)
+{
+	if (Jupiter::IRC::ClientManager::data_->uring != nullptr)
+		return true;
+
+	Jupiter::IOUring *uring = new Jupiter::IOUring(in_entries);
+	if (uring->isValid() == false)
+	{
+		delete uring;
+		return false;
+	}
+
+	// Drop epoll registrations; clients are registered with the ring on the next think()
+	size_t index = Jupiter::IRC::ClientManager::data_->entries.size();
+	while (index != 0)
+		Jupiter::IRC::ClientManager::data_->unregister(Jupiter::IRC::ClientManager::data_->entries.get(--index));
+
+	Jupiter::IRC::ClientManager::data_->uring = uring;
+	return true;
+}
+
+bool Jupiter::IRC::ClientManager::isIOUringEnabled() const
+{
+	return Jupiter::IRC::ClientManager::data_->uring != nullptr;
+}
+
+Jupiter::IRC::ClientManager::ClientManager(std::chrono::milliseconds in_max_wait)
+{
+	Jupiter::IRC::ClientManager::data_ = new Data();
+	Jupiter::IRC::ClientManager::data_->max_wait = in_max_wait;
+
+#if defined __linux__
+	Jupiter::IRC::ClientManager::data_->epoll_fd = epoll_create1(EPOLL_CLOEXEC); // on failure, clients are polled by think() instead
+#endif // __linux__
+}
+
+Jupiter::IRC::ClientManager::~ClientManager()
+{
+	ClientEntry *entry;
+	while (Jupiter::IRC::ClientManager::data_->entries.size() != 0)
+	{
+		entry = Jupiter::IRC::ClientManager::data_->entries.pop();
+		delete entry->client;
+		delete entry;
+	}
+	Jupiter::IRC::ClientManager::data_->released.emptyAndDelete();
+	delete Jupiter::IRC::ClientManager::data_->uring; // clients' sockets were detached when closed
+
+#if defined __linux__
+	if (Jupiter::IRC::ClientManager::data_->epoll_fd != -1)
+		::close(Jupiter::IRC::ClientManager::data_->epoll_fd);
+#endif // __linux__
+
+	delete Jupiter::IRC::ClientManager::data_;
+}
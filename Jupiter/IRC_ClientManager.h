@@ -0,0 +1,140 @@
+/**
+ * Copyright (C) 2017 Jessica James.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Written by Jessica James <jessica.aj@outlook.com>
+ */
+
+#if !defined _IRC_CLIENTMANAGER_H_HEADER
+#define _IRC_CLIENTMANAGER_H_HEADER
+
+/**
+ * @file IRC_ClientManager.h
+ * @brief Provides a readiness-based event loop for many IRC clients.
+ */
+
+#include <chrono>
+#include "Jupiter.h"
+#include "Thinker.h"
+#include "IRC_Client.h"
+
+namespace Jupiter
+{
+	namespace IRC
+	{
+		/**
+		* @brief Drives a set of IRC clients from a single thread, only calling into a client when its socket is readable or its reconnect is due.
+		* On Linux, client sockets are polled with epoll, or driven by an io_uring backend if enableIOUring() succeeds.
+		* On other platforms, every client is thought each iteration.
+		*/
+		class JUPITER_API ClientManager : public Jupiter::Thinker
+		{
+		public:
+			/**
+			* @brief Waits (up to the maximum wait time) for any client to become ready, and calls think() for each client which is.
+			* Clients whose think() returns a non-zero value are removed and deleted.
+			*
+			* @return 0.
+			*/
+			virtual int think() override;
+
+			/**
+			* @brief Adds a client to the manager; the manager takes ownership of the client.
+			*
+			* @param in_client Client to add
+			*/
+			void add(Jupiter::IRC::Client *in_client);
+
+			/**
+			* @brief Removes a client from the manager, without deleting it.
+			* Note: You MUST delete the client later yourself after calling this.
+			*
+			* @param in_client Client to remove
+			* @return True if the client was removed, false otherwise.
+			*/
+			bool remove(Jupiter::IRC::Client *in_client);
+
+			/**
+			* @brief Fetches the number of clients in the manager.
+			*
+			* @return Number of clients.
+			*/
+			size_t size() const;
+
+			/**
+			* @brief Fetches a client from the manager.
+			*
+			* @param index Index of the client to fetch
+			* @return Client at the specified index if it exists, nullptr otherwise.
+			*/
+			Jupiter::IRC::Client *get(size_t index) const;
+
+			/**
+			* @brief Sets the maximum amount of time which think() will block for while waiting for a client to become ready.
+			*
+			* @param in_max_wait Maximum time to wait
+			*/
+			void setMaxWait(std::chrono::milliseconds in_max_wait);
+
+			/**
+			* @brief Fetches the maximum amount of time which think() will block for.
+			*
+			* @return Maximum time to wait.
+			*/
+			std::chrono::milliseconds getMaxWait() const;
+
+			/**
+			* @brief Switches the manager from epoll to an io_uring backend. Plain sockets are attached to the ring, so that
+			* each iteration's receives and sends are submitted in a single io_uring_enter() call; TLS sockets are
+			* polled through the ring instead.
+			* Note: On failure (i.e: the kernel is too old), the manager continues to use epoll.
+			*
+			* @param in_entries Number of submission queue entries for the ring
+			* @return True if the io_uring backend is in use, false otherwise.
+			*/
+			bool enableIOUring(unsigned int in_entries = 256);
+
+			/**
+			* @brief Checks if the manager is using an io_uring backend.
+			*
+			* @return True if io_uring is in use, false otherwise.
+			*/
+			bool isIOUringEnabled() const;
+
+			/**
+			* @brief Default constructor for the ClientManager class.
+			*
+			* @param in_max_wait Maximum time which think() will block for while waiting for a client to become ready.
+			*/
+			ClientManager(std::chrono::milliseconds in_max_wait = std::chrono::milliseconds(100));
+
+			/**
+			* @brief Copying a ClientManager is forbidden.
+			*/
+			ClientManager(const ClientManager &) = delete;
+
+			/**
+			* @brief Destructor for the ClientManager class; this deletes all clients in the manager.
+			*/
+			~ClientManager();
+
+		/** Private members */
+		private:
+			struct Data;
+			Data *data_;
+		}; // Jupiter::IRC::ClientManager class
+	} // Jupiter::IRC namespace
+} // Jupiter namespace
+
+#endif // _IRC_CLIENTMANAGER_H_HEADER
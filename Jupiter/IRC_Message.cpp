@@ -0,0 +1,215 @@
+/**
+ * Copyright (C) 2017 Jessica James.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Written by Jessica James <jessica.aj@outlook.com>
+ */
+
+#include <cstring>
+#include "IRC_Message.h"
+
+Jupiter::IRC::Message::Message(const Jupiter::ReadableString &in_line)
+{
+	Jupiter::IRC::Message::parse(in_line);
+}
+
+bool Jupiter::IRC::Message::parse(const Jupiter::ReadableString &in_line)
+{
+	const char *itr = in_line.ptr();
+	const char *end = itr + in_line.size();
+	const char *token;
+
+	// Ignore any line terminators left over from framing
+	while (end != itr && (*(end - 1) == '\r' || *(end - 1) == '\n'))
+		--end;
+
+	m_line.set(itr, end - itr);
+	m_tags.erase();
+	m_prefix.erase();
+	m_nickname.erase();
+	m_username.erase();
+	m_hostname.erase();
+	m_command.erase();
+	m_parameter_count = 0;
+	m_numeric = 0;
+
+	auto skip_spaces = [&itr, end]()
+	{
+		while (itr != end && *itr == ' ')
+			++itr;
+	};
+
+	auto next_word = [&itr, end]()
+	{
+		const char *word = itr;
+		itr = reinterpret_cast<const char *>(memchr(itr, ' ', end - itr));
+		if (itr == nullptr)
+			itr = end;
+		return word;
+	};
+
+	skip_spaces();
+
+	// Tags
+	if (itr != end && *itr == '@')
+	{
+		++itr;
+		token = next_word();
+		m_tags.set(token, itr - token);
+		skip_spaces();
+	}
+
+	// Prefix (nickname!username@hostname)
+	if (itr != end && *itr == ':')
+	{
+		++itr;
+		token = next_word();
+		m_prefix.set(token, itr - token);
+
+		const char *user = token;
+		while (user != itr && *user != '!' && *user != '@')
+			++user;
+		m_nickname.set(token, user - token);
+
+		if (user != itr && *user == '!')
+		{
+			const char *host = ++user;
+			while (host != itr && *host != '@')
+				++host;
+			m_username.set(user, host - user);
+			user = host;
+		}
+
+		if (user != itr)
+			m_hostname.set(user + 1, itr - user - 1);
+
+		skip_spaces();
+	}
+
+	// Command
+	if (itr == end)
+		return false;
+
+	token = next_word();
+	m_command.set(token, itr - token);
+
+	if (m_command.size() == 3)
+	{
+		const char *digit = token;
+		while (digit != itr && *digit >= '0' && *digit <= '9')
+			m_numeric = m_numeric * 10 + (*digit++ - '0');
+
+		if (digit != itr)
+			m_numeric = 0;
+	}
+
+	// Parameters
+	while (m_parameter_count != MAX_PARAMETERS)
+	{
+		skip_spaces();
+		if (itr == end)
+			break;
+
+		if (*itr == ':' || m_parameter_count == MAX_PARAMETERS - 1)
+		{
+			// Trailing parameter; consumes the remainder of the line
+			if (*itr == ':')
+				++itr;
+			m_parameters[m_parameter_count++].set(itr, end - itr);
+			break;
+		}
+
+		token = next_word();
+		m_parameters[m_parameter_count++].set(token, itr - token);
+	}
+
+	return true;
+}
+
+const Jupiter::ReferenceString &Jupiter::IRC::Message::getLine() const
+{
+	return m_line;
+}
+
+const Jupiter::ReferenceString &Jupiter::IRC::Message::getTags() const
+{
+	return m_tags;
+}
+
+const Jupiter::ReferenceString &Jupiter::IRC::Message::getPrefix() const
+{
+	return m_prefix;
+}
+
+const Jupiter::ReferenceString &Jupiter::IRC::Message::getNickname() const
+{
+	return m_nickname;
+}
+
+const Jupiter::ReferenceString &Jupiter::IRC::Message::getUsername() const
+{
+	return m_username;
+}
+
+const Jupiter::ReferenceString &Jupiter::IRC::Message::getHostname() const
+{
+	return m_hostname;
+}
+
+bool Jupiter::IRC::Message::isUserPrefix() const
+{
+	return m_nickname.size() != m_prefix.size();
+}
+
+const Jupiter::ReferenceString &Jupiter::IRC::Message::getCommand() const
+{
+	return m_command;
+}
+
+int Jupiter::IRC::Message::getNumeric() const
+{
+	return m_numeric;
+}
+
+size_t Jupiter::IRC::Message::getParameterCount() const
+{
+	return m_parameter_count;
+}
+
+const Jupiter::ReferenceString &Jupiter::IRC::Message::getParameter(size_t in_index) const
+{
+	static const Jupiter::ReferenceString empty;
+
+	if (in_index < m_parameter_count)
+		return m_parameters[in_index];
+
+	return empty;
+}
+
+const Jupiter::ReferenceString &Jupiter::IRC::Message::getLastParameter() const
+{
+	if (m_parameter_count == 0)
+		return Jupiter::IRC::Message::getParameter(0);
+
+	return m_parameters[m_parameter_count - 1];
+}
+
+Jupiter::ReferenceString Jupiter::IRC::Message::getParametersFrom(size_t in_index) const
+{
+	if (in_index >= m_parameter_count)
+		return Jupiter::ReferenceString();
+
+	const char *begin = m_parameters[in_index].ptr();
+	return Jupiter::ReferenceString(begin, m_line.ptr() + m_line.size() - begin);
+}
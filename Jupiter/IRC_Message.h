@@ -0,0 +1,185 @@
+/**
+ * Copyright (C) 2017 Jessica James.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Written by Jessica James <jessica.aj@outlook.com>
+ */
+
+#if !defined _IRC_MESSAGE_H_HEADER
+#define _IRC_MESSAGE_H_HEADER
+
+/**
+ * @file IRC_Message.h
+ * @brief Provides a parsed, non-owning view of a single line of IRC protocol data.
+ */
+
+#include "Jupiter.h"
+#include "Reference_String.h"
+
+/** DLL Linkage Nagging */
+#if defined _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4251)
+#endif // _MSC_VER
+
+namespace Jupiter
+{
+	namespace IRC
+	{
+		/**
+		* @brief Provides a view of an IRC message, split into its tags, prefix, command, and parameters.
+		* Every component references the parsed line; the line must outlive the Message.
+		*/
+		class JUPITER_API Message
+		{
+		public:
+			/** Maximum number of parameters a message may carry (RFC 1459) */
+			static constexpr size_t MAX_PARAMETERS = 15;
+
+			/**
+			* @brief Parses a line of IRC protocol data in a single pass.
+			* Any trailing CR/LF characters are ignored.
+			*
+			* @param in_line Line to parse
+			* @return True if the line contained a command, false otherwise.
+			*/
+			bool parse(const Jupiter::ReadableString &in_line);
+
+			/**
+			* @brief Fetches the line which was parsed.
+			*
+			* @return Parsed line
+			*/
+			const Jupiter::ReferenceString &getLine() const;
+
+			/**
+			* @brief Fetches the message tags, without the leading '@'.
+			*
+			* @return Message tags if any were sent, an empty string otherwise.
+			*/
+			const Jupiter::ReferenceString &getTags() const;
+
+			/**
+			* @brief Fetches the message prefix, without the leading ':'.
+			*
+			* @return Message prefix if one was sent, an empty string otherwise.
+			*/
+			const Jupiter::ReferenceString &getPrefix() const;
+
+			/**
+			* @brief Fetches the nickname portion of the prefix.
+			* If the prefix has no user or host portion (i.e: a server name), this is the entire prefix.
+			*
+			* @return Nickname of the sender
+			*/
+			const Jupiter::ReferenceString &getNickname() const;
+
+			/**
+			* @brief Fetches the username portion of the prefix.
+			*
+			* @return Username of the sender if one was sent, an empty string otherwise.
+			*/
+			const Jupiter::ReferenceString &getUsername() const;
+
+			/**
+			* @brief Fetches the hostname portion of the prefix.
+			*
+			* @return Hostname of the sender if one was sent, an empty string otherwise.
+			*/
+			const Jupiter::ReferenceString &getHostname() const;
+
+			/**
+			* @brief Checks if the prefix identifies a user (nick!user@host), rather than a server.
+			*
+			* @return True if the prefix contains a user or host portion, false otherwise.
+			*/
+			bool isUserPrefix() const;
+
+			/**
+			* @brief Fetches the message command.
+			*
+			* @return Message command
+			*/
+			const Jupiter::ReferenceString &getCommand() const;
+
+			/**
+			* @brief Fetches the command's numeric value.
+			*
+			* @return Numeric value of the command if it is a numeric, 0 otherwise.
+			*/
+			int getNumeric() const;
+
+			/**
+			* @brief Fetches the number of parameters in the message, including the trailing parameter.
+			*
+			* @return Number of parameters
+			*/
+			size_t getParameterCount() const;
+
+			/**
+			* @brief Fetches a parameter from the message.
+			*
+			* @param in_index Index of the parameter to fetch
+			* @return Parameter at the specified index if it exists, an empty string otherwise.
+			*/
+			const Jupiter::ReferenceString &getParameter(size_t in_index) const;
+
+			/**
+			* @brief Fetches the last parameter in the message.
+			*
+			* @return Last parameter if any exist, an empty string otherwise.
+			*/
+			const Jupiter::ReferenceString &getLastParameter() const;
+
+			/**
+			* @brief Fetches the raw remainder of the line, starting at a specified parameter.
+			*
+			* @param in_index Index of the first parameter to include
+			* @return Remainder of the line if the parameter exists, an empty string otherwise.
+			*/
+			Jupiter::ReferenceString getParametersFrom(size_t in_index) const;
+
+			/**
+			* @brief Default constructor for the Message class.
+			*/
+			Message() = default;
+
+			/**
+			* @brief Parsing constructor for the Message class.
+			*
+			* @param in_line Line to parse
+			*/
+			Message(const Jupiter::ReadableString &in_line);
+
+		private:
+			Jupiter::ReferenceString m_line;
+			Jupiter::ReferenceString m_tags;
+			Jupiter::ReferenceString m_prefix;
+			Jupiter::ReferenceString m_nickname;
+			Jupiter::ReferenceString m_username;
+			Jupiter::ReferenceString m_hostname;
+			Jupiter::ReferenceString m_command;
+			Jupiter::ReferenceString m_parameters[MAX_PARAMETERS];
+			size_t m_parameter_count = 0;
+			int m_numeric = 0;
+		};
+	}
+}
+
+/** Re-enable warnings */
+#if defined _MSC_VER
+#pragma warning(pop)
+#endif
+
+#endif // _IRC_MESSAGE_H_HEADER
@@ -331,6 +331,7 @@ namespace Jupiter
 			constexpr NumericType YOUWILLBEBANNED = 466; /** RFC1459: You will soon be banned. */
 			constexpr NumericType KEYSET = 467; /** RFC1459: A key for this channel has already been set. */
 			constexpr NumericType LINKSET = 469; /** I have no idea what this does. */
+			constexpr NumericType LINKCHANNEL = 470; /** Hybrid: Forwarded to another channel instead of joining. */
 			constexpr NumericType CHANNELISFULL = 471; /** RFC1459: That channel is full. */
 			constexpr NumericType UNKNOWNMODE = 472; /** RFC1459: That mode is unknown. */
 			constexpr NumericType INVITEONLYCHAN = 473; /** RFC1459: That channel is invite-only. */
@@ -338,6 +339,7 @@ namespace Jupiter
 			constexpr NumericType BADCHANNELKEY = 475; /** RFC1459: Channel key was missing/incorrect. */
 			constexpr NumericType BADCHANMASK = 476; /** RFC2812: That channel mask is invalid. */
 			constexpr NumericType NOCHANMODES = 477; /** RFC2812: Channel does not support mode changes. */
+			constexpr NumericType NEEDREGGEDNICK = 477; /** Most ircds: That channel requires a registered nickname. */
 			constexpr NumericType BANLISTFULL = 478; /** RFC2812: Channel access/ban list is full. */
 			constexpr NumericType BADCHANNAME = 479; /** I have no idea what this does. */
 			constexpr NumericType LINKFAIL = 479; /** I have no idea what this does. */
@@ -347,6 +349,7 @@ namespace Jupiter
 			constexpr NumericType RESTRICTED = 484; /** RFC2812: This connection is "restricted" */
 			constexpr NumericType UNIQOPRIVSNEEDED = 485; /** RFC2812: That mode requires "channel creator" privledges. */
 			constexpr NumericType TSLESSCHAN = 488; /** I have no idea what this does. */
+			constexpr NumericType SECUREONLYCHAN = 489; /** Unreal/InspIRCd: That channel requires a secure connection. */
 			constexpr NumericType NOOPERHOST = 491; /** RFC1459: You can not become a server operator. */
 			constexpr NumericType NOSERVICEHOST = 492; /** RFC1459 */
 			constexpr NumericType NOFEATURE = 493; /** I have no idea what this does. */
@@ -367,6 +370,7 @@ namespace Jupiter
 			constexpr NumericType BADEXPIRE = 515; /** I have no idea what this does. */
 			constexpr NumericType DONTCHEAT = 516; /** I have no idea what this does. */
 			constexpr NumericType DISABLED = 517; /** I have no idea what this does. */
+			constexpr NumericType OPERONLY = 520; /** InspIRCd: That channel is for IRC operators only. */
 			constexpr NumericType WHOSYNTAX = 522; /** I have no idea what this does. */
 			constexpr NumericType WHOLIMEXCEED = 523; /** I have no idea what this does. */
 			constexpr NumericType REMOTEPFX = 525; /** I have no idea what this does. */
@@ -0,0 +1,382 @@
+/**
+ * Copyright (C) 2017 Jessica James.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Written by Jessica James <jessica.aj@outlook.com>
+ */
+
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include "LogWriter.h"
+
+/** Fetches the local midnight following a given time */
+static time_t get_next_midnight(time_t in_time)
+{
+	tm local;
+#if defined _WIN32
+	localtime_s(&local, &in_time);
+#else // _WIN32
+	localtime_r(&in_time, &local);
+#endif // _WIN32
+
+	local.tm_hour = 0;
+	local.tm_min = 0;
+	local.tm_sec = 0;
+	++local.tm_mday; // normalized by mktime()
+	local.tm_isdst = -1;
+	return mktime(&local);
+}
+
+/** Output */
+
+const std::string &Jupiter::LogWriter::Output::getFileName() const
+{
+	return m_file_name;
+}
+
+FILE *Jupiter::LogWriter::Output::getStream() const
+{
+	return m_file_name.empty() ? m_file : nullptr;
+}
+
+bool Jupiter::LogWriter::Output::isBlocking() const
+{
+	return m_blocking;
+}
+
+/** Rotates the file if necessary, and opens it if it isn't already; only called by the writer thread */
+bool Jupiter::LogWriter::Output::prepare(size_t in_size)
+{
+	if (m_file_name.empty()) // stream
+		return m_file != nullptr;
+
+	if (m_file != nullptr
+		&& ((m_max_size != 0 && m_size != 0 && m_size + in_size > m_max_size)
+			|| (m_rotate_daily && time(0) >= m_rotate_time)))
+		Jupiter::LogWriter::Output::rotate();
+
+	if (m_file == nullptr)
+	{
+		m_file = fopen(m_file_name.c_str(), "ab");
+		if (m_file == nullptr)
+			return false;
+
+		fseek(m_file, 0, SEEK_END);
+		long size = ftell(m_file);
+		m_size = size > 0 ? static_cast<size_t>(size) : 0;
+		m_rotate_time = get_next_midnight(time(0));
+	}
+
+	return true;
+}
+
+void Jupiter::LogWriter::Output::rotate()
+{
+	fclose(m_file);
+	m_file = nullptr;
+	m_size = 0;
+
+	char suffix[32];
+	time_t now = time(0);
+	tm local;
+#if defined _WIN32
+	localtime_s(&local, &now);
+#else // _WIN32
+	localtime_r(&now, &local);
+#endif // _WIN32
+	strftime(suffix, sizeof(suffix), ".%Y%m%d-%H%M%S", &local);
+
+	// Don't replace a file which was rotated earlier in the same second
+	std::string rotated_name = m_file_name + suffix;
+	size_t length = rotated_name.size();
+	FILE *existing;
+	for (unsigned int index = 1; (existing = fopen(rotated_name.c_str(), "rb")) != nullptr; ++index)
+	{
+		fclose(existing);
+		rotated_name.resize(length);
+		rotated_name += '.';
+		rotated_name += std::to_string(index);
+	}
+
+	// If this fails, the file is simply appended to
+	rename(m_file_name.c_str(), rotated_name.c_str());
+}
+
+Jupiter::LogWriter::Output::Output(const char *in_file_name, size_t in_max_size, bool in_rotate_daily, bool in_blocking) : m_file_name(in_file_name)
+{
+	m_file = nullptr;
+	m_max_size = in_max_size;
+	m_rotate_daily = in_rotate_daily;
+	m_blocking = in_blocking;
+}
+
+Jupiter::LogWriter::Output::Output(FILE *in_stream, bool in_blocking)
+{
+	m_file = in_stream;
+	m_max_size = 0;
+	m_rotate_daily = false;
+	m_blocking = in_blocking;
+}
+
+Jupiter::LogWriter::Output::~Output()
+{
+	if (m_file_name.empty() == false && m_file != nullptr)
+		fclose(m_file);
+}
+
+/**
+* The ring works the same as HTTP::AccessLog's: every slot carries a sequence number,
+* producers claim a slot by advancing the tail once the slot's sequence shows it's free,
+* and the writer publishes a freed slot by bumping its sequence by the ring's capacity.
+* Slots keep their line's buffer, so that lines only allocate until the ring is warm.
+*/
+
+namespace
+{
+	struct LogSlot
+	{
+		std::atomic<size_t> sequence;
+		std::shared_ptr<Jupiter::LogWriter::Output> output;
+		std::string line;
+	};
+}
+
+struct Jupiter::LogWriter::Data
+{
+	LogSlot *slots;
+	size_t mask;
+	std::atomic<size_t> tail{ 0 };
+	size_t head = 0; // only touched by the writer thread
+	std::atomic<size_t> dropped{ 0 };
+	std::atomic<size_t> waits{ 0 };
+	std::atomic<size_t> written{ 0 };
+	std::atomic<bool> running{ true };
+	size_t flush_size;
+	size_t wake_threshold; // number of queued lines at which the writer is woken early
+	std::chrono::milliseconds flush_interval;
+	std::vector<std::shared_ptr<Output>> dirty; // outputs written to since the last flush
+	std::mutex mutex; // only guards sleeping; the ring itself is lock-free
+	std::condition_variable wake; // wakes the writer
+	std::condition_variable space; // wakes producers waiting for room
+	std::atomic<size_t> waiting_producers{ 0 };
+	std::thread writer;
+
+	bool write_next(size_t &out_bytes);
+	void flush();
+	void writer_loop();
+};
+
+bool Jupiter::LogWriter::Data::write_next(size_t &out_bytes)
+{
+	LogSlot &slot = slots[head & mask];
+	if (slot.sequence.load(std::memory_order_acquire) != head + 1)
+		return false; // empty
+
+	Output &output = *slot.output;
+	if (output.prepare(slot.line.size()))
+	{
+		fwrite(slot.line.data(), 1, slot.line.size(), output.m_file);
+		output.m_size += slot.line.size();
+		out_bytes += slot.line.size();
+
+		if (output.m_dirty == false)
+		{
+			output.m_dirty = true;
+			dirty.push_back(slot.output);
+		}
+	}
+
+	slot.output = nullptr; // the last reference to an output may be held by the ring
+	slot.sequence.store(head + mask + 1, std::memory_order_release);
+	++head;
+	return true;
+}
+
+void Jupiter::LogWriter::Data::flush()
+{
+	for (const auto &output : dirty)
+	{
+		if (output->m_file != nullptr)
+			fflush(output->m_file);
+		output->m_dirty = false;
+	}
+
+	dirty.clear();
+}
+
+void Jupiter::LogWriter::Data::writer_loop()
+{
+	std::chrono::steady_clock::time_point last_flush = std::chrono::steady_clock::now();
+	size_t unflushed_bytes = 0;
+	size_t count;
+
+	while (true)
+	{
+		bool stopping = running.load(std::memory_order_acquire) == false;
+
+		// Drain everything currently in the ring, stopping early if enough has been written to flush
+		count = 0;
+		while (write_next(unflushed_bytes))
+		{
+			++count;
+			if (unflushed_bytes >= flush_size)
+				break;
+		}
+
+		if (count != 0)
+		{
+			written.fetch_add(count, std::memory_order_relaxed);
+			if (waiting_producers.load(std::memory_order_relaxed) != 0)
+			{
+				std::lock_guard<std::mutex> guard(mutex);
+				space.notify_all();
+			}
+		}
+
+		if (dirty.empty() == false
+			&& (unflushed_bytes >= flush_size || stopping || std::chrono::steady_clock::now() - last_flush >= flush_interval))
+		{
+			flush();
+			unflushed_bytes = 0;
+			last_flush = std::chrono::steady_clock::now();
+		}
+
+		if (count == 0)
+		{
+			if (stopping)
+				break;
+
+			// Sleep until the flush interval passes, or until enough lines are queued that the ring risks filling up
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait_for(lock, flush_interval, [this]
+			{
+				return tail.load(std::memory_order_relaxed) - head >= wake_threshold || running.load(std::memory_order_relaxed) == false;
+			});
+		}
+	}
+}
+
+/** LogWriter */
+
+bool Jupiter::LogWriter::write(const std::shared_ptr<Output> &in_output, const Jupiter::ReadableString &in_line)
+{
+	size_t position = data_->tail.load(std::memory_order_relaxed);
+	LogSlot *slot;
+
+	while (true)
+	{
+		slot = &data_->slots[position & data_->mask];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+
+		if (sequence == position)
+		{
+			// Slot is free; try to claim it
+			if (data_->tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (sequence < position)
+		{
+			// Writer hasn't released this slot yet; the ring is full
+			if (in_output->m_blocking == false)
+			{
+				data_->dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			// Output opted out of losing lines; wait for the writer to make room (checking back in case the wakeup is missed)
+			data_->waits.fetch_add(1, std::memory_order_relaxed);
+			std::unique_lock<std::mutex> lock(data_->mutex);
+			++data_->waiting_producers;
+			data_->wake.notify_one();
+			data_->space.wait_for(lock, data_->flush_interval);
+			--data_->waiting_producers;
+			lock.unlock();
+
+			position = data_->tail.load(std::memory_order_relaxed);
+		}
+		else // Another producer claimed this slot first
+			position = data_->tail.load(std::memory_order_relaxed);
+	}
+
+	slot->output = in_output;
+	slot->line.assign(in_line.ptr(), in_line.size());
+	slot->line.append(ENDL);
+	slot->sequence.store(position + 1, std::memory_order_release);
+
+	if ((position + 1) % data_->wake_threshold == 0)
+		data_->wake.notify_one();
+
+	return true;
+}
+
+size_t Jupiter::LogWriter::getDropped() const
+{
+	return data_->dropped.load(std::memory_order_relaxed);
+}
+
+size_t Jupiter::LogWriter::getWaits() const
+{
+	return data_->waits.load(std::memory_order_relaxed);
+}
+
+size_t Jupiter::LogWriter::getWritten() const
+{
+	return data_->written.load(std::memory_order_relaxed);
+}
+
+size_t Jupiter::LogWriter::getCapacity() const
+{
+	return data_->mask + 1;
+}
+
+Jupiter::LogWriter &Jupiter::LogWriter::getDefault()
+{
+	static Jupiter::LogWriter writer;
+	return writer;
+}
+
+Jupiter::LogWriter::LogWriter(size_t in_capacity, size_t in_flush_size, std::chrono::milliseconds in_flush_interval)
+{
+	size_t capacity = 4; // so that the wake threshold is never 0
+	while (capacity < in_capacity)
+		capacity <<= 1;
+
+	data_ = new Data();
+	data_->slots = new LogSlot[capacity];
+	data_->mask = capacity - 1;
+	data_->flush_size = in_flush_size;
+	data_->wake_threshold = capacity / 4;
+	data_->flush_interval = in_flush_interval;
+
+	for (size_t index = 0; index != capacity; ++index)
+		data_->slots[index].sequence.store(index, std::memory_order_relaxed);
+
+	data_->writer = std::thread(&Data::writer_loop, data_);
+}
+
+Jupiter::LogWriter::~LogWriter()
+{
+	data_->running.store(false, std::memory_order_release);
+	{
+		std::lock_guard<std::mutex> guard(data_->mutex);
+		data_->wake.notify_one();
+	}
+	data_->writer.join();
+	delete[] data_->slots;
+	delete data_;
+}
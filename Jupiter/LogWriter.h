@@ -0,0 +1,193 @@
+/**
+ * Copyright (C) 2017 Jessica James.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Written by Jessica James <jessica.aj@outlook.com>
+ */
+
+#if !defined _LOGWRITER_H_HEADER
+#define _LOGWRITER_H_HEADER
+
+/**
+ * @file LogWriter.h
+ * @brief Provides an asynchronous writer for log files and console output.
+ */
+
+#include <cstdio>
+#include <ctime>
+#include <chrono>
+#include <memory>
+#include <string>
+#include "Jupiter.h"
+#include "Readable_String.h"
+
+namespace Jupiter
+{
+	/**
+	* @brief Queues lines into a fixed-size lock-free ring, which is drained by a background writer thread.
+	* The writer batches lines, and flushes once enough data has been written or the flush interval has passed.
+	* The writer is woken early once the ring is a quarter full.
+	* Note: write() never performs file I/O, and by default never blocks; when the ring is full, the line is dropped.
+	* Outputs which must not lose lines may instead be made blocking, in which case write() waits for the writer to make room.
+	*/
+	class JUPITER_API LogWriter
+	{
+	public:
+		/**
+		* @brief Destination for lines; either a file which the writer opens and rotates, or an existing stream (i.e: stdout).
+		* Outputs are shared, so that lines which are still queued keep their output alive.
+		*/
+		class JUPITER_API Output
+		{
+		public:
+			/**
+			* @brief Fetches the name of the file this outputs to.
+			*
+			* @return Name of the file, or an empty string for stream outputs.
+			*/
+			const std::string &getFileName() const;
+
+			/**
+			* @brief Fetches the stream this outputs to.
+			*
+			* @return Stream passed to the constructor, or nullptr for file outputs.
+			*/
+			FILE *getStream() const;
+
+			/**
+			* @brief Checks if writes to this output wait for room when the ring is full, rather than dropping the line.
+			*
+			* @return True if writes to this output may block, false otherwise.
+			*/
+			bool isBlocking() const;
+
+			/**
+			* @brief Constructor for a file output.
+			* The file is opened for appending by the writer thread, upon the first line written to it.
+			* When the file is rotated, it is renamed with the time of rotation appended (i.e: "irc.log.20170101-000000").
+			*
+			* @param in_file_name Name of the file to write to
+			* @param in_max_size Size in bytes at which the file is rotated; 0 to never rotate by size.
+			* @param in_rotate_daily True to rotate the file when the (local) date changes, false otherwise.
+			* @param in_blocking True to wait for room when the ring is full instead of dropping lines; see isBlocking().
+			*/
+			Output(const char *in_file_name, size_t in_max_size = 0, bool in_rotate_daily = false, bool in_blocking = false);
+
+			/**
+			* @brief Constructor for a stream output.
+			*
+			* @param in_stream Stream to write to; this is not closed by the Output.
+			* @param in_blocking True to wait for room when the ring is full instead of dropping lines; see isBlocking().
+			*/
+			Output(FILE *in_stream, bool in_blocking = false);
+
+			/**
+			* @brief Copying an Output is forbidden.
+			*/
+			Output(const Output &) = delete;
+
+			/**
+			* @brief Destructor for the Output class; this closes the file, if one was opened.
+			*/
+			~Output();
+
+		/** Private members */
+		private:
+			friend class Jupiter::LogWriter;
+
+			bool prepare(size_t in_size);
+			void rotate();
+
+			std::string m_file_name;
+			FILE *m_file;
+			size_t m_max_size;
+			bool m_rotate_daily;
+			bool m_blocking;
+			size_t m_size = 0;
+			time_t m_rotate_time = 0; // local midnight following the file being opened
+			bool m_dirty = false; // written to since the last flush; only touched by the writer thread
+		};
+
+		/**
+		* @brief Places a line in the ring for the writer thread to output. A line ending is appended to the line.
+		* If the ring is full, this blocks until there is room for blocking outputs, and drops the line otherwise.
+		*
+		* @param in_output Output to write the line to
+		* @param in_line Line to write
+		* @return True if the line was queued, false if it was dropped because the ring is full.
+		*/
+		bool write(const std::shared_ptr<Output> &in_output, const Jupiter::ReadableString &in_line);
+
+		/**
+		* @brief Returns the number of lines dropped due to the ring being full; only non-blocking outputs drop lines.
+		*
+		* @return Number of dropped lines.
+		*/
+		size_t getDropped() const;
+
+		/**
+		* @brief Returns the number of times a write to a blocking output had to wait for the writer to make room.
+		*
+		* @return Number of waits.
+		*/
+		size_t getWaits() const;
+
+		/**
+		* @brief Returns the number of lines which have been written to their outputs.
+		*
+		* @return Number of written lines.
+		*/
+		size_t getWritten() const;
+
+		/**
+		* @brief Returns the number of lines the ring can hold.
+		*
+		* @return Capacity of the ring.
+		*/
+		size_t getCapacity() const;
+
+		/**
+		* @brief Fetches the writer which is shared by all clients.
+		*
+		* @return Default writer.
+		*/
+		static LogWriter &getDefault();
+
+		/**
+		* @brief Constructor for the LogWriter class; this starts the writer thread.
+		*
+		* @param in_capacity Number of lines the ring can hold; rounded up to a power of two, and at least 4.
+		* @param in_flush_size Number of bytes which may be written before outputs are flushed.
+		* @param in_flush_interval Longest time written lines may go unflushed; also the longest time the writer sleeps for.
+		*/
+		LogWriter(size_t in_capacity = 8192, size_t in_flush_size = 65536, std::chrono::milliseconds in_flush_interval = std::chrono::milliseconds(100));
+
+		/**
+		* @brief Copying a LogWriter is forbidden.
+		*/
+		LogWriter(const LogWriter &) = delete;
+
+		/**
+		* @brief Destructor for the LogWriter class; this stops the writer thread after writing any remaining lines.
+		*/
+		~LogWriter();
+
+	/** Private members */
+	private:
+		struct Data;
+		Data *data_;
+	}; // Jupiter::LogWriter class
+} // Jupiter namespace
+
+#endif // _LOGWRITER_H_HEADER
@@ -18,6 +18,9 @@
 
 #include <cstring>
 #include <cstdio>
+#include <cctype>
+#include <algorithm>
+#include <thread>
 
 #if defined _WIN32
 #include <Windows.h>
@@ -30,6 +33,9 @@
 #include "ArrayList.h"
 #include "CString.h"
 #include "String.h"
+#include "Hash_Table.h"
+#include "LogWriter.h"
+#include "WorkerPool.h"
 
 using namespace Jupiter::literals;
 
@@ -77,6 +83,101 @@ Jupiter::ArrayList<Jupiter::Plugin> _plugins;
 Jupiter::ArrayList<Jupiter::Plugin> *Jupiter::plugins = &_plugins;
 Jupiter::ArrayList<dlib> _libList;
 
+constexpr size_t Jupiter::Plugin::event_count;
+
+namespace
+{
+	/** Subscriber arrays for each event, so that dispatching an event only visits the plugins which handle it */
+	struct PluginSubscribers
+	{
+		typedef Jupiter::Hash_Table<Jupiter::StringS, std::vector<Jupiter::Plugin *>, Jupiter::ReadableString> CommandTableType;
+
+		std::vector<Jupiter::Plugin *> events[Jupiter::Plugin::event_count];
+		std::vector<Jupiter::Plugin *> numerics[1000]; // indexed by numeric
+		CommandTableType commands[2]; // RAW, MESSAGE; keyed by upper-case command
+		std::vector<Jupiter::Plugin *> any_command[2]; // RAW, MESSAGE; subscribers for commands which aren't in the table
+		std::vector<Jupiter::Plugin *> none;
+	};
+
+	PluginSubscribers _subscribers;
+}
+
+static size_t get_command_table_index(Jupiter::Plugin::Event in_event)
+{
+	return in_event == Jupiter::Plugin::Event::RAW ? 0 : 1;
+}
+
+void Jupiter::Plugin::rebuildSubscribers()
+{
+	for (auto &subscribers : _subscribers.events)
+		subscribers.clear();
+	for (auto &subscribers : _subscribers.numerics)
+		subscribers.clear();
+	for (size_t table = 0; table != 2; ++table)
+	{
+		_subscribers.commands[table].erase();
+		_subscribers.any_command[table].clear();
+	}
+
+	Jupiter::Plugin *plugin;
+	const Jupiter::Plugin::Event command_events[2] = { Event::RAW, Event::MESSAGE };
+
+	// Every filtered command needs an entry before any plugin is added to them, since unfiltered plugins are added to every entry
+	for (size_t index = 0; index != _plugins.size(); ++index)
+	{
+		plugin = _plugins.get(index);
+		for (size_t table = 0; table != 2; ++table)
+			if (plugin->isSubscribed(command_events[table]))
+				for (const auto &command : plugin->m_commands)
+					_subscribers.commands[table].set(command);
+	}
+
+	for (size_t index = 0; index != _plugins.size(); ++index)
+	{
+		plugin = _plugins.get(index);
+
+		for (size_t event = 0; event != Jupiter::Plugin::event_count; ++event)
+			if (plugin->isSubscribed(static_cast<Event>(event)))
+				_subscribers.events[event].push_back(plugin);
+
+		if (plugin->isSubscribed(Event::NUMERIC))
+		{
+			if (plugin->m_numerics.empty())
+			{
+				for (auto &subscribers : _subscribers.numerics)
+					subscribers.push_back(plugin);
+			}
+			else
+			{
+				for (int numeric : plugin->m_numerics)
+					_subscribers.numerics[numeric].push_back(plugin);
+			}
+		}
+
+		for (size_t table = 0; table != 2; ++table)
+		{
+			if (plugin->isSubscribed(command_events[table]))
+			{
+				if (plugin->m_commands.empty())
+				{
+					auto add_subscriber_callback = [plugin](PluginSubscribers::CommandTableType::Bucket::Entry &in_entry)
+					{
+						in_entry.value.push_back(plugin);
+					};
+
+					_subscribers.commands[table].callback(add_subscriber_callback);
+					_subscribers.any_command[table].push_back(plugin);
+				}
+				else
+				{
+					for (const auto &command : plugin->m_commands)
+						_subscribers.commands[table].get(command)->push_back(plugin);
+				}
+			}
+		}
+	}
+}
+
 /** Jupiter::Plugin Implementation */
 
 Jupiter::Plugin::Plugin()
@@ -90,6 +191,7 @@ Jupiter::Plugin::~Plugin()
 		if (_plugins.get(index) == this)
 		{
 			_plugins.remove(index);
+			Jupiter::Plugin::rebuildSubscribers();
 			break;
 		}
 	}
@@ -121,6 +223,271 @@ void Jupiter::Plugin::OnPostInitialize()
 {
 }
 
+// Event Subscriptions
+
+void Jupiter::Plugin::subscribe(Event in_event)
+{
+	m_events |= uint32_t{ 1 } << static_cast<size_t>(in_event);
+	Jupiter::Plugin::rebuildSubscribers();
+}
+
+void Jupiter::Plugin::unsubscribe(Event in_event)
+{
+	m_events &= ~(uint32_t{ 1 } << static_cast<size_t>(in_event));
+	Jupiter::Plugin::rebuildSubscribers();
+}
+
+void Jupiter::Plugin::setSubscriptions(std::initializer_list<Event> in_events)
+{
+	m_events = 0;
+	for (Event event : in_events)
+		m_events |= uint32_t{ 1 } << static_cast<size_t>(event);
+
+	Jupiter::Plugin::rebuildSubscribers();
+}
+
+bool Jupiter::Plugin::isSubscribed(Event in_event) const
+{
+	return (m_events & (uint32_t{ 1 } << static_cast<size_t>(in_event))) != 0;
+}
+
+void Jupiter::Plugin::subscribeNumeric(int in_numeric)
+{
+	if (in_numeric <= 0 || in_numeric >= 1000)
+		return;
+
+	for (int numeric : m_numerics)
+		if (numeric == in_numeric)
+			return;
+
+	m_numerics.push_back(in_numeric);
+	Jupiter::Plugin::rebuildSubscribers();
+}
+
+void Jupiter::Plugin::subscribeCommand(const Jupiter::ReadableString &in_command)
+{
+	Jupiter::StringS command(in_command.size());
+	for (size_t index = 0; index != in_command.size(); ++index)
+		command += static_cast<char>(toupper(static_cast<unsigned char>(in_command.get(index))));
+
+	for (const auto &existing : m_commands)
+		if (existing.equals(command))
+			return;
+
+	m_commands.push_back(std::move(command));
+	Jupiter::Plugin::rebuildSubscribers();
+}
+
+void Jupiter::Plugin::setOffloaded(Event in_event, bool in_offloaded)
+{
+	if (in_offloaded)
+		m_offloaded_events |= uint32_t{ 1 } << static_cast<size_t>(in_event);
+	else
+		m_offloaded_events &= ~(uint32_t{ 1 } << static_cast<size_t>(in_event));
+}
+
+bool Jupiter::Plugin::isOffloaded(Event in_event) const
+{
+	return (m_offloaded_events & (uint32_t{ 1 } << static_cast<size_t>(in_event))) != 0;
+}
+
+void Jupiter::Plugin::beginOffloadedCall()
+{
+	++m_offloaded_calls;
+}
+
+void Jupiter::Plugin::endOffloadedCall()
+{
+	--m_offloaded_calls;
+}
+
+void Jupiter::Plugin::waitForOffloadedCalls() const
+{
+	// Only reached while unloading a plugin, so there's no need for anything better than polling
+	while (m_offloaded_calls != 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+Jupiter::WorkerPool &Jupiter::Plugin::getHookPool()
+{
+	static Jupiter::WorkerPool pool(std::thread::hardware_concurrency() / 2);
+	return pool;
+}
+
+const std::vector<Jupiter::Plugin *> &Jupiter::Plugin::getSubscribers(Event in_event)
+{
+	return _subscribers.events[static_cast<size_t>(in_event)];
+}
+
+const std::vector<Jupiter::Plugin *> &Jupiter::Plugin::getNumericSubscribers(int in_numeric)
+{
+	if (in_numeric <= 0 || in_numeric >= 1000)
+		return _subscribers.none;
+
+	return _subscribers.numerics[in_numeric];
+}
+
+const std::vector<Jupiter::Plugin *> &Jupiter::Plugin::getCommandSubscribers(Event in_event, const Jupiter::ReadableString &in_command)
+{
+	size_t table = get_command_table_index(in_event);
+	if (_subscribers.commands[table].size() == 0) // no plugin filters on commands
+		return _subscribers.any_command[table];
+
+	std::vector<Jupiter::Plugin *> *subscribers = _subscribers.commands[table].get(in_command);
+	if (subscribers == nullptr)
+	{
+		// Commands are almost always upper-case already
+		Jupiter::StringS command(in_command.size());
+		for (size_t index = 0; index != in_command.size(); ++index)
+			command += static_cast<char>(toupper(static_cast<unsigned char>(in_command.get(index))));
+
+		subscribers = _subscribers.commands[table].get(command);
+		if (subscribers == nullptr)
+			return _subscribers.any_command[table];
+	}
+
+	return *subscribers;
+}
+
+const char *Jupiter::Plugin::getEventName(Event in_event)
+{
+	static const char *names[Jupiter::Plugin::event_count] =
+	{
+		"Connect", "AutoJoinSynced", "Disconnect", "ReconnectAttempt", "Raw", "Numeric", "Message", "Error",
+		"Chat", "Notice", "ServerNotice", "CTCP", "Action", "Invite", "Join", "Part", "Nick", "Kick", "Quit",
+		"Mode", "Think", "GenericCommandAdd", "GenericCommandRemove"
+	};
+
+	return names[static_cast<size_t>(in_event)];
+}
+
+/** Hook profiling */
+
+static std::atomic<bool> hook_profiling{ false };
+static std::atomic<int64_t> slow_hook_threshold{ std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::milliseconds(100)).count() };
+
+Jupiter::Plugin::HookTimer::HookTimer(Jupiter::Plugin *in_plugin, Event in_event)
+{
+	if (hook_profiling.load(std::memory_order_relaxed))
+	{
+		m_plugin = in_plugin;
+		m_event = in_event;
+		m_start = std::chrono::steady_clock::now();
+	}
+	else
+		m_plugin = nullptr;
+}
+
+Jupiter::Plugin::HookTimer::~HookTimer()
+{
+	if (m_plugin == nullptr)
+		return;
+
+	int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+	HookCounters &counters = m_plugin->m_hook_counters[static_cast<size_t>(m_event)];
+
+	counters.calls.fetch_add(1, std::memory_order_relaxed);
+	counters.total_time.fetch_add(elapsed, std::memory_order_relaxed);
+
+	int64_t max_time = counters.max_time.load(std::memory_order_relaxed);
+	while (elapsed > max_time && counters.max_time.compare_exchange_weak(max_time, elapsed, std::memory_order_relaxed) == false);
+
+	int64_t threshold = slow_hook_threshold.load(std::memory_order_relaxed);
+	if (threshold != 0 && elapsed >= threshold)
+	{
+		counters.slow_calls.fetch_add(1, std::memory_order_relaxed);
+
+		// Written by the log writer's thread, so that the warning doesn't add to the latency being measured
+		static std::shared_ptr<Jupiter::LogWriter::Output> slow_hook_output = std::make_shared<Jupiter::LogWriter::Output>(stderr);
+		Jupiter::LogWriter::getDefault().write(slow_hook_output, Jupiter::StringS::Format("Warning: Plugin \"%.*s\" took %lld ms in %s", static_cast<int>(m_plugin->name.size()), m_plugin->name.ptr(),
+			static_cast<long long>(elapsed / 1000000), Jupiter::Plugin::getEventName(m_event)));
+	}
+}
+
+Jupiter::Plugin::HookStats Jupiter::Plugin::getHookStats(Event in_event) const
+{
+	const HookCounters &counters = m_hook_counters[static_cast<size_t>(in_event)];
+	HookStats result;
+
+	result.calls = counters.calls.load(std::memory_order_relaxed);
+	result.slow_calls = counters.slow_calls.load(std::memory_order_relaxed);
+	result.total_time = std::chrono::nanoseconds(counters.total_time.load(std::memory_order_relaxed));
+	result.max_time = std::chrono::nanoseconds(counters.max_time.load(std::memory_order_relaxed));
+	return result;
+}
+
+void Jupiter::Plugin::resetHookStats()
+{
+	for (HookCounters &counters : m_hook_counters)
+	{
+		counters.calls = 0;
+		counters.slow_calls = 0;
+		counters.total_time = 0;
+		counters.max_time = 0;
+	}
+}
+
+void Jupiter::Plugin::setHookProfiling(bool in_enabled)
+{
+	hook_profiling = in_enabled;
+}
+
+bool Jupiter::Plugin::isHookProfiling()
+{
+	return hook_profiling;
+}
+
+void Jupiter::Plugin::setSlowHookThreshold(std::chrono::milliseconds in_threshold)
+{
+	slow_hook_threshold = std::chrono::duration_cast<std::chrono::nanoseconds>(in_threshold).count();
+}
+
+std::chrono::milliseconds Jupiter::Plugin::getSlowHookThreshold()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::nanoseconds(slow_hook_threshold.load()));
+}
+
+Jupiter::StringS Jupiter::Plugin::getHookStatsReport()
+{
+	// Snapshot each hook once, and use only the snapshot, so that neither calls still being measured nor a concurrent
+	// resetHookStats() can change a row after it's been filtered
+	std::vector<std::pair<Jupiter::Plugin *, Event>> hooks;
+	std::vector<std::pair<HookStats, size_t>> stats;
+	for (size_t index = 0; index != _plugins.size(); ++index)
+	{
+		for (size_t event = 0; event != Jupiter::Plugin::event_count; ++event)
+		{
+			HookStats hook = _plugins.get(index)->getHookStats(static_cast<Event>(event));
+			if (hook.calls != 0)
+			{
+				stats.emplace_back(hook, hooks.size());
+				hooks.emplace_back(_plugins.get(index), static_cast<Event>(event));
+			}
+		}
+	}
+
+	std::sort(stats.begin(), stats.end(), [](const std::pair<HookStats, size_t> &lhs, const std::pair<HookStats, size_t> &rhs)
+	{
+		return lhs.first.total_time > rhs.first.total_time;
+	});
+
+	Jupiter::StringS result;
+	for (const auto &entry : stats)
+	{
+		const Jupiter::Plugin *plugin = hooks[entry.second].first;
+		const HookStats &hook = entry.first;
+		result += Jupiter::StringS::Format("%.*s %s calls=%llu total=%lldms avg=%lldus max=%lldus slow=%llu" ENDL,
+			static_cast<int>(plugin->name.size()), plugin->name.ptr(), Jupiter::Plugin::getEventName(hooks[entry.second].second),
+			static_cast<unsigned long long>(hook.calls),
+			static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(hook.total_time).count()),
+			static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(hook.total_time).count() / static_cast<long long>(hook.calls)),
+			static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(hook.max_time).count()),
+			static_cast<unsigned long long>(hook.slow_calls));
+	}
+
+	return result;
+}
+
 // Static Functions
 
 void Jupiter::Plugin::setDirectory(const Jupiter::ReadableString &dir)
@@ -206,6 +573,7 @@ Jupiter::Plugin *Jupiter::Plugin::load(const Jupiter::ReadableString &pluginName
 
 	_libList.add(dPlug);
 	_plugins.add(dPlug->plugin);
+	Jupiter::Plugin::rebuildSubscribers();
 
 	return dPlug->plugin;
 
@@ -219,9 +587,13 @@ bool Jupiter::Plugin::free(size_t index)
 	if (index < _plugins.size())
 	{
 		// Do not free() the plugin; plugin gets free'd by FreeLibrary().
-		_plugins.remove(index);
+		Jupiter::Plugin *plugin = _plugins.remove(index);
+		Jupiter::Plugin::rebuildSubscribers();
 		dlib *dPlug = _libList.remove(index);
 
+		// No new calls are dispatched to the plugin now; finish the offloaded ones while its code is still loaded
+		plugin->waitForOffloadedCalls();
+
 		typedef void(*func_type)(void);
 #if defined _WIN32
 		func_type func = (func_type)GetProcAddress(dPlug->lib, "unload");
@@ -307,6 +679,11 @@ void Jupiter::Plugin::OnConnect(Jupiter::IRC::Client *)
 	return;
 }
 
+void Jupiter::Plugin::OnAutoJoinSynced(Jupiter::IRC::Client *)
+{
+	return;
+}
+
 void Jupiter::Plugin::OnDisconnect(Jupiter::IRC::Client *)
 {
 	return;
@@ -327,6 +704,11 @@ void Jupiter::Plugin::OnNumeric(Jupiter::IRC::Client *, long int, const Jupiter:
 	return;
 }
 
+void Jupiter::Plugin::OnMessage(Jupiter::IRC::Client *, const Jupiter::IRC::Message &)
+{
+	return;
+}
+
 void Jupiter::Plugin::OnError(Jupiter::IRC::Client *, const Jupiter::ReadableString &)
 {
 	return;
@@ -24,6 +24,11 @@
  * @brief Provides a hot-swapable plugin system.
  */
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
 #include "ArrayList.h"
 #include "Thinker.h"
 #include "Rehash.h"
@@ -39,8 +44,9 @@
 namespace Jupiter
 {
 	/** Forward declaration */
-	namespace IRC { class Client; }
+	namespace IRC { class Client; class Message; }
 	class GenericCommand;
+	class WorkerPool;
 
 	/**
 	* @brief Provides the basis for plugin interfacing.
@@ -112,6 +118,247 @@ namespace Jupiter
 		*/
 		virtual void OnPostInitialize();
 
+	public: // Event subscriptions
+		/**
+		* @brief Events which a plugin may subscribe to; each corresponds to the hook of the same name.
+		*/
+		enum class Event
+		{
+			CONNECT, /** OnConnect */
+			AUTO_JOIN_SYNCED, /** OnAutoJoinSynced */
+			DISCONNECT, /** OnDisconnect */
+			RECONNECT_ATTEMPT, /** OnReconnectAttempt */
+			RAW, /** OnRaw; see subscribeCommand() */
+			NUMERIC, /** OnNumeric; see subscribeNumeric() */
+			MESSAGE, /** OnMessage; see subscribeCommand() */
+			SERVER_ERROR, /** OnError */
+			CHAT, /** OnChat */
+			NOTICE, /** OnNotice */
+			SERVER_NOTICE, /** OnServerNotice */
+			CTCP, /** OnCTCP */
+			ACTION, /** OnAction */
+			INVITE, /** OnInvite */
+			JOIN, /** OnJoin */
+			PART, /** OnPart */
+			NICK, /** OnNick */
+			KICK, /** OnKick */
+			QUIT, /** OnQuit */
+			MODE, /** OnMode */
+			THINK, /** OnThink */
+			GENERIC_COMMAND_ADD, /** OnGenericCommandAdd */
+			GENERIC_COMMAND_REMOVE /** OnGenericCommandRemove */
+		};
+
+		/** Number of values in Event */
+		static constexpr size_t event_count = static_cast<size_t>(Event::GENERIC_COMMAND_REMOVE) + 1;
+
+		/**
+		* @brief Subscribes the plugin to an event, so that its hook is called.
+		* Plugins are subscribed to every event by default; see setSubscriptions().
+		*
+		* @param in_event Event to subscribe to
+		*/
+		void subscribe(Event in_event);
+
+		/**
+		* @brief Unsubscribes the plugin from an event, so that its hook is no longer called.
+		*
+		* @param in_event Event to unsubscribe from
+		*/
+		void unsubscribe(Event in_event);
+
+		/**
+		* @brief Subscribes the plugin to only the specified events.
+		* This is typically called from the plugin's constructor or initialize(), listing the hooks it overrides.
+		*
+		* @param in_events Events to subscribe to
+		*/
+		void setSubscriptions(std::initializer_list<Event> in_events);
+
+		/**
+		* @brief Checks if the plugin is subscribed to an event.
+		*
+		* @param in_event Event to check
+		* @return True if the plugin's hook for the event is called, false otherwise.
+		*/
+		bool isSubscribed(Event in_event) const;
+
+		/**
+		* @brief Restricts OnNumeric to a numeric; this may be called for multiple numerics.
+		* Until this is called, OnNumeric is called for every numeric.
+		*
+		* @param in_numeric Numeric to receive (1-999)
+		*/
+		void subscribeNumeric(int in_numeric);
+
+		/**
+		* @brief Restricts OnRaw and OnMessage to lines with a command; this may be called for multiple commands.
+		* Until this is called, OnRaw and OnMessage are called for every line.
+		*
+		* @param in_command Command to receive (i.e: PRIVMSG, or a numeric such as 001); this is matched case-insensitively.
+		*/
+		void subscribeCommand(const Jupiter::ReadableString &in_command);
+
+		/**
+		* @brief Marks a hook as offloaded, so that IRC::Client calls it on the hook pool (see getHookPool()) instead of while processing the line.
+		* Offloaded calls are run in order for each channel (and for each client, for events outside of a channel),
+		* while different channels run in parallel. String parameters are copies which remain valid for the call.
+		* Note: Offloaded hooks may only use the client's sendMessage(), sendNotice() and send(), which hand the data
+		* back to the client's thread; the plugin must protect its own state from concurrent access.
+		*
+		* @param in_event Event to offload
+		* @param in_offloaded True to offload the event, false to call it inline (default).
+		*/
+		void setOffloaded(Event in_event, bool in_offloaded = true);
+
+		/**
+		* @brief Checks if a hook is offloaded; see setOffloaded().
+		*
+		* @param in_event Event to check
+		* @return True if the event is offloaded, false otherwise.
+		*/
+		bool isOffloaded(Event in_event) const;
+
+		/**
+		* @brief Records that a call to one of this plugin's hooks was queued to run on another thread.
+		* Each call must be matched by endOffloadedCall() once the hook has returned; free() waits for them.
+		*/
+		void beginOffloadedCall();
+
+		/**
+		* @brief Records that an offloaded call to one of this plugin's hooks has finished; see beginOffloadedCall().
+		*/
+		void endOffloadedCall();
+
+		/**
+		* @brief Blocks until every offloaded call to this plugin's hooks has finished.
+		* free() calls this before unloading the plugin; anything else which destroys a plugin must call this first,
+		* since by the time the destructor runs, an offloaded hook may already be using a destroyed derived object.
+		* Note: This must not be called from one of the plugin's offloaded hooks.
+		*/
+		void waitForOffloadedCalls() const;
+
+		/**
+		* @brief Fetches the pool which offloaded hooks run on.
+		* This is separate from WorkerPool::getDefault(), so that slow hooks never hold up TLS offloading, which the network thread waits on.
+		* This pool has one thread for every two hardware threads, and at least one.
+		*
+		* @return Hook pool.
+		*/
+		static Jupiter::WorkerPool &getHookPool();
+
+		/**
+		* @brief Fetches the plugins subscribed to an event, in load order.
+		* Note: The returned list is rebuilt whenever a plugin is loaded, unloaded, or changes its subscriptions.
+		*
+		* @param in_event Event to fetch the subscribers of
+		* @return Plugins subscribed to the event.
+		*/
+		static const std::vector<Jupiter::Plugin *> &getSubscribers(Event in_event);
+
+		/**
+		* @brief Fetches the plugins which receive OnNumeric for a numeric, in load order.
+		*
+		* @param in_numeric Numeric to fetch the subscribers of
+		* @return Plugins subscribed to the numeric.
+		*/
+		static const std::vector<Jupiter::Plugin *> &getNumericSubscribers(int in_numeric);
+
+		/**
+		* @brief Fetches the plugins which receive OnRaw or OnMessage for a command, in load order.
+		*
+		* @param in_event Event::RAW or Event::MESSAGE
+		* @param in_command Command to fetch the subscribers of
+		* @return Plugins subscribed to the command.
+		*/
+		static const std::vector<Jupiter::Plugin *> &getCommandSubscribers(Event in_event, const Jupiter::ReadableString &in_command);
+
+		/**
+		* @brief Fetches the name of an event, as used in hook statistics.
+		*
+		* @param in_event Event to fetch the name of
+		* @return Null-terminated name of the event.
+		*/
+		static const char *getEventName(Event in_event);
+
+	public: // Hook profiling
+		/** Statistics for calls to one of a plugin's hooks, gathered while hook profiling is enabled */
+		struct HookStats
+		{
+			uint64_t calls; /** Number of calls */
+			uint64_t slow_calls; /** Number of calls which took at least the slow hook threshold */
+			std::chrono::nanoseconds total_time; /** Total wall time spent in the hook */
+			std::chrono::nanoseconds max_time; /** Longest wall time of a single call */
+		};
+
+		/**
+		* @brief Measures a single call to a plugin's hook, from construction to destruction.
+		* Nothing is measured while hook profiling is disabled.
+		*/
+		class JUPITER_API HookTimer
+		{
+		public:
+			HookTimer(Jupiter::Plugin *in_plugin, Event in_event);
+			~HookTimer();
+
+		private:
+			Jupiter::Plugin *m_plugin; // nullptr when not profiling
+			Event m_event;
+			std::chrono::steady_clock::time_point m_start;
+		};
+
+		/**
+		* @brief Fetches the statistics for one of this plugin's hooks.
+		* Note: Hooks are only measured while hook profiling is enabled.
+		*
+		* @param in_event Event whose hook to fetch statistics for
+		* @return Statistics for the hook.
+		*/
+		HookStats getHookStats(Event in_event) const;
+
+		/**
+		* @brief Resets the statistics for each of this plugin's hooks.
+		*/
+		void resetHookStats();
+
+		/**
+		* @brief Enables or disables measuring calls to plugin hooks. Disabled by default.
+		* While enabled, each call costs two clock reads and a few relaxed atomic operations.
+		*
+		* @param in_enabled True to measure hook calls, false otherwise.
+		*/
+		static void setHookProfiling(bool in_enabled);
+
+		/**
+		* @brief Checks if calls to plugin hooks are being measured.
+		*
+		* @return True if hook profiling is enabled, false otherwise.
+		*/
+		static bool isHookProfiling();
+
+		/**
+		* @brief Sets how long a hook may take before the call is counted as slow and logged to stderr (through LogWriter::getDefault()).
+		*
+		* @param in_threshold Slow call threshold; zero disables logging slow calls (default: 100ms).
+		*/
+		static void setSlowHookThreshold(std::chrono::milliseconds in_threshold);
+
+		/**
+		* @brief Returns how long a hook may take before the call is counted as slow.
+		*
+		* @return Slow call threshold, or zero if slow calls aren't logged.
+		*/
+		static std::chrono::milliseconds getSlowHookThreshold();
+
+		/**
+		* @brief Formats the statistics of every loaded plugin's hooks, one hook per line, slowest total first.
+		* Hooks which were never called are omitted. Each line has the form:
+		* "<plugin> <event> calls=<n> total=<ms>ms avg=<us>us max=<us>us slow=<n>"
+		*
+		* @return String containing the report, with each line terminated by ENDL.
+		*/
+		static Jupiter::StringS getHookStatsReport();
+
 		/** IRC Listeners */
 
 		/**
@@ -120,6 +367,12 @@ namespace Jupiter
 		*/
 		virtual void OnConnect(Jupiter::IRC::Client *server);
 
+		/**
+		* @brief This is called once every channel auto-joined upon connecting has either finished joining
+		* (i.e: its names list has been received) or failed to join.
+		*/
+		virtual void OnAutoJoinSynced(Jupiter::IRC::Client *server);
+
 		/**
 		* @brief This is called when at the end of disconnect().
 		* This is called upon any connection failure or error.
@@ -149,6 +402,14 @@ namespace Jupiter
 		*/
 		virtual void OnNumeric(Jupiter::IRC::Client *server, long int numeric, const Jupiter::ReadableString &raw);
 
+		/**
+		* @brief This is called after a message has been parsed and processed, before OnRaw.
+		* The message is only valid for the duration of the call.
+		*
+		* @param message The parsed message.
+		*/
+		virtual void OnMessage(Jupiter::IRC::Client *server, const Jupiter::IRC::Message &message);
+
 		/**
 		* @brief This is called when an ERROR is received.
 		* This indicates a connection termination, and thus, disconnect() is called immediately after this.
@@ -288,6 +549,7 @@ namespace Jupiter
 
 		/**
 		* @brief Destructor for Plugin class.
+		* Note: This does not wait for offloaded calls; see waitForOffloadedCalls().
 		*/
 		virtual ~Plugin();
 
@@ -373,6 +635,24 @@ namespace Jupiter
 		bool _shouldRemove = false;
 		Jupiter::StringS name;
 		Jupiter::INIConfig config;
+
+	private:
+		static void rebuildSubscribers();
+
+		uint32_t m_events = UINT32_MAX; // bit per Event
+		uint32_t m_offloaded_events = 0; // bit per Event
+		std::atomic<size_t> m_offloaded_calls{ 0 }; // queued or running on another thread
+		std::vector<int> m_numerics; // empty to receive every numeric
+		std::vector<Jupiter::StringS> m_commands; // upper-case; empty to receive every command
+
+		/** Hook statistics; atomic since offloaded hooks are measured on worker threads */
+		struct HookCounters
+		{
+			std::atomic<uint64_t> calls{ 0 };
+			std::atomic<uint64_t> slow_calls{ 0 };
+			std::atomic<int64_t> total_time{ 0 }; // nanoseconds
+			std::atomic<int64_t> max_time{ 0 }; // nanoseconds
+		} m_hook_counters[event_count];
 	};
 
 	/** The list containing pointers to plugins */
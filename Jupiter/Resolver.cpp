@@ -0,0 +1,297 @@
+/**
+ * Copyright (C) 2017 Jessica James.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Written by Jessica James <jessica.aj@outlook.com>
+ */
+
+#include <cstdio>
+#include <string>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#if defined _WIN32
+#include <WinSock2.h>
+#include <ws2tcpip.h>
+#else // _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#endif // _WIN32
+
+#include "Resolver.h"
+
+/** Result */
+
+struct Jupiter::Resolver::Result::Data
+{
+	std::string hostname;
+	unsigned short port;
+	addrinfo *info = nullptr;
+	int error = 0;
+	std::atomic<bool> ready{ false };
+	mutable std::mutex mutex;
+	mutable std::condition_variable condition;
+
+	void complete(addrinfo *in_info, int in_error);
+};
+
+void Jupiter::Resolver::Result::Data::complete(addrinfo *in_info, int in_error)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	info = in_info;
+	error = in_error;
+	ready.store(true, std::memory_order_release);
+	condition.notify_all();
+}
+
+bool Jupiter::Resolver::Result::isReady() const
+{
+	return Jupiter::Resolver::Result::data_->ready.load(std::memory_order_acquire);
+}
+
+void Jupiter::Resolver::Result::wait() const
+{
+	if (Jupiter::Resolver::Result::isReady() == false)
+	{
+		std::unique_lock<std::mutex> lock(Jupiter::Resolver::Result::data_->mutex);
+		Jupiter::Resolver::Result::data_->condition.wait(lock, [this] { return Jupiter::Resolver::Result::isReady(); });
+	}
+}
+
+addrinfo *Jupiter::Resolver::Result::getInfo() const
+{
+	if (Jupiter::Resolver::Result::isReady() == false)
+		return nullptr;
+
+	return Jupiter::Resolver::Result::data_->info;
+}
+
+int Jupiter::Resolver::Result::getError() const
+{
+	if (Jupiter::Resolver::Result::isReady() == false)
+		return 0;
+
+	return Jupiter::Resolver::Result::data_->error;
+}
+
+const char *Jupiter::Resolver::Result::getHostname() const
+{
+	return Jupiter::Resolver::Result::data_->hostname.c_str();
+}
+
+unsigned short Jupiter::Resolver::Result::getPort() const
+{
+	return Jupiter::Resolver::Result::data_->port;
+}
+
+Jupiter::Resolver::Result::Result(const char *in_hostname, unsigned short in_port)
+{
+	Jupiter::Resolver::Result::data_ = new Data();
+	Jupiter::Resolver::Result::data_->hostname = in_hostname;
+	Jupiter::Resolver::Result::data_->port = in_port;
+}
+
+Jupiter::Resolver::Result::~Result()
+{
+	if (Jupiter::Resolver::Result::data_->info != nullptr)
+		freeaddrinfo(Jupiter::Resolver::Result::data_->info);
+
+	delete Jupiter::Resolver::Result::data_;
+}
+
+/** Resolver */
+
+namespace
+{
+	struct CacheEntry
+	{
+		std::shared_ptr<Jupiter::Resolver::Result> result;
+		std::chrono::steady_clock::time_point expires = std::chrono::steady_clock::time_point::max(); // set once resolution completes
+	};
+}
+
+struct Jupiter::Resolver::Data
+{
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<std::shared_ptr<Result>> queue;
+	std::unordered_map<std::string, CacheEntry> cache;
+	std::vector<std::thread> threads;
+	size_t max_threads;
+	size_t idle_threads = 0;
+	size_t sweep_threshold = 64; // cache size at which expired entries are next swept
+	std::chrono::seconds ttl;
+	std::chrono::seconds negative_ttl;
+	bool running = true;
+
+	static std::string make_key(const char *hostname, unsigned short port);
+	void sweep(std::chrono::steady_clock::time_point now);
+	void worker_loop();
+};
+
+std::string Jupiter::Resolver::Data::make_key(const char *hostname, unsigned short port)
+{
+	std::string key = hostname;
+	key += '/';
+	key += std::to_string(port);
+	return key;
+}
+
+void Jupiter::Resolver::Data::sweep(std::chrono::steady_clock::time_point now)
+{
+	auto itr = cache.begin();
+	while (itr != cache.end())
+	{
+		if (itr->second.expires <= now)
+			itr = cache.erase(itr);
+		else
+			++itr;
+	}
+
+	sweep_threshold = cache.size() * 2 > 64 ? cache.size() * 2 : 64;
+}
+
+void Jupiter::Resolver::Data::worker_loop()
+{
+	std::shared_ptr<Result> result;
+	addrinfo *info;
+	int error;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		++idle_threads;
+		condition.wait(lock, [this] { return running == false || queue.empty() == false; });
+		--idle_threads;
+
+		if (running == false)
+			return;
+
+		result = std::move(queue.front());
+		queue.pop_front();
+		lock.unlock();
+
+		info = nullptr;
+		error = getaddrinfo(result->getHostname(), std::to_string(result->getPort()).c_str(), nullptr, &info);
+		if (error != 0)
+			info = nullptr;
+
+		lock.lock();
+
+		// Start the entry's TTL, unless it was removed (i.e: by clear()) while resolving
+		auto itr = cache.find(make_key(result->getHostname(), result->getPort()));
+		if (itr != cache.end() && itr->second.result == result)
+			itr->second.expires = std::chrono::steady_clock::now() + (error == 0 ? ttl : negative_ttl);
+
+		result->data_->complete(info, error);
+		result.reset();
+	}
+}
+
+std::shared_ptr<Jupiter::Resolver::Result> Jupiter::Resolver::resolve(const char *hostname, unsigned short port)
+{
+	std::string key = Data::make_key(hostname, port);
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> guard(Jupiter::Resolver::data_->mutex);
+
+	auto itr = Jupiter::Resolver::data_->cache.find(key);
+	if (itr != Jupiter::Resolver::data_->cache.end())
+	{
+		if (itr->second.expires > now) // fresh, or still being resolved
+			return itr->second.result;
+
+		Jupiter::Resolver::data_->cache.erase(itr);
+	}
+
+	if (Jupiter::Resolver::data_->cache.size() >= Jupiter::Resolver::data_->sweep_threshold)
+		Jupiter::Resolver::data_->sweep(now);
+
+	std::shared_ptr<Result> result = std::make_shared<Result>(hostname, port);
+	Jupiter::Resolver::data_->cache[key].result = result;
+	Jupiter::Resolver::data_->queue.push_back(result);
+
+	// Start another thread if every existing one is busy
+	if (Jupiter::Resolver::data_->idle_threads < Jupiter::Resolver::data_->queue.size() && Jupiter::Resolver::data_->threads.size() < Jupiter::Resolver::data_->max_threads)
+		Jupiter::Resolver::data_->threads.emplace_back(&Data::worker_loop, Jupiter::Resolver::data_);
+
+	Jupiter::Resolver::data_->condition.notify_one();
+
+	return result;
+}
+
+void Jupiter::Resolver::setTTL(std::chrono::seconds in_ttl)
+{
+	std::lock_guard<std::mutex> guard(Jupiter::Resolver::data_->mutex);
+	Jupiter::Resolver::data_->ttl = in_ttl;
+}
+
+void Jupiter::Resolver::setNegativeTTL(std::chrono::seconds in_ttl)
+{
+	std::lock_guard<std::mutex> guard(Jupiter::Resolver::data_->mutex);
+	Jupiter::Resolver::data_->negative_ttl = in_ttl;
+}
+
+void Jupiter::Resolver::clear()
+{
+	std::lock_guard<std::mutex> guard(Jupiter::Resolver::data_->mutex);
+	Jupiter::Resolver::data_->cache.clear();
+}
+
+Jupiter::Resolver &Jupiter::Resolver::getDefault()
+{
+	static Jupiter::Resolver resolver;
+	return resolver;
+}
+
+Jupiter::Resolver::Resolver(size_t in_threads, std::chrono::seconds in_ttl, std::chrono::seconds in_negative_ttl)
+{
+	Jupiter::Resolver::data_ = new Data();
+	Jupiter::Resolver::data_->max_threads = in_threads == 0 ? 1 : in_threads;
+	Jupiter::Resolver::data_->ttl = in_ttl;
+	Jupiter::Resolver::data_->negative_ttl = in_negative_ttl;
+
+#if defined _WIN32
+	// getaddrinfo() requires Winsock to be initialized; WSAStartup() is reference counted
+	WSADATA wsadata;
+	WSAStartup(MAKEWORD(2, 2), &wsadata);
+#endif // _WIN32
+}
+
+Jupiter::Resolver::~Resolver()
+{
+	{
+		std::lock_guard<std::mutex> guard(Jupiter::Resolver::data_->mutex);
+		Jupiter::Resolver::data_->running = false;
+	}
+	Jupiter::Resolver::data_->condition.notify_all();
+
+	for (auto &thread : Jupiter::Resolver::data_->threads)
+		thread.join();
+
+	// Fail anything which never started, so that nobody waits on it forever
+	for (auto &result : Jupiter::Resolver::data_->queue)
+		result->data_->complete(nullptr, EAI_AGAIN);
+
+	delete Jupiter::Resolver::data_;
+
+#if defined _WIN32
+	WSACleanup();
+#endif // _WIN32
+}
@@ -0,0 +1,177 @@
+/**
+ * Copyright (C) 2017 Jessica James.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Written by Jessica James <jessica.aj@outlook.com>
+ */
+
+#if !defined _RESOLVER_H_HEADER
+#define _RESOLVER_H_HEADER
+
+/**
+ * @file Resolver.h
+ * @brief Provides non-blocking, cached hostname resolution.
+ */
+
+#include <memory>
+#include <chrono>
+#include "Jupiter.h"
+
+struct addrinfo;
+
+namespace Jupiter
+{
+	/**
+	* @brief Resolves hostnames on a pool of background threads, and caches the results.
+	* Successful results are cached for the resolver's TTL, and failures for its negative TTL, so that
+	* repeated connections to the same host (i.e: reconnect storms) do not re-resolve it.
+	* Note: getaddrinfo() does not expose record TTLs, so a fixed TTL is used.
+	*/
+	class JUPITER_API Resolver
+	{
+	public:
+		/**
+		* @brief The result of resolving a hostname and port. Results are shared between everyone who requested them.
+		*/
+		class JUPITER_API Result
+		{
+		public:
+			/**
+			* @brief Checks if resolution has completed.
+			*
+			* @return True if the result is available, false if resolution is still in progress.
+			*/
+			bool isReady() const;
+
+			/**
+			* @brief Blocks until resolution has completed.
+			*/
+			void wait() const;
+
+			/**
+			* @brief Fetches the resolved address list.
+			* Note: This must not be freed, and is only valid while the Result is.
+			*
+			* @return Resolved addresses if resolution succeeded, nullptr otherwise (or if still in progress).
+			*/
+			addrinfo *getInfo() const;
+
+			/**
+			* @brief Fetches the error returned by getaddrinfo().
+			*
+			* @return 0 if resolution succeeded or is still in progress, a getaddrinfo() error code otherwise.
+			*/
+			int getError() const;
+
+			/**
+			* @brief Fetches the hostname which was resolved.
+			*
+			* @return Hostname.
+			*/
+			const char *getHostname() const;
+
+			/**
+			* @brief Fetches the port which was resolved.
+			*
+			* @return Port.
+			*/
+			unsigned short getPort() const;
+
+			/**
+			* @brief Constructor for the Result class.
+			*/
+			Result(const char *in_hostname, unsigned short in_port);
+
+			/**
+			* @brief Copying a Result is forbidden.
+			*/
+			Result(const Result &) = delete;
+
+			/**
+			* @brief Destructor for the Result class.
+			*/
+			~Result();
+
+		/** Private members */
+		private:
+			friend class Resolver;
+			struct Data;
+			Data *data_;
+		};
+
+		/**
+		* @brief Resolves a hostname and port, without blocking.
+		* If a fresh result is cached (or the same resolution is already in progress), it is returned instead.
+		*
+		* @param hostname Hostname to resolve
+		* @param port Port to resolve
+		* @return Shared result, which is populated once resolution completes.
+		*/
+		std::shared_ptr<Result> resolve(const char *hostname, unsigned short port);
+
+		/**
+		* @brief Sets how long successful results are cached for.
+		*
+		* @param in_ttl Time to cache successful results for
+		*/
+		void setTTL(std::chrono::seconds in_ttl);
+
+		/**
+		* @brief Sets how long failed results are cached for.
+		*
+		* @param in_ttl Time to cache failed results for
+		*/
+		void setNegativeTTL(std::chrono::seconds in_ttl);
+
+		/**
+		* @brief Removes all cached results. Resolutions in progress are unaffected.
+		*/
+		void clear();
+
+		/**
+		* @brief Fetches the resolver which is shared by all sockets.
+		*
+		* @return Default resolver.
+		*/
+		static Resolver &getDefault();
+
+		/**
+		* @brief Constructor for the Resolver class.
+		* Note: Threads are only started once they are needed.
+		*
+		* @param in_threads Maximum number of concurrent resolutions
+		* @param in_ttl Time to cache successful results for
+		* @param in_negative_ttl Time to cache failed results for
+		*/
+		Resolver(size_t in_threads = 4, std::chrono::seconds in_ttl = std::chrono::seconds(300), std::chrono::seconds in_negative_ttl = std::chrono::seconds(30));
+
+		/**
+		* @brief Copying a Resolver is forbidden.
+		*/
+		Resolver(const Resolver &) = delete;
+
+		/**
+		* @brief Destructor for the Resolver class.
+		* Resolutions which have not started yet are completed with an error.
+		*/
+		~Resolver();
+
+	/** Private members */
+	private:
+		struct Data;
+		Data *data_;
+	}; // Jupiter::Resolver class
+} // Jupiter namespace
+
+#endif // _RESOLVER_H_HEADER
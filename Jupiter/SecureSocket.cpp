@@ -17,24 +17,84 @@
  */
 
 #include <utility> // std::move
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#if defined _WIN32
+#include <WinSock2.h>
+#else // _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <poll.h>
+#endif // _WIN32
 #include <openssl/ssl.h> // OpenSSL SSL functions
 #include <openssl/err.h> // OpenSSL SSL errors
 #include "SecureSocket.h"
 #include "CString.h"
 
+/** How long closing a connection waits for its offloaded writes before shutting the descriptor down */
+static constexpr std::chrono::milliseconds offload_linger{ 1000 };
+
+namespace
+{
+	/** State for a connection whose encryption is offloaded to a worker pool */
+	struct Offload
+	{
+		Jupiter::Socket::SocketType descriptor;
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::string plaintext; // decrypted by the strand; returned by the next recv()
+		size_t reads = 0; // ciphertext posted to the strand which has not yet been decrypted
+		int read_result = 1; // result of the last failed read (0 if the connection was closed); 1 if none
+		int read_error = 0; // error code of the last failed read
+		bool failed = false; // the strand failed to decrypt or write; the connection is unusable
+		Jupiter::WorkerPool::Strand strand; // every SSL call for the connection runs here, in order; declared last, so that it's destroyed (and waited on) first
+
+		void stop();
+		Offload(Jupiter::WorkerPool &in_pool, Jupiter::Socket::SocketType in_descriptor) : descriptor(in_descriptor), strand(in_pool) {}
+	};
+}
+
 struct Jupiter::SecureSocket::SSLData
 {
 	SSL *handle = nullptr;
     SSL_CTX *context = nullptr;
-	const SSL_METHOD *method = nullptr;
 	Jupiter::SecureSocket::EncryptionMethod eMethod = ANY;
 	Jupiter::CStringS cert;
 	Jupiter::CStringS key;
+	std::shared_ptr<Jupiter::SecureSocket::Context> shared_context; // used instead of 'context' when set
+	bool drain_mode = false;
+	bool kernel_tls = true;
+	Jupiter::WorkerPool *offload_pool = nullptr; // used by the next initSSL()
+	Offload *offload = nullptr;
+	void decrypt(const std::string &ciphertext);
+	void encrypt(const std::string &plaintext);
 	~SSLData();
 };
 
+struct Jupiter::SecureSocket::Context::Data
+{
+	SSL_CTX *context = nullptr;
+	SSL_SESSION *session = nullptr; // last session established through this context; offered for resumption
+	Jupiter::SecureSocket::EncryptionMethod eMethod;
+	Jupiter::CStringS cert;
+	Jupiter::CStringS key;
+	std::mutex mutex;
+
+	SSL_CTX *get_context();
+	void resume(SSL *handle);
+	void save(SSL *handle);
+	~Data();
+};
+
 Jupiter::SecureSocket::SSLData::~SSLData()
 {
+	if (Jupiter::SecureSocket::SSLData::offload != nullptr)
+	{
+		Jupiter::SecureSocket::SSLData::offload->stop();
+		delete Jupiter::SecureSocket::SSLData::offload;
+	}
 	if (Jupiter::SecureSocket::SSLData::handle != nullptr)
 	{
 		if (SSL_shutdown(Jupiter::SecureSocket::SSLData::handle) == 0) SSL_shutdown(Jupiter::SecureSocket::SSLData::handle);
@@ -43,6 +103,210 @@ Jupiter::SecureSocket::SSLData::~SSLData()
 	if (Jupiter::SecureSocket::SSLData::context != nullptr) SSL_CTX_free(Jupiter::SecureSocket::SSLData::context);
 }
 
+/** Offloading */
+
+/** Waits for a (possibly non-blocking) descriptor to become ready */
+static bool wait_for(Jupiter::Socket::SocketType descriptor, short events)
+{
+#if defined _WIN32
+	WSAPOLLFD poll_fd;
+	poll_fd.fd = descriptor;
+	poll_fd.events = events;
+	poll_fd.revents = 0;
+	return WSAPoll(&poll_fd, 1, -1) > 0;
+#else // _WIN32
+	pollfd poll_fd;
+	poll_fd.fd = descriptor;
+	poll_fd.events = events;
+	poll_fd.revents = 0;
+	return poll(&poll_fd, 1, -1) > 0;
+#endif // _WIN32
+}
+
+/** Writes every record SSL has produced to the descriptor */
+static bool write_ciphertext(SSL *handle, Jupiter::Socket::SocketType descriptor)
+{
+	BIO *wbio = SSL_get_wbio(handle);
+	char buffer[16384];
+	int length, offset, sent;
+	while ((length = BIO_read(wbio, buffer, sizeof(buffer))) > 0)
+	{
+		offset = 0;
+		while (offset != length)
+		{
+#if defined MSG_NOSIGNAL
+			sent = ::send(descriptor, buffer + offset, length - offset, MSG_NOSIGNAL); // fails rather than raising SIGPIPE once stop() shuts the descriptor down
+#else // MSG_NOSIGNAL
+			sent = ::send(descriptor, buffer + offset, length - offset, 0);
+#endif // MSG_NOSIGNAL
+			if (sent > 0)
+				offset += sent;
+			else if (sent == 0 || Jupiter::Socket::isWouldBlock() == false || wait_for(descriptor, POLLOUT) == false)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/** Performs a client handshake through memory BIOs, shuttling records over the descriptor */
+static bool handshake(SSL *handle, Jupiter::Socket::SocketType descriptor)
+{
+	char buffer[16384];
+	int result, length;
+
+	SSL_set_connect_state(handle);
+	while ((result = SSL_do_handshake(handle)) != 1)
+	{
+		if (SSL_get_error(handle, result) != SSL_ERROR_WANT_READ || write_ciphertext(handle, descriptor) == false)
+			return false;
+
+		length = ::recv(descriptor, buffer, sizeof(buffer), 0);
+		if (length < 0 && Jupiter::Socket::isWouldBlock() && wait_for(descriptor, POLLIN))
+			continue;
+		if (length <= 0)
+			return false;
+
+		BIO_write(SSL_get_rbio(handle), buffer, length);
+	}
+
+	return write_ciphertext(handle, descriptor); // final flight
+}
+
+/** Waits for the strand to finish; a task stuck writing to an unresponsive peer is unblocked by shutting the descriptor down */
+void Offload::stop()
+{
+	if (strand.wait(offload_linger) == false)
+	{
+#if defined _WIN32
+		::shutdown(descriptor, SD_BOTH);
+#else // _WIN32
+		::shutdown(descriptor, SHUT_RDWR);
+#endif // _WIN32
+		strand.wait();
+	}
+}
+
+void Jupiter::SecureSocket::SSLData::decrypt(const std::string &ciphertext)
+{
+	std::string decrypted;
+	char buffer[16384];
+	int length;
+	int result = 1;
+
+	BIO_write(SSL_get_rbio(handle), ciphertext.data(), ciphertext.size());
+	while ((length = SSL_read(handle, buffer, sizeof(buffer))) > 0)
+		decrypted.append(buffer, length);
+
+	switch (SSL_get_error(handle, length))
+	{
+	case SSL_ERROR_WANT_READ: // consumed everything
+		break;
+	case SSL_ERROR_ZERO_RETURN: // close_notify
+		result = 0;
+		break;
+	default:
+		result = -1;
+		break;
+	}
+
+	// Reading may also produce records to send (i.e: key updates)
+	if (write_ciphertext(handle, offload->descriptor) == false)
+		result = -1;
+
+	std::lock_guard<std::mutex> guard(offload->mutex);
+	offload->plaintext += decrypted;
+	if (result == 0)
+		offload->read_result = 0;
+	else if (result < 0)
+		offload->failed = true;
+	--offload->reads;
+	offload->condition.notify_all();
+}
+
+void Jupiter::SecureSocket::SSLData::encrypt(const std::string &plaintext)
+{
+	if (SSL_write(handle, plaintext.data(), plaintext.size()) <= 0 || write_ciphertext(handle, offload->descriptor) == false)
+	{
+		std::lock_guard<std::mutex> guard(offload->mutex);
+		offload->failed = true;
+	}
+}
+
+/** Context */
+
+void Jupiter::SecureSocket::Context::Data::resume(SSL *handle)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	if (session != nullptr)
+		SSL_set_session(handle, session);
+}
+
+void Jupiter::SecureSocket::Context::Data::save(SSL *handle)
+{
+	SSL_SESSION *latest = SSL_get1_session(handle);
+	if (latest == nullptr)
+		return;
+
+	std::lock_guard<std::mutex> guard(mutex);
+	if (session != nullptr)
+		SSL_SESSION_free(session);
+	session = latest;
+}
+
+Jupiter::SecureSocket::Context::Data::~Data()
+{
+	if (session != nullptr)
+		SSL_SESSION_free(session);
+	if (context != nullptr)
+		SSL_CTX_free(context);
+}
+
+Jupiter::SecureSocket::EncryptionMethod Jupiter::SecureSocket::Context::getMethod() const
+{
+	return Jupiter::SecureSocket::Context::data_->eMethod;
+}
+
+void Jupiter::SecureSocket::Context::setCertificate(const Jupiter::ReadableString &cert, const Jupiter::ReadableString &key)
+{
+	Jupiter::SecureSocket::Context::data_->cert = cert;
+	Jupiter::SecureSocket::Context::data_->key = key;
+}
+
+void Jupiter::SecureSocket::Context::setCertificate(const Jupiter::ReadableString &pem)
+{
+	Jupiter::SecureSocket::Context::setCertificate(pem, pem);
+}
+
+bool Jupiter::SecureSocket::Context::hasSession() const
+{
+	std::lock_guard<std::mutex> guard(Jupiter::SecureSocket::Context::data_->mutex);
+	return Jupiter::SecureSocket::Context::data_->session != nullptr;
+}
+
+void Jupiter::SecureSocket::Context::clearSession()
+{
+	std::lock_guard<std::mutex> guard(Jupiter::SecureSocket::Context::data_->mutex);
+	if (Jupiter::SecureSocket::Context::data_->session != nullptr)
+	{
+		SSL_SESSION_free(Jupiter::SecureSocket::Context::data_->session);
+		Jupiter::SecureSocket::Context::data_->session = nullptr;
+	}
+}
+
+Jupiter::SecureSocket::Context::Context(Jupiter::SecureSocket::EncryptionMethod method)
+{
+	Jupiter::SecureSocket::Context::data_ = new Data();
+	Jupiter::SecureSocket::Context::data_->eMethod = method;
+}
+
+Jupiter::SecureSocket::Context::~Context()
+{
+	delete Jupiter::SecureSocket::Context::data_;
+}
+
+/** SecureSocket */
+
 Jupiter::SecureSocket &Jupiter::SecureSocket::operator=(Jupiter::SecureSocket &&source)
 {
 	Jupiter::Socket::operator=(std::move(source));
@@ -64,6 +328,7 @@ Jupiter::SecureSocket::SecureSocket(size_t bufferSize) : Jupiter::Socket(bufferS
 Jupiter::SecureSocket::SecureSocket(Jupiter::Socket &&source) : Jupiter::Socket(std::move(source))
 {
 	Jupiter::SecureSocket::SSLdata_ = new Jupiter::SecureSocket::SSLData();
+	Jupiter::Socket::setIOUring(nullptr); // SSL needs direct access to the descriptor
 }
 
 Jupiter::SecureSocket::SecureSocket(Jupiter::SecureSocket &&source) : Jupiter::Socket(std::move(source))
@@ -98,7 +363,21 @@ bool Jupiter::SecureSocket::bind(const char *hostname, unsigned short iPort, boo
 
 void Jupiter::SecureSocket::shutdown()
 {
+	if (Jupiter::SecureSocket::SSLdata_ != nullptr && Jupiter::SecureSocket::SSLdata_->offload != nullptr && Jupiter::SecureSocket::SSLdata_->handle != nullptr)
+	{
+		// Send close_notify through the memory BIO while the descriptor can still be written to; skipped if the peer isn't
+		// accepting data, since Socket::shutdown() below unblocks the strand
+		if (Jupiter::SecureSocket::SSLdata_->offload->strand.wait(offload_linger))
+		{
+			SSL_shutdown(Jupiter::SecureSocket::SSLdata_->handle);
+			write_ciphertext(Jupiter::SecureSocket::SSLdata_->handle, Jupiter::SecureSocket::SSLdata_->offload->descriptor);
+		}
+	}
+
 	Jupiter::Socket::shutdown();
+	if (Jupiter::SecureSocket::SSLdata_ != nullptr && Jupiter::SecureSocket::SSLdata_->offload != nullptr)
+		Jupiter::SecureSocket::SSLdata_->offload->strand.wait(); // unblocked by the shutdown, if it timed out above
+
 	if (Jupiter::SecureSocket::SSLdata_ != nullptr && Jupiter::SecureSocket::SSLdata_->handle != nullptr)
 	{
 		if (SSL_shutdown(Jupiter::SecureSocket::SSLdata_->handle) == 0)
@@ -108,14 +387,26 @@ void Jupiter::SecureSocket::shutdown()
 
 void Jupiter::SecureSocket::close()
 {
+	if (Jupiter::SecureSocket::SSLdata_ != nullptr && Jupiter::SecureSocket::SSLdata_->offload != nullptr)
+		Jupiter::SecureSocket::SSLdata_->offload->stop();
+
 	Jupiter::Socket::close();
 	if (Jupiter::SecureSocket::SSLdata_ != nullptr && Jupiter::SecureSocket::SSLdata_->handle != nullptr)
 	{
+		// Keep the latest session; TLS 1.3 tickets only arrive after the handshake
+		if (Jupiter::SecureSocket::SSLdata_->shared_context != nullptr && SSL_is_init_finished(Jupiter::SecureSocket::SSLdata_->handle))
+			Jupiter::SecureSocket::SSLdata_->shared_context->data_->save(Jupiter::SecureSocket::SSLdata_->handle);
+
 		if (SSL_shutdown(Jupiter::SecureSocket::SSLdata_->handle) == 0)
 			SSL_shutdown(Jupiter::SecureSocket::SSLdata_->handle);
 		SSL_free(Jupiter::SecureSocket::SSLdata_->handle);
 		Jupiter::SecureSocket::SSLdata_->handle = nullptr;
 	}
+	if (Jupiter::SecureSocket::SSLdata_ != nullptr)
+	{
+		delete Jupiter::SecureSocket::SSLdata_->offload;
+		Jupiter::SecureSocket::SSLdata_->offload = nullptr;
+	}
 }
 
 const SSL_METHOD *translateEncryptionMethod(Jupiter::SecureSocket::EncryptionMethod method)
@@ -144,6 +435,21 @@ const char *Jupiter::SecureSocket::getCipherName() const
 	return SSL_CIPHER_get_name(SSL_get_current_cipher(Jupiter::SecureSocket::SSLdata_->handle));
 }
 
+bool Jupiter::SecureSocket::isSessionReused() const
+{
+	return Jupiter::SecureSocket::SSLdata_->handle != nullptr && SSL_session_reused(Jupiter::SecureSocket::SSLdata_->handle) != 0;
+}
+
+void Jupiter::SecureSocket::setContext(const std::shared_ptr<Jupiter::SecureSocket::Context> &in_context)
+{
+	Jupiter::SecureSocket::SSLdata_->shared_context = in_context;
+}
+
+const std::shared_ptr<Jupiter::SecureSocket::Context> &Jupiter::SecureSocket::getContext() const
+{
+	return Jupiter::SecureSocket::SSLdata_->shared_context;
+}
+
 Jupiter::SecureSocket::EncryptionMethod Jupiter::SecureSocket::getMethod() const
 {
 	return Jupiter::SecureSocket::SSLdata_->eMethod;
@@ -176,6 +482,34 @@ bool loadCertificate(SSL_CTX *context, const char *cert, const char *key)
 	return true;
 }
 
+/** Creates a context for the specified method, loading a certificate if one is specified */
+static SSL_CTX *create_context(Jupiter::SecureSocket::EncryptionMethod in_method, const Jupiter::CStringS &cert, const Jupiter::CStringS &key)
+{
+	const SSL_METHOD *method = translateEncryptionMethod(in_method);
+	if (method == nullptr)
+		return nullptr;
+
+	SSL_CTX *context = SSL_CTX_new(method);
+	if (context == nullptr)
+	{
+		ERR_print_errors_fp(stderr);
+		return nullptr;
+	}
+	if (cert.isNotEmpty())
+		loadCertificate(context, cert.c_str(), key.c_str());
+
+	return context;
+}
+
+SSL_CTX *Jupiter::SecureSocket::Context::Data::get_context()
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	if (context == nullptr)
+		context = create_context(eMethod, cert, key);
+
+	return context;
+}
+
 void Jupiter::SecureSocket::setCertificate(const Jupiter::ReadableString &cert, const Jupiter::ReadableString &key)
 {
 	Jupiter::SecureSocket::SSLdata_->cert = cert;
@@ -192,9 +526,27 @@ bool Jupiter::SecureSocket::connect(const char *hostname, unsigned short iPort,
 	return Jupiter::Socket::connect(hostname, iPort, clientAddress, clientPort) && this->initSSL();
 }
 
+bool Jupiter::SecureSocket::connect(const Jupiter::Resolver::Result &address, const char *clientAddress, unsigned short clientPort)
+{
+	return Jupiter::Socket::connect(address, clientAddress, clientPort) && this->initSSL();
+}
+
+int Jupiter::SecureSocket::pollConnect(std::chrono::milliseconds timeout)
+{
+	bool connecting = this->isConnecting();
+	int result = Jupiter::Socket::pollConnect(timeout);
+	if (connecting && result > 0 && this->initSSL() == false)
+	{
+		this->close();
+		return -1;
+	}
+
+	return result;
+}
+
 int Jupiter::SecureSocket::peek()
 {
-	if (Jupiter::SecureSocket::SSLdata_->handle == nullptr)
+	if (Jupiter::SecureSocket::SSLdata_->handle == nullptr || Jupiter::SecureSocket::SSLdata_->offload != nullptr)
 		return -1;
 	Jupiter::Socket::Buffer &buffer = this->getInternalBuffer();
 	buffer.erase();
@@ -208,64 +560,305 @@ int Jupiter::SecureSocket::recv()
 {
 	if (Jupiter::SecureSocket::SSLdata_->handle == nullptr)
 		return -1;
-	Jupiter::Socket::Buffer &buffer = this->getInternalBuffer();
-	buffer.erase();
-	int r = SSL_read(Jupiter::SecureSocket::SSLdata_->handle, buffer.get_str(), this->getBufferSize());
+
+	Offload *offload = Jupiter::SecureSocket::SSLdata_->offload;
+	if (offload != nullptr)
+	{
+		while (true)
+		{
+			std::unique_lock<std::mutex> lock(offload->mutex);
+			offload->condition.wait(lock, [offload] { return offload->reads == 0; });
+			if (offload->plaintext.empty() == false)
+			{
+				size_t capacity;
+				this->prepareRecv(capacity);
+				Jupiter::Socket::Buffer &buffer = this->getInternalBuffer();
+				buffer.reserve_tail(offload->plaintext.size());
+				memcpy(buffer.get_tail(), offload->plaintext.data(), offload->plaintext.size());
+				buffer.set_length(buffer.size() + offload->plaintext.size());
+
+				int result = static_cast<int>(offload->plaintext.size());
+				offload->plaintext.clear();
+				return result;
+			}
+			if (offload->failed)
+				return -1;
+			if (offload->read_result != 1)
+			{
+				int result = offload->read_result;
+				offload->read_result = 1;
+#if defined _WIN32
+				WSASetLastError(offload->read_error);
+#else // _WIN32
+				errno = offload->read_error;
+#endif // _WIN32
+				return result;
+			}
+			lock.unlock();
+
+			// Nothing decrypted yet (or only part of a record); read more
+			Jupiter::SecureSocket::prefetch();
+		}
+	}
+
+	size_t capacity;
+	char *output = this->prepareRecv(capacity);
+	int r = SSL_read(Jupiter::SecureSocket::SSLdata_->handle, output, capacity);
 	if (r > 0)
-		buffer.set_length(r);
+	{
+		Jupiter::Socket::Buffer &buffer = this->getInternalBuffer();
+		buffer.set_length(buffer.size() + r);
+
+		// Read the rest of what SSL has already decrypted, growing the buffer as needed
+		if (Jupiter::SecureSocket::SSLdata_->drain_mode)
+		{
+			int pending, extra;
+			while ((pending = SSL_pending(Jupiter::SecureSocket::SSLdata_->handle)) > 0)
+			{
+				buffer.reserve_tail(pending);
+				extra = SSL_read(Jupiter::SecureSocket::SSLdata_->handle, buffer.get_tail(), pending);
+				if (extra <= 0)
+					break;
+
+				buffer.set_length(buffer.size() + extra);
+				r += extra;
+			}
+		}
+	}
 	return r;
 }
 
-int Jupiter::SecureSocket::send(const char *data, size_t datalen)
+int Jupiter::SecureSocket::sendFile(int in_file, size_t in_offset, size_t in_length)
 {
-	return SSL_write(Jupiter::SecureSocket::SSLdata_->handle, data, datalen);
+#if defined SSL_OP_ENABLE_KTLS
+	// The kernel encrypts the file as it's sent; anything already queued (or gathered) must be sent first
+	if (Jupiter::SecureSocket::isKernelTLSSend() && this->isCorked() == false && this->getQueuedSize() == 0)
+	{
+		ossl_ssize_t result = SSL_sendfile(Jupiter::SecureSocket::SSLdata_->handle, in_file, in_offset, in_length, 0);
+		return result < 0 ? -1 : static_cast<int>(result);
+	}
+#endif // SSL_OP_ENABLE_KTLS
+
+	// Never send the file directly; it must be encrypted
+	return Jupiter::Socket::sendFileCopy(in_file, in_offset, in_length);
 }
 
-bool Jupiter::SecureSocket::initSSL()
+void Jupiter::SecureSocket::setKernelTLS(bool in_kernel_tls)
+{
+	Jupiter::SecureSocket::SSLdata_->kernel_tls = in_kernel_tls;
+}
+
+bool Jupiter::SecureSocket::getKernelTLS() const
 {
-	SSL_load_error_strings();
-	SSL_library_init();
+	return Jupiter::SecureSocket::SSLdata_->kernel_tls;
+}
+
+bool Jupiter::SecureSocket::isKernelTLSSend() const
+{
+#if defined SSL_OP_ENABLE_KTLS
+	return Jupiter::SecureSocket::SSLdata_->handle != nullptr && Jupiter::SecureSocket::SSLdata_->offload == nullptr && BIO_get_ktls_send(SSL_get_wbio(Jupiter::SecureSocket::SSLdata_->handle)) != 0;
+#else // SSL_OP_ENABLE_KTLS
+	return false;
+#endif // SSL_OP_ENABLE_KTLS
+}
+
+bool Jupiter::SecureSocket::isKernelTLSRecv() const
+{
+#if defined SSL_OP_ENABLE_KTLS
+	return Jupiter::SecureSocket::SSLdata_->handle != nullptr && Jupiter::SecureSocket::SSLdata_->offload == nullptr && BIO_get_ktls_recv(SSL_get_rbio(Jupiter::SecureSocket::SSLdata_->handle)) != 0;
+#else // SSL_OP_ENABLE_KTLS
+	return false;
+#endif // SSL_OP_ENABLE_KTLS
+}
+
+bool Jupiter::SecureSocket::prefetch()
+{
+	Offload *offload = Jupiter::SecureSocket::SSLdata_->offload;
+	if (offload == nullptr)
+		return false;
+
+	char buffer[16384];
+	int length = ::recv(offload->descriptor, buffer, sizeof(buffer), 0);
+	if (length <= 0)
+	{
+		std::lock_guard<std::mutex> guard(offload->mutex);
+		offload->read_result = length;
+		offload->read_error = Jupiter::Socket::getLastError();
+		return true;
+	}
 
-	if (Jupiter::SecureSocket::SSLdata_->context == nullptr)
+	SSLData *ssl_data = Jupiter::SecureSocket::SSLdata_;
+	std::string ciphertext(buffer, length);
+	{
+		std::lock_guard<std::mutex> guard(offload->mutex);
+		++offload->reads;
+	}
+	offload->strand.post([ssl_data, ciphertext] { ssl_data->decrypt(ciphertext); });
+	return true;
+}
+
+void Jupiter::SecureSocket::setOffload(Jupiter::WorkerPool *in_pool)
+{
+	Jupiter::SecureSocket::SSLdata_->offload_pool = in_pool;
+}
+
+Jupiter::WorkerPool *Jupiter::SecureSocket::getOffload() const
+{
+	return Jupiter::SecureSocket::SSLdata_->offload_pool;
+}
+
+void Jupiter::SecureSocket::setDrainMode(bool in_drain_mode)
+{
+	Jupiter::SecureSocket::SSLdata_->drain_mode = in_drain_mode;
+}
+
+bool Jupiter::SecureSocket::getDrainMode() const
+{
+	return Jupiter::SecureSocket::SSLdata_->drain_mode;
+}
+
+bool Jupiter::SecureSocket::hasPendingData() const
+{
+	Offload *offload = Jupiter::SecureSocket::SSLdata_->offload;
+	if (offload != nullptr)
+	{
+		std::lock_guard<std::mutex> guard(offload->mutex);
+		return offload->plaintext.empty() == false || offload->reads != 0;
+	}
+
+	return Jupiter::SecureSocket::SSLdata_->handle != nullptr && SSL_pending(Jupiter::SecureSocket::SSLdata_->handle) > 0;
+}
+
+bool Jupiter::SecureSocket::setIOUring(Jupiter::IOUring *in_uring)
+{
+	if (in_uring != nullptr)
+		return false;
+
+	return Jupiter::Socket::setIOUring(nullptr);
+}
+
+int Jupiter::SecureSocket::transmit(const char *data, size_t datalen)
+{
+	Offload *offload = Jupiter::SecureSocket::SSLdata_->offload;
+	if (offload != nullptr)
 	{
-		if (Jupiter::SecureSocket::SSLdata_->method == nullptr)
 		{
-			Jupiter::SecureSocket::SSLdata_->method = translateEncryptionMethod(Jupiter::SecureSocket::SSLdata_->eMethod);
-			if (Jupiter::SecureSocket::SSLdata_->method == nullptr)
-				return false;
+			std::lock_guard<std::mutex> guard(offload->mutex);
+			if (offload->failed)
+				return -1;
 		}
 
-		Jupiter::SecureSocket::SSLdata_->context = SSL_CTX_new(Jupiter::SecureSocket::SSLdata_->method);
-		if (Jupiter::SecureSocket::SSLdata_->context == nullptr)
+		// Encrypted and written by the strand, in order
+		SSLData *ssl_data = Jupiter::SecureSocket::SSLdata_;
+		std::string plaintext(data, datalen);
+		offload->strand.post([ssl_data, plaintext] { ssl_data->encrypt(plaintext); });
+		return static_cast<int>(datalen);
+	}
+
+	int result = SSL_write(Jupiter::SecureSocket::SSLdata_->handle, data, datalen);
+	if (result <= 0 && this->getQueueMode())
+	{
+		switch (SSL_get_error(Jupiter::SecureSocket::SSLdata_->handle, result))
 		{
-			ERR_print_errors_fp(stderr);
+		case SSL_ERROR_WANT_WRITE:
+		case SSL_ERROR_WANT_READ: // renegotiating; SSL_write() must be retried with the same data
+			return 0;
+		default:
+			return -1;
+		}
+	}
+
+	return result;
+}
+
+bool Jupiter::SecureSocket::initSSL()
+{
+	static std::once_flag library_init;
+	std::call_once(library_init, []
+	{
+		SSL_load_error_strings();
+		SSL_library_init();
+	});
+
+	SSL_CTX *context;
+	if (Jupiter::SecureSocket::SSLdata_->shared_context != nullptr)
+	{
+		context = Jupiter::SecureSocket::SSLdata_->shared_context->data_->get_context();
+		if (context == nullptr)
 			return false;
+	}
+	else
+	{
+		if (Jupiter::SecureSocket::SSLdata_->context == nullptr)
+		{
+			Jupiter::SecureSocket::SSLdata_->context = create_context(Jupiter::SecureSocket::SSLdata_->eMethod, Jupiter::SecureSocket::SSLdata_->cert, Jupiter::SecureSocket::SSLdata_->key);
+			if (Jupiter::SecureSocket::SSLdata_->context == nullptr)
+				return false;
 		}
-		if (Jupiter::SecureSocket::SSLdata_->cert.isNotEmpty())
-			loadCertificate(Jupiter::SecureSocket::SSLdata_->context, Jupiter::SecureSocket::SSLdata_->cert.c_str(), Jupiter::SecureSocket::SSLdata_->key.c_str());
+
+		context = Jupiter::SecureSocket::SSLdata_->context;
 	}
 
-	Jupiter::SecureSocket::SSLdata_->handle = SSL_new(Jupiter::SecureSocket::SSLdata_->context);
+	Jupiter::SecureSocket::SSLdata_->handle = SSL_new(context);
 	if (Jupiter::SecureSocket::SSLdata_->handle == nullptr)
 	{
 		ERR_print_errors_fp(stderr);
 		return false;
 	}
-	if (SSL_set_fd(Jupiter::SecureSocket::SSLdata_->handle, this->getDescriptor()) == 0)
+	if (Jupiter::SecureSocket::SSLdata_->offload_pool != nullptr)
+	{
+		// Records are shuttled between the descriptor and memory BIOs, so that SSL itself can run on any thread
+		SSL_set_bio(Jupiter::SecureSocket::SSLdata_->handle, BIO_new(BIO_s_mem()), BIO_new(BIO_s_mem()));
+	}
+	else if (SSL_set_fd(Jupiter::SecureSocket::SSLdata_->handle, this->getDescriptor()) == 0)
 	{
 		ERR_print_errors_fp(stderr);
 		return false;
 	}
+#if defined SSL_OP_ENABLE_KTLS
+	else if (Jupiter::SecureSocket::SSLdata_->kernel_tls)
+	{
+		// Hands record encryption to the kernel after the handshake, if it and the negotiated cipher support it; otherwise, SSL carries on in user space
+		SSL_set_options(Jupiter::SecureSocket::SSLdata_->handle, SSL_OP_ENABLE_KTLS);
+	}
+#endif // SSL_OP_ENABLE_KTLS
+
+	// A retried write may start elsewhere in the send queue's buffer, if it was moved while growing
+	SSL_set_mode(Jupiter::SecureSocket::SSLdata_->handle, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
 	if (SSL_set_tlsext_host_name(Jupiter::SecureSocket::SSLdata_->handle, this->getRemoteHostnameC()) != 1) // This error check is potentially redundant, but no documentation has been found.
 	{
 		ERR_print_errors_fp(stderr);
 		return false;
 	}
-	int t = SSL_connect(Jupiter::SecureSocket::SSLdata_->handle);
-	if (t != 1)
+
+	// Offer the last session established through the shared context, to skip the full handshake
+	if (Jupiter::SecureSocket::SSLdata_->shared_context != nullptr)
+		Jupiter::SecureSocket::SSLdata_->shared_context->data_->resume(Jupiter::SecureSocket::SSLdata_->handle);
+
+	if (Jupiter::SecureSocket::SSLdata_->offload_pool != nullptr)
+	{
+		// The handshake runs here; everything after it runs on the pool
+		if (handshake(Jupiter::SecureSocket::SSLdata_->handle, this->getDescriptor()) == false)
+		{
+			ERR_print_errors_fp(stderr);
+			return false;
+		}
+
+		delete Jupiter::SecureSocket::SSLdata_->offload;
+		Jupiter::SecureSocket::SSLdata_->offload = new Offload(*Jupiter::SecureSocket::SSLdata_->offload_pool, this->getDescriptor());
+	}
+	else
 	{
-		ERR_print_errors_fp(stderr);
-		return false;
+		int t = SSL_connect(Jupiter::SecureSocket::SSLdata_->handle);
+		if (t != 1)
+		{
+			ERR_print_errors_fp(stderr);
+			return false;
+		}
 	}
+
+	if (Jupiter::SecureSocket::SSLdata_->shared_context != nullptr)
+		Jupiter::SecureSocket::SSLdata_->shared_context->data_->save(Jupiter::SecureSocket::SSLdata_->handle);
 	return true;
 }
\ No newline at end of file
@@ -24,7 +24,9 @@
  * @brief Provides an OpenSSL implementation on the Socket interface.
  */
 
+#include <memory>
 #include "Socket.h"
+#include "WorkerPool.h"
 
 namespace Jupiter
 {
@@ -54,12 +56,97 @@ namespace Jupiter
 			END = 127	/** END OF ENUM */
 		};
 
+		/**
+		* @brief Client-side SSL state which can be shared between connections (i.e: every reconnection to a network).
+		* The SSL context (and its certificate) is only loaded once, and the last session established through it is
+		* offered to the server on the next connection, so that reconnections can skip the full handshake.
+		*/
+		class JUPITER_API Context
+		{
+		public:
+			/**
+			* @brief Returns the encryption method used by connections made through the context.
+			* @return Encryption method.
+			*/
+			EncryptionMethod getMethod() const;
+
+			/**
+			* @brief Sets the certificate and key to load when the context is first used.
+			*
+			* @param cert String containing file location of certificate.
+			* @param key String containing file location of private key.
+			*/
+			void setCertificate(const Jupiter::ReadableString &cert, const Jupiter::ReadableString &key);
+
+			/**
+			* @brief Sets the certificate and key to load when the context is first used.
+			*
+			* @param pem Combined certificate/key file.
+			*/
+			void setCertificate(const Jupiter::ReadableString &pem);
+
+			/**
+			* @brief Checks if the context has a session to offer for resumption.
+			*
+			* @return True if a session is stored, false otherwise.
+			*/
+			bool hasSession() const;
+
+			/**
+			* @brief Forgets the stored session, so that the next connection performs a full handshake.
+			*/
+			void clearSession();
+
+			/**
+			* @brief Constructor for the Context class.
+			*
+			* @param method Encryption method to use for connections made through the context.
+			*/
+			Context(EncryptionMethod method = ANY);
+
+			/**
+			* @brief Copying a Context is forbidden.
+			*/
+			Context(const Context &) = delete;
+
+			/**
+			* @brief Destructor for the Context class.
+			*/
+			~Context();
+
+		/** Private members */
+		private:
+			friend class SecureSocket;
+			struct Data;
+			Data *data_;
+		};
+
 		/**
 		* @brief Returns the name of the cipher currently in use.
 		* @return Name of cipher currently in use, or "NONE" if none is in use.
 		*/
 		const char *getCipherName() const;
 
+		/**
+		* @brief Checks if the current connection resumed a previous session, rather than performing a full handshake.
+		* @return True if the session was resumed, false otherwise.
+		*/
+		bool isSessionReused() const;
+
+		/**
+		* @brief Sets a shared context for the socket to use in place of its own.
+		* While a shared context is set, the socket's own method and certificate are ignored.
+		*
+		* @param in_context Shared context to use, or nullptr to use the socket's own
+		*/
+		void setContext(const std::shared_ptr<Context> &in_context);
+
+		/**
+		* @brief Returns the shared context used by the socket.
+		* @return Shared context if one is set, nullptr otherwise.
+		*/
+		const std::shared_ptr<Context> &getContext() const;
+
 		/**
 		* @brief Returns the encryption method that the socket attempts to use.
 		* This is ANY by default.
@@ -99,6 +186,23 @@ namespace Jupiter
 		*/
 		virtual bool connect(const char *hostname, unsigned short iPort, const char *clientAddress = nullptr, unsigned short clientPort = 0) override;
 
+		/**
+		* @brief Interface to provide simple connection establishing, using an address which has already been resolved.
+		*
+		* @param address Completed resolver result for the server to connect to.
+		* @param Address for client to bind to.
+		* @return True on success, false otherwise.
+		*/
+		virtual bool connect(const Jupiter::Resolver::Result &address, const char *clientAddress = nullptr, unsigned short clientPort = 0) override;
+
+		/**
+		* @brief Checks on a connection started by connectAsync(), and initializes SSL once it completes.
+		*
+		* @param timeout Maximum amount of time to wait for an attempt to complete
+		* @return 1 if the socket is connected, 0 if it is still connecting, -1 if every attempt (or SSL initialization) failed.
+		*/
+		virtual int pollConnect(std::chrono::milliseconds timeout = std::chrono::milliseconds(0)) override;
+
 		/**
 		* @brief Interface to provide simple binding to ports.
 		*
@@ -141,14 +245,106 @@ namespace Jupiter
 		virtual int recv() override;
 
 		/**
-		* @brief Sends data across the socket.
+		* @brief Sets whether or not recv() reads all of the data which SSL has already decrypted, rather than
+		* only what fits in the buffer. When enabled, the buffer grows as needed so that a burst (i.e: a large
+		* record) is returned by a single recv(), rather than across several iterations.
+		* Note: Only decrypted data is drained; this never reads further from the descriptor, so it never blocks.
+		*
+		* @param in_drain_mode True to drain decrypted data on each recv(), false otherwise
+		*/
+		void setDrainMode(bool in_drain_mode);
+
+		/**
+		* @brief Checks if recv() drains all decrypted data.
+		*
+		* @return True if drain mode is enabled, false otherwise.
+		*/
+		bool getDrainMode() const;
+
+		/**
+		* @brief Sets a worker pool to offload encryption and decryption to, for connections established by
+		* subsequent calls to initSSL(). When offloaded, SSL runs over memory BIOs: the calling thread only moves
+		* ciphertext between the descriptor and SSL, while SSL_read() and SSL_write() run on a strand of the pool,
+		* which keeps each connection's records in order. send() returns as soon as data is handed to the strand.
+		* Note: The handshake itself still runs on the thread calling initSSL().
 		*
-		* @param data String containing the data to be send.
-		* @param datalen The size of the data to be sent, in chars.
-		* @return Number of bytes sent on success, less than or equal to 0 otherwise.
-		* Note: Refer to SSL_write() for detailed return values.
+		* @param in_pool Pool to offload to, or nullptr to run SSL on the calling thread
 		*/
-		virtual int send(const char *data, size_t datalen) override;
+		void setOffload(Jupiter::WorkerPool *in_pool);
+
+		/**
+		* @brief Fetches the worker pool which encryption is offloaded to.
+		*
+		* @return Pool if offloading is enabled, nullptr otherwise.
+		*/
+		Jupiter::WorkerPool *getOffload() const;
+
+		/**
+		* @brief Reads available ciphertext from the descriptor, and starts decrypting it in the background; the
+		* next recv() returns the result. This lets an event loop start decrypting every readable connection before
+		* processing any of them. This should only be called when the descriptor is readable.
+		*
+		* @return True if the connection is offloaded (and a read was made), false otherwise.
+		*/
+		bool prefetch();
+
+		/**
+		* @brief Sends part of a file across the socket.
+		* When kernel TLS is active for sending, this uses SSL_sendfile(), so that the file is encrypted by the kernel
+		* without being copied into user space; otherwise, the file is read and passed to send().
+		*
+		* @param in_file Descriptor of the file to send from
+		* @param in_offset Position in the file to start sending from
+		* @param in_length Number of bytes to send
+		* @return Number of bytes sent (which may be less than in_length) on success, -1 otherwise.
+		*/
+		virtual int sendFile(int in_file, size_t in_offset, size_t in_length) override;
+
+		/**
+		* @brief Sets whether or not connections established by subsequent calls to initSSL() try to use kernel TLS
+		* (Linux kTLS), which moves record encryption and decryption into the kernel after the handshake. This is
+		* enabled by default, but only takes effect when OpenSSL is built with kTLS support, and the kernel and
+		* negotiated cipher support it; otherwise, SSL continues in user space. It is never used when offloading.
+		*
+		* @param in_kernel_tls True to try kernel TLS, false otherwise
+		*/
+		void setKernelTLS(bool in_kernel_tls);
+
+		/**
+		* @brief Checks if kernel TLS is tried by initSSL().
+		*
+		* @return True if kernel TLS is tried, false otherwise.
+		*/
+		bool getKernelTLS() const;
+
+		/**
+		* @brief Checks if the kernel is encrypting data sent across the connection.
+		*
+		* @return True if kernel TLS is active for sending, false otherwise.
+		*/
+		bool isKernelTLSSend() const;
+
+		/**
+		* @brief Checks if the kernel is decrypting data received from the connection.
+		*
+		* @return True if kernel TLS is active for receiving, false otherwise.
+		*/
+		bool isKernelTLSRecv() const;
+
+		/**
+		* @brief Checks if decrypted data is buffered by SSL, which will not cause the descriptor to be reported as readable.
+		*
+		* @return True if recv() can return data without reading from the descriptor, false otherwise.
+		*/
+		virtual bool hasPendingData() const override;
+
+		/**
+		* @brief SSL performs its own reads and writes on the descriptor, so a SecureSocket cannot be attached to an io_uring backend.
+		*
+		* @param in_uring Must be nullptr
+		* @return True if in_uring is nullptr (and the socket was detached), false otherwise.
+		*/
+		virtual bool setIOUring(Jupiter::IOUring *in_uring) override;
 
 		/**
 		* @brief Initializes SSL on the socket.
@@ -204,6 +400,19 @@ namespace Jupiter
 		*/
 		virtual ~SecureSocket();
 
+	/** Protected functions */
+	protected:
+		/**
+		* @brief Writes data across the socket through SSL, bypassing the send queue.
+		* Note: SSL_write() blocks if the underlying socket is blocking, even in queue mode.
+		*
+		* @param data Data to write
+		* @param datalen Number of bytes to write
+		* @return Number of bytes written on success, 0 if SSL_write() must be retried (queue mode only), less than 0 otherwise.
+		* Note: Outside of queue mode, refer to SSL_write() for detailed return values.
+		*/
+		virtual int transmit(const char *data, size_t datalen) override;
+
 	/** Private members */
 	private:
 		struct SSLData;
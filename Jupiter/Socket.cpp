@@ -17,10 +17,12 @@
  */
 
 #include <cstdio>
+#include <vector>
 
 #if defined _WIN32
 #include <WinSock2.h>
 #include <ws2tcpip.h>
+#include <io.h>
 #pragma comment(lib, "Ws2_32.lib")
 bool socketInit = false;
 #else // _WIN32
@@ -32,11 +34,16 @@ bool socketInit = false;
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#if defined __linux__
+#include <sys/sendfile.h>
+#endif // __linux__
 #define INVALID_SOCKET (Jupiter::Socket::SocketType)(~0)
 #define SOCKET_ERROR (-1)
 #endif // _WIN32
 
 #include "Socket.h"
+#include "IOUring.h"
 #include "Functions.h"
 #include "CString.h"
 
@@ -50,9 +57,175 @@ char *Jupiter::Socket::Buffer::get_str() const
 	return this->str;
 }
 
+char *Jupiter::Socket::Buffer::get_tail() const
+{
+	return this->str + this->length;
+}
+
+size_t Jupiter::Socket::Buffer::reserve_tail(size_t in_minimum)
+{
+	if (this->strSize - (this->str - this->base) - this->length < in_minimum)
+		this->setBufferSize(this->length + in_minimum); // shifts data to the front, and only reallocates if that isn't enough
+
+	return this->strSize - (this->str - this->base) - this->length;
+}
+
+void Jupiter::Socket::Buffer::consume(size_t in_length)
+{
+	this->shiftRight(in_length);
+	if (this->length == 0)
+		this->str = this->base;
+}
+
+/** Happy Eyeballs (RFC 8305) */
+
+static constexpr std::chrono::milliseconds connection_attempt_delay{ 250 }; // RFC 8305, section 5
+
+namespace
+{
+	struct ConnectTarget
+	{
+		sockaddr_storage address;
+		socklen_t length;
+		int family;
+	};
+}
+
+static void close_descriptor(Jupiter::Socket::SocketType descriptor)
+{
+#if defined _WIN32
+	::closesocket(descriptor);
+#else // _WIN32
+	::close(descriptor);
+#endif // _WIN32
+}
+
+static bool set_nonblocking(Jupiter::Socket::SocketType descriptor, bool in_nonblocking)
+{
+#if defined _WIN32
+	u_long mode = in_nonblocking ? 1 : 0;
+	return ioctlsocket(descriptor, FIONBIO, &mode) == 0;
+#else // _WIN32
+	int flags = fcntl(descriptor, F_GETFL, 0);
+	if (flags < 0)
+		return false;
+	flags = in_nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+	return fcntl(descriptor, F_SETFL, flags) == 0;
+#endif // _WIN32
+}
+
+static bool is_connect_in_progress()
+{
+#if defined _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else // _WIN32
+	return errno == EINPROGRESS;
+#endif // _WIN32
+}
+
+/** Appends each address of a socket type to a list of targets */
+static void add_targets(const addrinfo *info, int sock_type, std::vector<ConnectTarget> &targets)
+{
+	ConnectTarget target;
+	while (info != nullptr)
+	{
+		// getaddrinfo() returns each address once per socket type, unless hints are given
+		if ((info->ai_socktype == sock_type || info->ai_socktype == 0) && info->ai_addrlen <= sizeof(sockaddr_storage))
+		{
+			memcpy(&target.address, info->ai_addr, info->ai_addrlen);
+			target.length = static_cast<socklen_t>(info->ai_addrlen);
+			target.family = info->ai_family;
+			targets.push_back(target);
+		}
+		info = info->ai_next;
+	}
+}
+
+/** Interleaves address families, starting with whichever family was sorted first (RFC 8305, section 4) */
+static void interleave_targets(std::vector<ConnectTarget> &targets)
+{
+	if (targets.empty())
+		return;
+
+	std::vector<ConnectTarget> first, second;
+	for (const ConnectTarget &target : targets)
+		(target.family == targets.front().family ? first : second).push_back(target);
+
+	targets.clear();
+	for (size_t index = 0; index < first.size() || index < second.size(); ++index)
+	{
+		if (index < first.size())
+			targets.push_back(first[index]);
+		if (index < second.size())
+			targets.push_back(second[index]);
+	}
+}
+
+namespace
+{
+	struct PendingConnect
+	{
+		std::vector<ConnectTarget> targets; // remote addresses, in the order in which they're attempted
+		std::vector<ConnectTarget> bind_targets; // local addresses to bind to, if any
+		std::vector<Jupiter::Socket::SocketType> attempts; // descriptors of attempts which are still in progress
+		size_t next_target = 0;
+		std::chrono::steady_clock::time_point next_attempt_time;
+		int sock_type;
+		int sock_proto;
+
+		bool start_next();
+		~PendingConnect();
+	};
+}
+
+bool PendingConnect::start_next()
+{
+	while (next_target != targets.size())
+	{
+		const ConnectTarget &target = targets[next_target++];
+		Jupiter::Socket::SocketType descriptor = socket(target.family, sock_type, sock_proto);
+		if (descriptor == INVALID_SOCKET)
+			continue;
+
+		if (bind_targets.empty() == false)
+		{
+			auto bind_target = bind_targets.begin();
+			while (bind_target != bind_targets.end() && bind_target->family != target.family)
+				++bind_target;
+
+			if (bind_target == bind_targets.end() || ::bind(descriptor, reinterpret_cast<const sockaddr *>(&bind_target->address), bind_target->length) == SOCKET_ERROR)
+			{
+				close_descriptor(descriptor);
+				continue;
+			}
+		}
+
+		if (set_nonblocking(descriptor, true) == false
+			|| (::connect(descriptor, reinterpret_cast<const sockaddr *>(&target.address), target.length) == SOCKET_ERROR && is_connect_in_progress() == false))
+		{
+			close_descriptor(descriptor);
+			continue;
+		}
+
+		attempts.push_back(descriptor);
+		next_attempt_time = std::chrono::steady_clock::now() + connection_attempt_delay;
+		return true;
+	}
+
+	return false;
+}
+
+PendingConnect::~PendingConnect()
+{
+	for (Jupiter::Socket::SocketType descriptor : attempts)
+		close_descriptor(descriptor);
+}
+
 struct Jupiter::Socket::Data
 {
 	Jupiter::Socket::Buffer buffer;
+	Jupiter::Socket::Buffer send_queue;
+	size_t high_water_mark = 64 * 1024;
 	SocketType rawSock = INVALID_SOCKET;
 	unsigned short remote_port = 0;
 	unsigned short bound_port = 0;
@@ -61,11 +234,17 @@ struct Jupiter::Socket::Data
 	int sockType = SOCK_RAW;
 	int sockProto = IPPROTO_RAW;
 	bool is_shutdown = false;
+	bool append_mode = false;
+	bool queue_mode = false;
+	unsigned int cork_depth = 0;
+	Jupiter::IOUring *uring = nullptr;
+	PendingConnect *connecting = nullptr;
 #if defined _WIN32
 	unsigned long blockMode = 0;
 #endif
 	Data(size_t buffer_size);
 	Data(const Data &);
+	~Data();
 };
 
 Jupiter::Socket::Data::Data(size_t buffer_size)
@@ -83,11 +262,21 @@ Jupiter::Socket::Data::Data(const Data &source)
 	Jupiter::Socket::Data::sockProto = source.sockProto;
 	Jupiter::Socket::Data::remote_host = source.remote_host;
 	Jupiter::Socket::Data::bound_host = source.bound_host;
+	Jupiter::Socket::Data::append_mode = source.append_mode;
+	Jupiter::Socket::Data::send_queue = source.send_queue;
+	Jupiter::Socket::Data::high_water_mark = source.high_water_mark;
+	Jupiter::Socket::Data::queue_mode = source.queue_mode;
+	Jupiter::Socket::Data::uring = source.uring;
 #if defined _WIN32
 	Jupiter::Socket::Data::blockMode = source.blockMode;
 #endif
 }
 
+Jupiter::Socket::Data::~Data()
+{
+	delete Jupiter::Socket::Data::connecting;
+}
+
 Jupiter::Socket &Jupiter::Socket::operator=(Jupiter::Socket &&source)
 {
 	Jupiter::Socket::data_ = source.data_;
@@ -162,12 +351,22 @@ bool Jupiter::Socket::connect(const char *hostname, unsigned short iPort, const
 	if (!socketInit && !Jupiter::Socket::init())
 		return false;
 #endif // _WIN32
-	Jupiter::Socket::data_->remote_host.set(hostname);
-	Jupiter::Socket::data_->remote_port = iPort;
-	addrinfo *info_head = Jupiter::Socket::getAddrInfo(Jupiter::Socket::data_->remote_host.c_str(), Jupiter::CStringS::Format("%hu", Jupiter::Socket::data_->remote_port).c_str());
-	if (info_head != nullptr)
+	std::shared_ptr<Jupiter::Resolver::Result> address = Jupiter::Resolver::getDefault().resolve(hostname, iPort);
+	address->wait();
+	return Jupiter::Socket::connect(*address, clientAddress, clientPort);
+}
+
+bool Jupiter::Socket::connect(const Jupiter::Resolver::Result &address, const char *clientAddress, unsigned short clientPort)
+{
+#if defined _WIN32
+	if (!socketInit && !Jupiter::Socket::init())
+		return false;
+#endif // _WIN32
+	Jupiter::Socket::data_->remote_host.set(address.getHostname());
+	Jupiter::Socket::data_->remote_port = address.getPort();
+	addrinfo *info = address.getInfo();
+	if (info != nullptr)
 	{
-		addrinfo *info = info_head;
 		do
 		{
 			if (clientAddress != nullptr)
@@ -198,14 +397,150 @@ bool Jupiter::Socket::connect(const char *hostname, unsigned short iPort, const
 				continue;
 			}
 
-			Jupiter::Socket::freeAddrInfo(info_head);
 			return true;
 		} while (info != nullptr);
-		Jupiter::Socket::freeAddrInfo(info_head);
 	}
 	return false;
 }
 
+bool Jupiter::Socket::connectAsync(const Jupiter::Resolver::Result &address, const char *clientAddress, unsigned short clientPort)
+{
+#if defined _WIN32
+	if (!socketInit && !Jupiter::Socket::init())
+		return false;
+#endif // _WIN32
+	delete Jupiter::Socket::data_->connecting;
+	Jupiter::Socket::data_->connecting = nullptr;
+	Jupiter::Socket::data_->remote_host.set(address.getHostname());
+	Jupiter::Socket::data_->remote_port = address.getPort();
+
+	PendingConnect *connecting = new PendingConnect();
+	connecting->sock_type = Jupiter::Socket::data_->sockType;
+	connecting->sock_proto = Jupiter::Socket::data_->sockProto;
+	add_targets(address.getInfo(), connecting->sock_type, connecting->targets);
+	interleave_targets(connecting->targets);
+
+	if (clientAddress != nullptr)
+	{
+		Jupiter::Socket::data_->bound_host.set(clientAddress);
+		Jupiter::Socket::data_->bound_port = clientPort;
+		addrinfo *bind_info = Jupiter::Socket::getAddrInfo(clientAddress, Jupiter::CStringS::Format("%hu", clientPort).c_str());
+		if (bind_info != nullptr)
+		{
+			add_targets(bind_info, connecting->sock_type, connecting->bind_targets);
+			Jupiter::Socket::freeAddrInfo(bind_info);
+		}
+
+		if (connecting->bind_targets.empty())
+		{
+			delete connecting;
+			return false;
+		}
+	}
+
+	if (connecting->start_next() == false)
+	{
+		delete connecting;
+		return false;
+	}
+
+	Jupiter::Socket::data_->connecting = connecting;
+	return true;
+}
+
+int Jupiter::Socket::pollConnect(std::chrono::milliseconds timeout)
+{
+	PendingConnect *connecting = Jupiter::Socket::data_->connecting;
+	if (connecting == nullptr)
+		return Jupiter::Socket::data_->rawSock != INVALID_SOCKET ? 1 : -1;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point deadline = now + timeout;
+	std::chrono::milliseconds wait;
+	std::vector<pollfd> descriptors;
+	bool polled = false;
+	int error;
+	socklen_t error_length;
+
+	while (true)
+	{
+		// Start the next attempt once it's due, or once there's nothing left to wait on
+		if (connecting->attempts.empty() || now >= connecting->next_attempt_time)
+			connecting->start_next();
+
+		if (connecting->attempts.empty()) // every attempt failed
+		{
+			delete connecting;
+			Jupiter::Socket::data_->connecting = nullptr;
+			return -1;
+		}
+
+		if (polled && now >= deadline)
+			return 0;
+
+		// Wait until the deadline, or until the next attempt is due
+		wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+		if (connecting->next_target != connecting->targets.size() && connecting->next_attempt_time - now < wait)
+			wait = std::chrono::duration_cast<std::chrono::milliseconds>(connecting->next_attempt_time - now) + std::chrono::milliseconds(1);
+		if (wait.count() < 0)
+			wait = std::chrono::milliseconds(0);
+
+		descriptors.resize(connecting->attempts.size());
+		for (size_t index = 0; index != descriptors.size(); ++index)
+		{
+			descriptors[index].fd = connecting->attempts[index];
+			descriptors[index].events = POLLOUT;
+			descriptors[index].revents = 0;
+		}
+
+#if defined _WIN32
+		if (WSAPoll(descriptors.data(), static_cast<ULONG>(descriptors.size()), static_cast<int>(wait.count())) > 0)
+#else // _WIN32
+		if (poll(descriptors.data(), descriptors.size(), static_cast<int>(wait.count())) > 0)
+#endif // _WIN32
+		{
+			size_t index = descriptors.size();
+			while (index != 0)
+			{
+				if (descriptors[--index].revents == 0)
+					continue;
+
+				error = 0;
+				error_length = sizeof(error);
+				if ((descriptors[index].revents & POLLOUT) != 0
+					&& getsockopt(descriptors[index].fd, SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&error), &error_length) == 0
+					&& error == 0)
+				{
+					// Connected; abandon any other attempts
+					connecting->attempts.erase(connecting->attempts.begin() + index);
+					delete connecting;
+					Jupiter::Socket::data_->connecting = nullptr;
+
+					set_nonblocking(descriptors[index].fd, false);
+#if defined _WIN32
+					Jupiter::Socket::data_->blockMode = 0;
+#endif // _WIN32
+					Jupiter::Socket::data_->rawSock = descriptors[index].fd;
+					return 1;
+				}
+
+				// Failed; start the next attempt right away
+				close_descriptor(descriptors[index].fd);
+				connecting->attempts.erase(connecting->attempts.begin() + index);
+				connecting->next_attempt_time = now;
+			}
+		}
+
+		polled = true;
+		now = std::chrono::steady_clock::now();
+	}
+}
+
+bool Jupiter::Socket::isConnecting() const
+{
+	return Jupiter::Socket::data_->connecting != nullptr;
+}
+
 bool Jupiter::Socket::bind(const char *hostname, unsigned short iPort, bool andListen)
 {
 #if defined _WIN32
@@ -262,6 +597,9 @@ void Jupiter::Socket::close()
 {
 	if (Jupiter::Socket::data_ != nullptr)
 	{
+		Jupiter::Socket::setIOUring(nullptr);
+		delete Jupiter::Socket::data_->connecting;
+		Jupiter::Socket::data_->connecting = nullptr;
 		if (Jupiter::Socket::data_->is_shutdown == false)
 			this->shutdown();
 #if defined _WIN32
@@ -270,6 +608,7 @@ void Jupiter::Socket::close()
 		::close(Jupiter::Socket::data_->rawSock);
 #endif // _WIN32
 		Jupiter::Socket::data_->rawSock = 0;
+		Jupiter::Socket::data_->send_queue.erase();
 	}
 }
 
@@ -417,7 +756,16 @@ Jupiter::Socket *Jupiter::Socket::accept()
 {
 	sockaddr addr;
 	int size = sizeof(addr);
-	SocketType tSock = ::accept(Socket::data_->rawSock, &addr, &size);
+	SocketType tSock;
+	if (Jupiter::Socket::data_->uring != nullptr)
+	{
+		tSock = Jupiter::Socket::data_->uring->accept(Jupiter::Socket::data_->rawSock);
+		if (tSock != INVALID_SOCKET)
+			getpeername(tSock, &addr, &size);
+	}
+	else
+		tSock = ::accept(Socket::data_->rawSock, &addr, &size);
+
 	if (tSock != INVALID_SOCKET)
 	{
 		char resolved[NI_MAXHOST];
@@ -553,9 +901,69 @@ void Jupiter::Socket::clearBuffer()
 	Jupiter::Socket::data_->buffer.erase();
 }
 
+void Jupiter::Socket::setAppendMode(bool in_append_mode)
+{
+	Jupiter::Socket::data_->append_mode = in_append_mode;
+}
+
+bool Jupiter::Socket::getAppendMode() const
+{
+	return Jupiter::Socket::data_->append_mode;
+}
+
+void Jupiter::Socket::consume(size_t in_length)
+{
+	Jupiter::Socket::data_->buffer.consume(in_length);
+}
+
 int Jupiter::Socket::send(const char *data, size_t datalen)
 {
-	return ::send(Jupiter::Socket::data_->rawSock, data, datalen, 0);
+	Jupiter::Socket::Buffer &queue = Jupiter::Socket::data_->send_queue;
+	size_t written = 0;
+	if (Jupiter::Socket::data_->cork_depth == 0)
+	{
+		if (Jupiter::Socket::data_->queue_mode == false)
+			return this->transmit(data, datalen);
+
+		// Data can only be written immediately if there's nothing queued ahead of it
+		if (queue.isEmpty())
+		{
+			int result = this->transmit(data, datalen);
+			if (result < 0)
+				return SOCKET_ERROR;
+
+			written = static_cast<size_t>(result);
+		}
+	}
+
+	// Queue whatever remains (or gather it until uncorked)
+	if (written != datalen)
+	{
+		queue.reserve_tail(datalen - written);
+		memcpy(queue.get_tail(), data + written, datalen - written);
+		queue.set_length(queue.size() + datalen - written);
+	}
+
+	return static_cast<int>(datalen);
+}
+
+int Jupiter::Socket::transmit(const char *data, size_t datalen)
+{
+	if (Jupiter::Socket::data_->uring != nullptr)
+		return Jupiter::Socket::data_->uring->send(Jupiter::Socket::data_->rawSock, data, datalen);
+
+	if (Jupiter::Socket::data_->queue_mode == false)
+		return ::send(Jupiter::Socket::data_->rawSock, data, datalen, 0);
+
+#if defined _WIN32
+	int result = ::send(Jupiter::Socket::data_->rawSock, data, datalen, 0);
+#else // _WIN32
+	int result = ::send(Jupiter::Socket::data_->rawSock, data, datalen, MSG_DONTWAIT);
+#endif // _WIN32
+	if (result == SOCKET_ERROR && Jupiter::Socket::isWouldBlock())
+		return 0;
+
+	return result;
 }
 
 int Jupiter::Socket::send(const Jupiter::ReadableString &str)
@@ -568,6 +976,148 @@ int Jupiter::Socket::send(const char *msg)
 	return this->send(msg, strlen(msg));
 }
 
+int Jupiter::Socket::sendFile(int in_file, size_t in_offset, size_t in_length)
+{
+#if defined __linux__
+	// Anything already queued (or gathered) must be sent first
+	if (Jupiter::Socket::data_->uring == nullptr && Jupiter::Socket::data_->cork_depth == 0 && Jupiter::Socket::data_->send_queue.isEmpty())
+	{
+		off_t offset = in_offset;
+		ssize_t result = ::sendfile(Jupiter::Socket::data_->rawSock, in_file, &offset, in_length);
+		if (result >= 0 || (errno != EINVAL && errno != ENOSYS)) // EINVAL: the file doesn't support sendfile()
+			return static_cast<int>(result);
+	}
+#endif // __linux__
+
+	return Jupiter::Socket::sendFileCopy(in_file, in_offset, in_length);
+}
+
+int Jupiter::Socket::sendFileCopy(int in_file, size_t in_offset, size_t in_length)
+{
+	char buffer[65536];
+	size_t total = 0;
+	int length;
+	int result;
+
+#if defined _WIN32
+	if (_lseeki64(in_file, in_offset, SEEK_SET) < 0)
+		return SOCKET_ERROR;
+#endif // _WIN32
+
+	while (total != in_length)
+	{
+		length = static_cast<int>(in_length - total < sizeof(buffer) ? in_length - total : sizeof(buffer));
+#if defined _WIN32
+		length = _read(in_file, buffer, length);
+#else // _WIN32
+		length = static_cast<int>(pread(in_file, buffer, length, in_offset + total));
+#endif // _WIN32
+		if (length < 0)
+			return SOCKET_ERROR;
+		if (length == 0) // end of file
+			break;
+
+		result = this->send(buffer, length);
+		if (result < 0)
+			return total == 0 ? SOCKET_ERROR : static_cast<int>(total);
+
+		total += result;
+		if (result != length) // partial write
+			break;
+	}
+
+	return static_cast<int>(total);
+}
+
+void Jupiter::Socket::setQueueMode(bool in_queue_mode)
+{
+	Jupiter::Socket::data_->queue_mode = in_queue_mode;
+}
+
+bool Jupiter::Socket::getQueueMode() const
+{
+	return Jupiter::Socket::data_->queue_mode;
+}
+
+int Jupiter::Socket::flush()
+{
+	Jupiter::Socket::Buffer &queue = Jupiter::Socket::data_->send_queue;
+	if (queue.isEmpty())
+		return 0;
+
+	int result = this->transmit(queue.ptr(), queue.size());
+	if (result > 0)
+		queue.consume(result);
+
+	return result;
+}
+
+size_t Jupiter::Socket::getQueuedSize() const
+{
+	return Jupiter::Socket::data_->send_queue.size();
+}
+
+void Jupiter::Socket::setHighWaterMark(size_t in_high_water_mark)
+{
+	Jupiter::Socket::data_->high_water_mark = in_high_water_mark;
+}
+
+size_t Jupiter::Socket::getHighWaterMark() const
+{
+	return Jupiter::Socket::data_->high_water_mark;
+}
+
+bool Jupiter::Socket::isQueueFull() const
+{
+	return Jupiter::Socket::data_->send_queue.size() >= Jupiter::Socket::data_->high_water_mark;
+}
+
+void Jupiter::Socket::cork()
+{
+	++Jupiter::Socket::data_->cork_depth;
+}
+
+bool Jupiter::Socket::uncork()
+{
+	if (Jupiter::Socket::data_->cork_depth == 0 || --Jupiter::Socket::data_->cork_depth != 0)
+		return true;
+
+	if (Jupiter::Socket::data_->queue_mode)
+		return Jupiter::Socket::flush() >= 0;
+
+	// Write everything gathered, blocking as send() would
+	Jupiter::Socket::Buffer &queue = Jupiter::Socket::data_->send_queue;
+	int result;
+	while (queue.isEmpty() == false)
+	{
+		result = this->transmit(queue.ptr(), queue.size());
+		if (result <= 0)
+		{
+			queue.erase();
+			return false;
+		}
+
+		queue.consume(result);
+	}
+
+	return true;
+}
+
+bool Jupiter::Socket::isCorked() const
+{
+	return Jupiter::Socket::data_->cork_depth != 0;
+}
+
+Jupiter::Socket::Cork::Cork(Jupiter::Socket &in_socket) : m_socket(in_socket)
+{
+	m_socket.cork();
+}
+
+Jupiter::Socket::Cork::~Cork()
+{
+	m_socket.uncork();
+}
+
 int Jupiter::Socket::sendTo(const addrinfo *info, const char *data, size_t datalen)
 {
 	return sendto(Jupiter::Socket::data_->rawSock, data, datalen, 0, info->ai_addr, info->ai_addrlen);
@@ -581,7 +1131,11 @@ int Jupiter::Socket::sendTo(const addrinfo *info, const char *msg)
 int Jupiter::Socket::peek()
 {
 	Jupiter::Socket::data_->buffer.erase();
-	int r = ::recv(Jupiter::Socket::data_->rawSock, Jupiter::Socket::data_->buffer.get_str(), Jupiter::Socket::data_->buffer.capacity(), MSG_PEEK);
+	int r;
+	if (Jupiter::Socket::data_->uring != nullptr)
+		r = Jupiter::Socket::data_->uring->recv(Jupiter::Socket::data_->rawSock, Jupiter::Socket::data_->buffer.get_str(), Jupiter::Socket::data_->buffer.capacity(), true);
+	else
+		r = ::recv(Jupiter::Socket::data_->rawSock, Jupiter::Socket::data_->buffer.get_str(), Jupiter::Socket::data_->buffer.capacity(), MSG_PEEK);
 	if (r > 0)
 		Jupiter::Socket::data_->buffer.set_length(r);
 	return r;
@@ -612,10 +1166,15 @@ int Jupiter::Socket::peekFrom(addrinfo *info)
 
 int Jupiter::Socket::recv()
 {
-	Jupiter::Socket::data_->buffer.erase();
-	int r = ::recv(Jupiter::Socket::data_->rawSock, Jupiter::Socket::data_->buffer.get_str(), Jupiter::Socket::data_->buffer.capacity(), 0);
+	size_t capacity;
+	char *output = Jupiter::Socket::prepareRecv(capacity);
+	int r;
+	if (Jupiter::Socket::data_->uring != nullptr)
+		r = Jupiter::Socket::data_->uring->recv(Jupiter::Socket::data_->rawSock, output, capacity);
+	else
+		r = ::recv(Jupiter::Socket::data_->rawSock, output, capacity, 0);
 	if (r > 0)
-		Jupiter::Socket::data_->buffer.set_length(r);
+		Jupiter::Socket::data_->buffer.set_length(Jupiter::Socket::data_->buffer.size() + r);
 	return r;
 }
 
@@ -642,6 +1201,38 @@ int Jupiter::Socket::recvFrom(addrinfo *info)
 	return r;
 }
 
+bool Jupiter::Socket::hasPendingData() const
+{
+	return Jupiter::Socket::data_->uring != nullptr && Jupiter::Socket::data_->uring->hasPendingData(Jupiter::Socket::data_->rawSock);
+}
+
+bool Jupiter::Socket::setIOUring(Jupiter::IOUring *in_uring)
+{
+	if (in_uring == Jupiter::Socket::data_->uring)
+		return true;
+
+	if (Jupiter::Socket::data_->uring != nullptr)
+	{
+		Jupiter::Socket::data_->uring->detach(Jupiter::Socket::data_->rawSock);
+		Jupiter::Socket::data_->uring = nullptr;
+	}
+
+	if (in_uring != nullptr)
+	{
+		if (in_uring->attach(Jupiter::Socket::data_->rawSock) == false)
+			return false;
+
+		Jupiter::Socket::data_->uring = in_uring;
+	}
+
+	return true;
+}
+
+Jupiter::IOUring *Jupiter::Socket::getIOUring() const
+{
+	return Jupiter::Socket::data_->uring;
+}
+
 int Jupiter::Socket::receive()
 {
 	return this->recv();
@@ -657,6 +1248,15 @@ int Jupiter::Socket::getLastError() // static
     return lastError;
 }
 
+bool Jupiter::Socket::isWouldBlock() // static
+{
+#if defined _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else // _WIN32
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif // _WIN32
+}
+
 bool Jupiter::Socket::init() // static
 {
 #if defined _WIN32 // _WIN32
@@ -693,4 +1293,18 @@ void Jupiter::Socket::setDescriptor(SocketType descriptor)
 Jupiter::Socket::Buffer &Jupiter::Socket::getInternalBuffer() const
 {
 	return Jupiter::Socket::data_->buffer;
-}
\ No newline at end of file
+}
+
+char *Jupiter::Socket::prepareRecv(size_t &out_capacity)
+{
+	if (Jupiter::Socket::data_->append_mode)
+	{
+		// Keep at least half the buffer free to receive into; the buffer only grows when more than half is unconsumed
+		out_capacity = Jupiter::Socket::data_->buffer.reserve_tail(Jupiter::Socket::data_->buffer.capacity() / 2);
+		return Jupiter::Socket::data_->buffer.get_tail();
+	}
+
+	Jupiter::Socket::data_->buffer.erase();
+	out_capacity = Jupiter::Socket::data_->buffer.capacity();
+	return Jupiter::Socket::data_->buffer.get_str();
+}
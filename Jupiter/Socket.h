@@ -25,15 +25,19 @@
  */
 
 #include <cstring>
+#include <chrono>
 #include "Jupiter.h"
 #include "Readable_String.h"
 #include "String.h"
+#include "Resolver.h"
 
 struct addrinfo;
 struct in_addr6;
 
 namespace Jupiter
 {
+	class IOUring;
+
 	/**
 	* @brief Provides a cross-platform interface for sockets.
 	* Note: This class SHOULD NOT be instantiated by itself.
@@ -208,6 +212,8 @@ namespace Jupiter
 
 		/**
 		* @brief Interface to provide simple connection establishing.
+		* Note: The hostname is resolved through the default Resolver, so its cache is used; however, this still blocks
+		* while resolving a hostname which isn't cached. Use connect(const Jupiter::Resolver::Result &) to avoid that.
 		*
 		* @param hostname String containing hostname of server to connect to.
 		* @param iPort Port to connect on.
@@ -217,6 +223,46 @@ namespace Jupiter
 		*/
 		virtual bool connect(const char *hostname, unsigned short iPort, const char *clientHostname = nullptr, unsigned short clientPort = 0);
 
+		/**
+		* @brief Interface to provide simple connection establishing, using an address which has already been resolved.
+		* Each resolved address is attempted in order, until one succeeds.
+		*
+		* @param address Completed resolver result for the server to connect to.
+		* @param clientHostname Optional parameter to specify the address for socket to bind to.
+		* @param clientPort Optional parameter to specify the port for socket to bind to.
+		* @return True on success, false otherwise.
+		*/
+		virtual bool connect(const Jupiter::Resolver::Result &address, const char *clientHostname = nullptr, unsigned short clientPort = 0);
+
+		/**
+		* @brief Starts connecting to an address which has already been resolved, without blocking.
+		* Addresses are attempted as described by Happy Eyeballs (RFC 8305): address families are interleaved, and
+		* a new attempt is started every 250ms (or as soon as an attempt fails) while earlier attempts continue.
+		* The first attempt to complete is used, and the rest are abandoned. Call pollConnect() until it returns non-zero.
+		* Note: Once connected, the socket is in the same blocking mode as one connected by connect().
+		*
+		* @param address Completed resolver result for the server to connect to.
+		* @param clientHostname Optional parameter to specify the address for socket to bind to.
+		* @param clientPort Optional parameter to specify the port for socket to bind to.
+		* @return True if a connection attempt was started, false otherwise.
+		*/
+		virtual bool connectAsync(const Jupiter::Resolver::Result &address, const char *clientHostname = nullptr, unsigned short clientPort = 0);
+
+		/**
+		* @brief Checks on a connection started by connectAsync(), starting further attempts as they become due.
+		*
+		* @param timeout Maximum amount of time to wait for an attempt to complete
+		* @return 1 if the socket is connected, 0 if it is still connecting, -1 if every attempt failed.
+		*/
+		virtual int pollConnect(std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+		/**
+		* @brief Checks if a connection started by connectAsync() is still in progress.
+		*
+		* @return True if the socket is connecting, false otherwise.
+		*/
+		bool isConnecting() const;
+
 		/**
 		* @brief Interface to provide simple binding to ports.
 		*
@@ -369,6 +415,31 @@ namespace Jupiter
 		*/
 		void clearBuffer();
 
+		/**
+		* @brief Sets whether or not recv() appends to the buffer, rather than overwriting it.
+		* In append mode, received data is written after any data still in the buffer, and stays there until
+		* it is removed with consume(). This allows partial messages to be left in place until the rest arrives.
+		* Note: The buffer grows as necessary to hold unconsumed data. Only recv() is affected.
+		*
+		* @param in_append_mode True to append received data, false to overwrite the buffer on each recv().
+		*/
+		void setAppendMode(bool in_append_mode);
+
+		/**
+		* @brief Checks if recv() appends to the buffer.
+		*
+		* @return True if the socket is in append mode, false otherwise.
+		*/
+		bool getAppendMode() const;
+
+		/**
+		* @brief Removes data from the front of the buffer, once it has been processed.
+		* Note: This does not move or free any memory, so references into the buffer remain valid until the next recv().
+		*
+		* @param in_length Number of bytes to remove
+		*/
+		void consume(size_t in_length);
+
 		/**
 		* @brief Writes new data from the socket to the buffer, without removing it from the socket queue.
 		* The data written by this function will always end with a null character, which is not counted in the returned value.
@@ -392,6 +463,7 @@ namespace Jupiter
 		/**
 		* @brief Writes new data from the socket to the buffer.
 		* The data written by this function will always end with a null character, which is not counted in the returned value.
+		* In append mode, the data is written after any unconsumed data already in the buffer.
 		*
 		* @return Number of bytes written to buffer on success, SOCKET_ERROR (-1) otherwise.
 		* Note: Any returned value less than or equal to 0 should be treated as an error.
@@ -409,14 +481,40 @@ namespace Jupiter
 		*/
 		virtual int recvFrom(addrinfo *info);
 
+		/**
+		* @brief Checks if data has already been read from the descriptor, but not yet returned by recv().
+		* Such data will not cause the descriptor to be reported as readable when polled.
+		*
+		* @return True if recv() can return data without reading from the descriptor, false otherwise.
+		*/
+		virtual bool hasPendingData() const;
+
+		/**
+		* @brief Attaches the socket to an io_uring backend, or detaches it.
+		* While attached, recv(), peek(), send() and accept() operate on the ring's queues rather than making
+		* system calls, and take effect when the ring is next submitted. The socket is detached when closed.
+		*
+		* @param in_uring Ring to attach the socket to, or nullptr to detach it
+		* @return True on success, false otherwise.
+		*/
+		virtual bool setIOUring(Jupiter::IOUring *in_uring);
+
+		/**
+		* @brief Fetches the io_uring backend which the socket is attached to.
+		*
+		* @return Ring if the socket is attached to one, nullptr otherwise.
+		*/
+		Jupiter::IOUring *getIOUring() const;
+
 		int receive(); /** @see recv() */
 
 		/**
 		* @brief Sends data across the socket.
+		* If queue mode is enabled, any data which can't be sent immediately is queued; see setQueueMode().
 		*
 		* @param data String containing the data to be send.
 		* @param datalen The size of the data to be sent, in chars.
-		* @return Number of bytes sent on success, SOCKET_ERROR (-1) otherwise.
+		* @return Number of bytes sent (or queued) on success, SOCKET_ERROR (-1) otherwise.
 		* Note: Any returned value less than or equal to 0 should be treated as an error.
 		*/
 		virtual int send(const char *data, size_t datalen);
@@ -441,6 +539,123 @@ namespace Jupiter
 		*/
 		int send(const char *msg);
 
+		/**
+		* @brief Sends part of a file across the socket.
+		* On Linux, this uses sendfile() when possible, so that the file's contents are never copied into user space;
+		* otherwise (or while data is queued or corked), the file is read and passed to send().
+		*
+		* @param in_file Descriptor of the file to send from
+		* @param in_offset Position in the file to start sending from
+		* @param in_length Number of bytes to send
+		* @return Number of bytes sent (which may be less than in_length) on success, SOCKET_ERROR (-1) otherwise.
+		*/
+		virtual int sendFile(int in_file, size_t in_offset, size_t in_length);
+
+		/**
+		* @brief Sets whether or not send() queues data which the socket can't accept immediately.
+		* When enabled, send() never blocks and never sends partially; whatever isn't written immediately is
+		* retained, and is written by flush() along with anything sent after it, so that many small sends made
+		* while the socket is busy are coalesced into a single write.
+		* Note: Data which is already queued is still written by flush() after queue mode is disabled.
+		*
+		* @param in_queue_mode True to queue unsent data, false to return partial writes to the caller
+		*/
+		void setQueueMode(bool in_queue_mode);
+
+		/**
+		* @brief Checks if send() queues data which the socket can't accept immediately.
+		*
+		* @return True if queue mode is enabled, false otherwise.
+		*/
+		bool getQueueMode() const;
+
+		/**
+		* @brief Writes as much queued data as the socket will accept, without blocking.
+		* This should be called whenever the socket becomes writable while data is queued.
+		*
+		* @return Number of bytes written (0 if none could be) on success, SOCKET_ERROR (-1) otherwise.
+		*/
+		int flush();
+
+		/**
+		* @brief Fetches the amount of data waiting to be written by flush().
+		*
+		* @return Number of bytes queued.
+		*/
+		size_t getQueuedSize() const;
+
+		/**
+		* @brief Sets the amount of queued data at which isQueueFull() reports the queue as full.
+		* Note: This does not limit the queue; it is up to callers to stop producing data while the queue is full.
+		*
+		* @param in_high_water_mark Number of queued bytes at which the queue is full
+		*/
+		void setHighWaterMark(size_t in_high_water_mark);
+
+		/**
+		* @brief Fetches the amount of queued data at which isQueueFull() reports the queue as full.
+		*
+		* @return Queue's high-water mark, in bytes.
+		*/
+		size_t getHighWaterMark() const;
+
+		/**
+		* @brief Checks if the amount of queued data has reached the high-water mark.
+		*
+		* @return True if callers should stop sending until the queue is flushed, false otherwise.
+		*/
+		bool isQueueFull() const;
+
+		/**
+		* @brief Gathers sent data instead of writing it, until uncork() is called.
+		* Gathered data is written in as few writes as possible, producing full-size segments rather than one
+		* segment per send(). Calls may be nested; data is only written once every cork() has been uncorked.
+		*/
+		void cork();
+
+		/**
+		* @brief Releases a cork(), writing any gathered data if this was the outermost one.
+		* In queue mode, data which can't be written immediately remains queued; otherwise, this blocks like send().
+		*
+		* @return True if the gathered data was written (or queued), false on error.
+		*/
+		bool uncork();
+
+		/**
+		* @brief Checks if the socket is corked.
+		*
+		* @return True if sent data is being gathered, false otherwise.
+		*/
+		bool isCorked() const;
+
+		/**
+		* @brief Corks a socket for as long as the Cork exists.
+		*/
+		class JUPITER_API Cork
+		{
+		public:
+			/**
+			* @brief Corks a socket; see Socket::cork().
+			*
+			* @param in_socket Socket to cork
+			*/
+			Cork(Socket &in_socket);
+
+			/**
+			* @brief Copying a Cork is forbidden.
+			*/
+			Cork(const Cork &) = delete;
+
+			/**
+			* @brief Uncorks the socket; see Socket::uncork().
+			*/
+			~Cork();
+
+		/** Private members */
+		private:
+			Socket &m_socket;
+		};
+
 		/**
 		* @brief Sends data across the socket.
 		*
@@ -470,6 +685,13 @@ namespace Jupiter
 		*/
 		static int getLastError();
 
+		/**
+		* @brief Checks if the last socket operation failed only because it would have blocked.
+		*
+		* @return True if the last error was EAGAIN/EWOULDBLOCK (WSAEWOULDBLOCK on Windows), false otherwise.
+		*/
+		static bool isWouldBlock();
+
 		/**
 		* @brief Initializes any one-time background requirements for the Socket class to operate.
 		* In particular, this initializes WSA on Windows, required for any Socket operations.
@@ -524,15 +746,22 @@ namespace Jupiter
 		*/
 		virtual ~Socket();
 
-	/** Protected functions and members*/
-	protected:
-
 #if defined _WIN32
 		typedef uintptr_t SocketType;
 #else if
 		typedef int SocketType;
 #endif
 
+		/**
+		* @brief Fetches the underlying socket descriptor; this is intended for use with polling interfaces.
+		*
+		* @return A raw socket descriptor.
+		*/
+		SocketType getDescriptor() const;
+
+	/** Protected functions and members*/
+	protected:
+
 		/**
 		* @brief An extended verison of the string class, which allows for low-level length and string modification.
 		*/
@@ -541,21 +770,66 @@ namespace Jupiter
 		public:
 			void set_length(size_t in_length);
 			char *get_str() const;
+
+			/**
+			* @brief Fetches the position immediately after the data in the buffer.
+			*
+			* @return Pointer to the end of the data.
+			*/
+			char *get_tail() const;
+
+			/**
+			* @brief Ensures there is room after the data in the buffer, moving the data to the front of
+			* the buffer or growing the buffer if necessary.
+			*
+			* @param in_minimum Minimum number of bytes required after the data
+			* @return Number of bytes available after the data.
+			*/
+			size_t reserve_tail(size_t in_minimum);
+
+			/**
+			* @brief Removes data from the front of the buffer.
+			*
+			* @param in_length Number of bytes to remove
+			*/
+			void consume(size_t in_length);
 		};
 
 		/**
-		* @brief Fetches the buffer where data is stored
+		* @brief Fetches where recv() should write to in the buffer, based on the socket's mode.
 		*
-		* @return Buffer where data is stored
+		* @param out_capacity Number of bytes available at the returned position
+		* @return Position in the buffer to write received data to.
 		*/
-		Buffer &getInternalBuffer() const;
+		char *prepareRecv(size_t &out_capacity);
 
 		/**
-		* @brief Used by class extensions to get the socket descriptor.
+		* @brief Writes data to the socket, bypassing the send queue. send() and flush() write through this.
+		* In queue mode, this must not block.
 		*
-		* @return A raw socket descriptor.
+		* @param data Data to write
+		* @param datalen Number of bytes to write
+		* @return Number of bytes written on success, 0 if the socket would block (queue mode only), SOCKET_ERROR (-1) otherwise.
 		*/
-		SocketType getDescriptor() const;
+		virtual int transmit(const char *data, size_t datalen);
+
+		/**
+		* @brief Sends part of a file by reading it into memory and passing it to send(); used when sendFile() can't
+		* send directly from the file.
+		*
+		* @param in_file Descriptor of the file to send from
+		* @param in_offset Position in the file to start sending from
+		* @param in_length Number of bytes to send
+		* @return Number of bytes sent on success, SOCKET_ERROR (-1) otherwise.
+		*/
+		int sendFileCopy(int in_file, size_t in_offset, size_t in_length);
+
+		/**
+		* @brief Fetches the buffer where data is stored
+		*
+		* @return Buffer where data is stored
+		*/
+		Buffer &getInternalBuffer() const;
 
 		/**
 		* @brief Used by class extensions to set the appropriate socket descriptor.
@@ -635,6 +635,7 @@ template<typename T> bool Jupiter::String_Loose<T>::setBufferSizeNoCopy(size_t l
 	len = getPowerTwo(len);
 	if (len > Jupiter::String_Loose<T>::strSize)
 	{
+		Jupiter::String_Loose<T>::strSize = len;
 		Jupiter::String_Type<T>::length = 0;
 		delete[] Jupiter::Shift_String_Type<T>::base;
 		Jupiter::Shift_String_Type<T>::base = new T[len];
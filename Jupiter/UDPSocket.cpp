@@ -16,13 +16,16 @@
  * Written by Jessica James <jessica.aj@outlook.com>
  */
 
+#include <cstring>
 #include "UDPSocket.h"
 
 #if defined _WIN32
 #include <WinSock2.h>
+#include <ws2tcpip.h>
 #else // _WIN32
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netdb.h>
 #endif // _WIN32
 
 void setSocketUDP(Jupiter::Socket *sock)
@@ -52,4 +55,233 @@ Jupiter::UDPSocket::UDPSocket(size_t bufferSize) : Socket(bufferSize)
 Jupiter::UDPSocket::UDPSocket(Jupiter::Socket &&source) : Socket(std::move(source))
 {
 	setSocketUDP(this);
-}
\ No newline at end of file
+}
+
+/** Batch Implementation */
+
+struct Jupiter::UDPSocket::Batch::Data
+{
+	size_t count = 0; // number of datagrams in the batch
+	size_t offset = 0; // index of the first datagram which has not been sent yet
+	size_t capacity;
+	size_t datagram_size;
+	char *buffer;
+	size_t *lengths;
+	bool *truncated;
+	sockaddr_storage *addresses;
+	socklen_t *address_lengths;
+#if !defined _WIN32
+	mmsghdr *headers;
+	iovec *vectors;
+#endif // _WIN32
+};
+
+size_t Jupiter::UDPSocket::Batch::size() const
+{
+	return Jupiter::UDPSocket::Batch::data_->count - Jupiter::UDPSocket::Batch::data_->offset;
+}
+
+size_t Jupiter::UDPSocket::Batch::capacity() const
+{
+	return Jupiter::UDPSocket::Batch::data_->capacity;
+}
+
+size_t Jupiter::UDPSocket::Batch::getDatagramSize() const
+{
+	return Jupiter::UDPSocket::Batch::data_->datagram_size;
+}
+
+Jupiter::ReferenceString Jupiter::UDPSocket::Batch::get(size_t index) const
+{
+	index += Jupiter::UDPSocket::Batch::data_->offset;
+	return Jupiter::ReferenceString(Jupiter::UDPSocket::Batch::data_->buffer + index * Jupiter::UDPSocket::Batch::data_->datagram_size, Jupiter::UDPSocket::Batch::data_->lengths[index]);
+}
+
+const sockaddr *Jupiter::UDPSocket::Batch::getAddress(size_t index) const
+{
+	return reinterpret_cast<const sockaddr *>(Jupiter::UDPSocket::Batch::data_->addresses + Jupiter::UDPSocket::Batch::data_->offset + index);
+}
+
+size_t Jupiter::UDPSocket::Batch::getAddressLength(size_t index) const
+{
+	return Jupiter::UDPSocket::Batch::data_->address_lengths[Jupiter::UDPSocket::Batch::data_->offset + index];
+}
+
+bool Jupiter::UDPSocket::Batch::isTruncated(size_t index) const
+{
+	return Jupiter::UDPSocket::Batch::data_->truncated[Jupiter::UDPSocket::Batch::data_->offset + index];
+}
+
+bool Jupiter::UDPSocket::Batch::push(const sockaddr *in_address, size_t in_address_length, const char *in_data, size_t in_length)
+{
+	Data *data = Jupiter::UDPSocket::Batch::data_;
+	if (data->count == data->capacity || in_length > data->datagram_size || in_address_length > sizeof(sockaddr_storage))
+		return false;
+
+	if (in_address == nullptr)
+		in_address_length = 0;
+	else
+		memcpy(data->addresses + data->count, in_address, in_address_length);
+
+	memcpy(data->buffer + data->count * data->datagram_size, in_data, in_length);
+	data->address_lengths[data->count] = static_cast<socklen_t>(in_address_length);
+	data->lengths[data->count] = in_length;
+	data->truncated[data->count] = false;
+	++data->count;
+	return true;
+}
+
+bool Jupiter::UDPSocket::Batch::push(const addrinfo *in_info, const Jupiter::ReadableString &in_data)
+{
+	return Jupiter::UDPSocket::Batch::push(in_info->ai_addr, in_info->ai_addrlen, in_data.ptr(), in_data.size());
+}
+
+void Jupiter::UDPSocket::Batch::clear()
+{
+	Jupiter::UDPSocket::Batch::data_->count = 0;
+	Jupiter::UDPSocket::Batch::data_->offset = 0;
+}
+
+Jupiter::UDPSocket::Batch::Batch(size_t in_capacity, size_t in_datagram_size)
+{
+	Jupiter::UDPSocket::Batch::data_ = new Data();
+	Data *data = Jupiter::UDPSocket::Batch::data_;
+
+	if (in_capacity == 0)
+		in_capacity = 1;
+
+	data->capacity = in_capacity;
+	data->datagram_size = in_datagram_size;
+	data->buffer = new char[in_capacity * in_datagram_size];
+	data->lengths = new size_t[in_capacity];
+	data->truncated = new bool[in_capacity];
+	data->addresses = new sockaddr_storage[in_capacity];
+	data->address_lengths = new socklen_t[in_capacity];
+
+#if !defined _WIN32
+	// Headers permanently point at their datagram's buffer and address slot; only lengths change between calls
+	data->headers = new mmsghdr[in_capacity];
+	data->vectors = new iovec[in_capacity];
+	memset(data->headers, 0, sizeof(mmsghdr) * in_capacity);
+	for (size_t index = 0; index != in_capacity; ++index)
+	{
+		data->vectors[index].iov_base = data->buffer + index * in_datagram_size;
+		data->headers[index].msg_hdr.msg_iov = data->vectors + index;
+		data->headers[index].msg_hdr.msg_iovlen = 1;
+		data->headers[index].msg_hdr.msg_name = data->addresses + index;
+	}
+#endif // _WIN32
+}
+
+Jupiter::UDPSocket::Batch::~Batch()
+{
+#if !defined _WIN32
+	delete[] Jupiter::UDPSocket::Batch::data_->headers;
+	delete[] Jupiter::UDPSocket::Batch::data_->vectors;
+#endif // _WIN32
+	delete[] Jupiter::UDPSocket::Batch::data_->buffer;
+	delete[] Jupiter::UDPSocket::Batch::data_->lengths;
+	delete[] Jupiter::UDPSocket::Batch::data_->truncated;
+	delete[] Jupiter::UDPSocket::Batch::data_->addresses;
+	delete[] Jupiter::UDPSocket::Batch::data_->address_lengths;
+	delete Jupiter::UDPSocket::Batch::data_;
+}
+
+/** Batch I/O */
+
+int Jupiter::UDPSocket::recvBatch(Batch &batch)
+{
+	Batch::Data *data = batch.data_;
+	data->count = 0;
+	data->offset = 0;
+
+#if defined _WIN32
+	// No batch receive is available; receive until nothing more is queued
+	int length;
+	u_long pending;
+	do
+	{
+		data->address_lengths[data->count] = sizeof(sockaddr_storage);
+		length = recvfrom(this->getDescriptor(), data->buffer + data->count * data->datagram_size, static_cast<int>(data->datagram_size), 0, reinterpret_cast<sockaddr *>(data->addresses + data->count), &data->address_lengths[data->count]);
+		if (length < 0)
+		{
+			data->truncated[data->count] = WSAGetLastError() == WSAEMSGSIZE;
+			if (data->truncated[data->count] == false)
+				return data->count == 0 ? SOCKET_ERROR : static_cast<int>(data->count);
+
+			length = static_cast<int>(data->datagram_size);
+		}
+		else
+			data->truncated[data->count] = false;
+
+		data->lengths[data->count] = length;
+		++data->count;
+	}
+	while (data->count != data->capacity && ioctlsocket(this->getDescriptor(), FIONREAD, &pending) == 0 && pending != 0);
+
+	return static_cast<int>(data->count);
+#else // _WIN32
+	for (size_t index = 0; index != data->capacity; ++index)
+	{
+		data->vectors[index].iov_len = data->datagram_size;
+		data->headers[index].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+	}
+
+	// MSG_WAITFORONE: only block (if at all) until the first datagram arrives
+	int result = recvmmsg(this->getDescriptor(), data->headers, data->capacity, MSG_WAITFORONE, nullptr);
+	if (result <= 0)
+		return result;
+
+	for (int index = 0; index != result; ++index)
+	{
+		data->lengths[index] = data->headers[index].msg_len;
+		data->address_lengths[index] = data->headers[index].msg_hdr.msg_namelen;
+		data->truncated[index] = (data->headers[index].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+	}
+
+	data->count = result;
+	return result;
+#endif // _WIN32
+}
+
+int Jupiter::UDPSocket::sendBatch(Batch &batch)
+{
+	Batch::Data *data = batch.data_;
+	if (data->offset == data->count)
+		return 0;
+
+#if defined _WIN32
+	// No batch send is available; send until one fails
+	size_t start = data->offset;
+	while (data->offset != data->count)
+	{
+		if (sendto(this->getDescriptor(), data->buffer + data->offset * data->datagram_size, static_cast<int>(data->lengths[data->offset]), 0,
+			data->address_lengths[data->offset] == 0 ? nullptr : reinterpret_cast<const sockaddr *>(data->addresses + data->offset), data->address_lengths[data->offset]) < 0)
+		{
+			if (data->offset == start)
+				return SOCKET_ERROR;
+			break;
+		}
+		++data->offset;
+	}
+
+	int result = static_cast<int>(data->offset - start);
+#else // _WIN32
+	for (size_t index = data->offset; index != data->count; ++index)
+	{
+		data->vectors[index].iov_len = data->lengths[index];
+		data->headers[index].msg_hdr.msg_namelen = data->address_lengths[index];
+	}
+
+	int result = sendmmsg(this->getDescriptor(), data->headers + data->offset, data->count - data->offset, 0);
+	if (result < 0)
+		return result;
+
+	data->offset += result;
+#endif // _WIN32
+
+	if (data->offset == data->count)
+		batch.clear();
+
+	return result;
+}
@@ -26,6 +26,9 @@
 
 #include "Jupiter.h"
 #include "Socket.h"
+#include "Reference_String.h"
+
+struct sockaddr;
 
 namespace Jupiter
 {
@@ -41,6 +44,135 @@ namespace Jupiter
 		UDPSocket(const UDPSocket &) = delete;
 		UDPSocket(size_t bufferSize);
 		UDPSocket(Jupiter::Socket &&source);
+
+		/**
+		* @brief A preallocated set of datagram buffers and address slots, used to move many datagrams per system call.
+		*/
+		class JUPITER_API Batch
+		{
+		public:
+			/**
+			* @brief Fetches the number of datagrams in the batch.
+			*
+			* @return Number of datagrams in the batch.
+			*/
+			size_t size() const;
+
+			/**
+			* @brief Fetches the maximum number of datagrams which the batch can hold.
+			*
+			* @return Capacity of the batch.
+			*/
+			size_t capacity() const;
+
+			/**
+			* @brief Fetches the maximum size of a single datagram in the batch.
+			*
+			* @return Size of each datagram buffer.
+			*/
+			size_t getDatagramSize() const;
+
+			/**
+			* @brief Fetches the contents of a datagram in the batch.
+			* Note: The returned string refers to the batch's buffer, and is only valid until the batch is next modified.
+			*
+			* @param index Index of the datagram
+			* @return Contents of the datagram.
+			*/
+			Jupiter::ReferenceString get(size_t index) const;
+
+			/**
+			* @brief Fetches the address of a datagram in the batch (the sender for received datagrams, or the destination for queued ones).
+			*
+			* @param index Index of the datagram
+			* @return Address of the datagram.
+			*/
+			const sockaddr *getAddress(size_t index) const;
+
+			/**
+			* @brief Fetches the length of a datagram's address.
+			*
+			* @param index Index of the datagram
+			* @return Length of the datagram's address.
+			*/
+			size_t getAddressLength(size_t index) const;
+
+			/**
+			* @brief Checks if a received datagram was larger than the datagram size, and was therefore truncated.
+			*
+			* @param index Index of the datagram
+			* @return True if the datagram was truncated, false otherwise.
+			*/
+			bool isTruncated(size_t index) const;
+
+			/**
+			* @brief Queues a datagram to be sent by sendBatch().
+			*
+			* @param in_address Destination address, or nullptr if the socket is connected
+			* @param in_address_length Length of in_address
+			* @param in_data Datagram contents
+			* @param in_length Length of in_data
+			* @return True if the datagram was queued, false if the batch is full or the datagram is too large.
+			*/
+			bool push(const sockaddr *in_address, size_t in_address_length, const char *in_data, size_t in_length);
+
+			/**
+			* @brief Queues a datagram to be sent by sendBatch().
+			*
+			* @param in_info Destination address info
+			* @param in_data Datagram contents
+			* @return True if the datagram was queued, false if the batch is full or the datagram is too large.
+			*/
+			bool push(const addrinfo *in_info, const Jupiter::ReadableString &in_data);
+
+			/**
+			* @brief Removes all datagrams from the batch.
+			*/
+			void clear();
+
+			/**
+			* @brief Constructor for the Batch class.
+			*
+			* @param in_capacity Maximum number of datagrams in the batch
+			* @param in_datagram_size Maximum size of each datagram
+			*/
+			Batch(size_t in_capacity, size_t in_datagram_size = 1500);
+
+			/**
+			* @brief Copying a Batch is forbidden.
+			*/
+			Batch(const Batch &) = delete;
+
+			/**
+			* @brief Destructor for the Batch class.
+			*/
+			~Batch();
+
+		/** Private members */
+		private:
+			friend class UDPSocket;
+			struct Data;
+			Data *data_;
+		};
+
+		/**
+		* @brief Receives as many datagrams as are available (up to the batch's capacity) into a batch, replacing its contents.
+		* On Linux, this is a single recvmmsg() call. This only blocks while waiting for the first datagram, and only if the socket is blocking.
+		*
+		* @param batch Batch to receive into
+		* @return Number of datagrams received on success, SOCKET_ERROR (-1) otherwise.
+		*/
+		int recvBatch(Batch &batch);
+
+		/**
+		* @brief Sends every datagram queued in a batch.
+		* On Linux, this is a single sendmmsg() call. Datagrams which are sent are removed from the batch;
+		* if not all of them could be sent (i.e: the operation would block), the remainder are left queued.
+		*
+		* @param batch Batch to send
+		* @return Number of datagrams sent on success, SOCKET_ERROR (-1) otherwise.
+		*/
+		int sendBatch(Batch &batch);
 	};
 
 }
@@ -0,0 +1,179 @@
+/**
+ * Copyright (C) 2017 Jessica James.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Written by Jessica James <jessica.aj@outlook.com>
+ */
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "WorkerPool.h"
+
+/** WorkerPool */
+
+struct Jupiter::WorkerPool::Data
+{
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<std::function<void()>> queue;
+	std::vector<std::thread> threads;
+	bool running = true;
+
+	void worker_loop();
+};
+
+void Jupiter::WorkerPool::Data::worker_loop()
+{
+	std::function<void()> task;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		condition.wait(lock, [this] { return running == false || queue.empty() == false; });
+		if (queue.empty()) // stopped, and nothing left to run
+			return;
+
+		task = std::move(queue.front());
+		queue.pop_front();
+		lock.unlock();
+
+		task();
+		task = nullptr;
+
+		lock.lock();
+	}
+}
+
+void Jupiter::WorkerPool::post(std::function<void()> in_task)
+{
+	{
+		std::lock_guard<std::mutex> guard(Jupiter::WorkerPool::data_->mutex);
+		Jupiter::WorkerPool::data_->queue.push_back(std::move(in_task));
+	}
+	Jupiter::WorkerPool::data_->condition.notify_one();
+}
+
+size_t Jupiter::WorkerPool::size() const
+{
+	return Jupiter::WorkerPool::data_->threads.size();
+}
+
+Jupiter::WorkerPool &Jupiter::WorkerPool::getDefault()
+{
+	static Jupiter::WorkerPool pool(std::thread::hardware_concurrency() / 2);
+	return pool;
+}
+
+Jupiter::WorkerPool::WorkerPool(size_t in_threads)
+{
+	Jupiter::WorkerPool::data_ = new Data();
+	if (in_threads == 0)
+		in_threads = 1;
+
+	while (in_threads-- != 0)
+		Jupiter::WorkerPool::data_->threads.emplace_back(&Data::worker_loop, Jupiter::WorkerPool::data_);
+}
+
+Jupiter::WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(Jupiter::WorkerPool::data_->mutex);
+		Jupiter::WorkerPool::data_->running = false;
+	}
+	Jupiter::WorkerPool::data_->condition.notify_all();
+
+	for (auto &thread : Jupiter::WorkerPool::data_->threads)
+		thread.join();
+
+	delete Jupiter::WorkerPool::data_;
+}
+
+/** Strand */
+
+struct Jupiter::WorkerPool::Strand::Data
+{
+	Jupiter::WorkerPool *pool;
+	mutable std::mutex mutex;
+	mutable std::condition_variable condition;
+	std::deque<std::function<void()>> queue;
+	bool scheduled = false; // a task from the queue is running (or about to) on the pool
+
+	void run();
+};
+
+/** Runs every queued task; only one of these is ever scheduled at a time, which preserves the strand's order */
+void Jupiter::WorkerPool::Strand::Data::run()
+{
+	std::function<void()> task;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (queue.empty() == false)
+	{
+		task = std::move(queue.front());
+		queue.pop_front();
+		lock.unlock();
+
+		task();
+		task = nullptr;
+
+		lock.lock();
+	}
+
+	scheduled = false;
+	condition.notify_all();
+}
+
+void Jupiter::WorkerPool::Strand::post(std::function<void()> in_task)
+{
+	std::lock_guard<std::mutex> guard(Jupiter::WorkerPool::Strand::data_->mutex);
+	Jupiter::WorkerPool::Strand::data_->queue.push_back(std::move(in_task));
+	if (Jupiter::WorkerPool::Strand::data_->scheduled == false)
+	{
+		Jupiter::WorkerPool::Strand::data_->scheduled = true;
+		std::shared_ptr<Data> data = Jupiter::WorkerPool::Strand::data_;
+		Jupiter::WorkerPool::Strand::data_->pool->post([data] { data->run(); });
+	}
+}
+
+void Jupiter::WorkerPool::Strand::wait() const
+{
+	std::unique_lock<std::mutex> lock(Jupiter::WorkerPool::Strand::data_->mutex);
+	Jupiter::WorkerPool::Strand::data_->condition.wait(lock, [this] { return Jupiter::WorkerPool::Strand::data_->scheduled == false; });
+}
+
+bool Jupiter::WorkerPool::Strand::wait(std::chrono::milliseconds in_timeout) const
+{
+	std::unique_lock<std::mutex> lock(Jupiter::WorkerPool::Strand::data_->mutex);
+	return Jupiter::WorkerPool::Strand::data_->condition.wait_for(lock, in_timeout, [this] { return Jupiter::WorkerPool::Strand::data_->scheduled == false; });
+}
+
+bool Jupiter::WorkerPool::Strand::isIdle() const
+{
+	std::lock_guard<std::mutex> guard(Jupiter::WorkerPool::Strand::data_->mutex);
+	return Jupiter::WorkerPool::Strand::data_->scheduled == false;
+}
+
+Jupiter::WorkerPool::Strand::Strand(Jupiter::WorkerPool &in_pool)
+{
+	Jupiter::WorkerPool::Strand::data_ = std::make_shared<Data>();
+	Jupiter::WorkerPool::Strand::data_->pool = &in_pool;
+}
+
+Jupiter::WorkerPool::Strand::~Strand()
+{
+	Jupiter::WorkerPool::Strand::wait();
+}
@@ -0,0 +1,146 @@
+/**
+ * Copyright (C) 2017 Jessica James.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Written by Jessica James <jessica.aj@outlook.com>
+ */
+
+#if !defined _WORKERPOOL_H_HEADER
+#define _WORKERPOOL_H_HEADER
+
+/**
+ * @file WorkerPool.h
+ * @brief Provides a pool of worker threads, and strands for running tasks on them in order.
+ */
+
+#include <chrono>
+#include <memory>
+#include <functional>
+#include "Jupiter.h"
+
+namespace Jupiter
+{
+	/**
+	* @brief Runs tasks on a fixed set of background threads.
+	* Tasks posted directly to the pool may run concurrently and in any order; tasks posted to a Strand
+	* run one at a time, in the order they were posted.
+	*/
+	class JUPITER_API WorkerPool
+	{
+	public:
+		/**
+		* @brief Serializes tasks on a WorkerPool, without dedicating a thread to them.
+		*/
+		class JUPITER_API Strand
+		{
+		public:
+			/**
+			* @brief Queues a task to run after every task previously posted to the strand.
+			*
+			* @param in_task Task to run
+			*/
+			void post(std::function<void()> in_task);
+
+			/**
+			* @brief Blocks until every task posted to the strand so far has run.
+			* Note: This must not be called from a task on the same strand.
+			*/
+			void wait() const;
+
+			/**
+			* @brief Blocks until every task posted to the strand so far has run, or until a timeout expires.
+			* Note: This must not be called from a task on the same strand.
+			*
+			* @param in_timeout Longest time to wait
+			* @return True if the strand is idle, false if the timeout expired first.
+			*/
+			bool wait(std::chrono::milliseconds in_timeout) const;
+
+			/**
+			* @brief Checks if every task posted to the strand has finished.
+			*
+			* @return True if the strand is idle, false otherwise.
+			*/
+			bool isIdle() const;
+
+			/**
+			* @brief Constructor for the Strand class.
+			*
+			* @param in_pool Pool to run tasks on
+			*/
+			Strand(WorkerPool &in_pool);
+
+			/**
+			* @brief Copying a Strand is forbidden.
+			*/
+			Strand(const Strand &) = delete;
+
+			/**
+			* @brief Destructor for the Strand class; this waits for any remaining tasks to finish.
+			*/
+			~Strand();
+
+		/** Private members */
+		private:
+			struct Data;
+			std::shared_ptr<Data> data_; // shared with the pool while a task is running
+		};
+
+		/**
+		* @brief Queues a task to run on the pool.
+		*
+		* @param in_task Task to run
+		*/
+		void post(std::function<void()> in_task);
+
+		/**
+		* @brief Fetches the number of threads in the pool.
+		*
+		* @return Number of threads.
+		*/
+		size_t size() const;
+
+		/**
+		* @brief Fetches the pool which is shared by default (i.e: for TLS offloading).
+		* This pool has one thread for every two hardware threads, and at least one.
+		*
+		* @return Default pool.
+		*/
+		static WorkerPool &getDefault();
+
+		/**
+		* @brief Constructor for the WorkerPool class.
+		*
+		* @param in_threads Number of threads to start
+		*/
+		WorkerPool(size_t in_threads);
+
+		/**
+		* @brief Copying a WorkerPool is forbidden.
+		*/
+		WorkerPool(const WorkerPool &) = delete;
+
+		/**
+		* @brief Destructor for the WorkerPool class; this finishes any queued tasks before returning.
+		*/
+		~WorkerPool();
+
+	/** Private members */
+	private:
+		struct Data;
+		Data *data_;
+	}; // Jupiter::WorkerPool class
+} // Jupiter namespace
+
+#endif // _WORKERPOOL_H_HEADER